@@ -0,0 +1,131 @@
+#include "dynwrapx.h"
+
+// Scratch memory reserved for each thread that makes calls
+#define ARENA_SIZE 0x10000
+
+// Per-thread bump allocator for call temporaries. Allocations are released
+// all at once by resetting to a mark taken at call entry; nested calls
+// (callbacks re-entering the wrapper) take and reset their own marks.
+typedef struct _ScratchArena {
+    BYTE* base;
+    SIZE_T used;
+    SIZE_T size;
+    struct _ScratchArena* prev;
+    struct _ScratchArena* next;
+} ScratchArena;
+
+static DWORD g_arenaTls = TLS_OUT_OF_INDEXES;
+static CRITICAL_SECTION g_arenaCS;
+static ScratchArena* g_arenas = NULL;   // Every live arena, freed at process detach
+
+void InitializeArenas(void)
+{
+    InitializeCriticalSection(&g_arenaCS);
+    g_arenaTls = TlsAlloc();
+}
+
+void CleanupArenas(void)
+{
+    ScratchArena* pArena = g_arenas;
+    while (pArena)
+    {
+        ScratchArena* pNext = pArena->next;
+        GlobalFree(pArena);
+        pArena = pNext;
+    }
+    g_arenas = NULL;
+    
+    if (g_arenaTls != TLS_OUT_OF_INDEXES)
+    {
+        TlsFree(g_arenaTls);
+        g_arenaTls = TLS_OUT_OF_INDEXES;
+    }
+    DeleteCriticalSection(&g_arenaCS);
+}
+
+// Free the calling thread's arena (DLL_THREAD_DETACH)
+void ReleaseThreadArena(void)
+{
+    if (g_arenaTls == TLS_OUT_OF_INDEXES)
+        return;
+    
+    ScratchArena* pArena = (ScratchArena*)TlsGetValue(g_arenaTls);
+    if (!pArena)
+        return;
+    
+    EnterCriticalSection(&g_arenaCS);
+    if (pArena->prev)
+        pArena->prev->next = pArena->next;
+    else
+        g_arenas = pArena->next;
+    if (pArena->next)
+        pArena->next->prev = pArena->prev;
+    LeaveCriticalSection(&g_arenaCS);
+    
+    TlsSetValue(g_arenaTls, NULL);
+    GlobalFree(pArena);
+}
+
+// Get the calling thread's arena, creating it on first use
+static ScratchArena* GetThreadArena(void)
+{
+    if (g_arenaTls == TLS_OUT_OF_INDEXES)
+        return NULL;
+    
+    ScratchArena* pArena = (ScratchArena*)TlsGetValue(g_arenaTls);
+    if (pArena)
+        return pArena;
+    
+    // Header and buffer in one allocation, buffer 16-byte aligned
+    SIZE_T headerSize = (sizeof(ScratchArena) + 15) & ~(SIZE_T)15;
+    pArena = (ScratchArena*)GlobalAlloc(GMEM_FIXED, headerSize + ARENA_SIZE + 15);
+    if (!pArena)
+        return NULL;
+    pArena->base = (BYTE*)(((ULONG_PTR)pArena + headerSize + 15) & ~(ULONG_PTR)15);
+    pArena->used = 0;
+    pArena->size = ARENA_SIZE;
+    pArena->prev = NULL;
+    
+    EnterCriticalSection(&g_arenaCS);
+    pArena->next = g_arenas;
+    if (g_arenas)
+        g_arenas->prev = pArena;
+    g_arenas = pArena;
+    LeaveCriticalSection(&g_arenaCS);
+    
+    TlsSetValue(g_arenaTls, pArena);
+    DebugLog("DEBUG", "GetThreadArena", "Created %lu byte arena for thread %lu", (ULONG)ARENA_SIZE, GetCurrentThreadId());
+    return pArena;
+}
+
+// Current position of the calling thread's arena
+SIZE_T ArenaMark(void)
+{
+    ScratchArena* pArena = GetThreadArena();
+    return pArena ? pArena->used : 0;
+}
+
+// Release everything allocated since mark was taken
+void ArenaReset(SIZE_T mark)
+{
+    ScratchArena* pArena = (g_arenaTls != TLS_OUT_OF_INDEXES) ? (ScratchArena*)TlsGetValue(g_arenaTls) : NULL;
+    if (pArena && mark <= pArena->used)
+        pArena->used = mark;
+}
+
+// Allocate 16-byte aligned scratch memory; returns NULL when the request does
+// not fit so the caller can fall back to the heap
+void* ArenaAlloc(SIZE_T size)
+{
+    ScratchArena* pArena = GetThreadArena();
+    if (!pArena)
+        return NULL;
+    
+    size = (size + 15) & ~(SIZE_T)15;
+    if (size > pArena->size - pArena->used)
+        return NULL;
+    
+    void* p = pArena->base + pArena->used;
+    pArena->used += size;
+    return p;
+}
@@ -0,0 +1,143 @@
+#include "dynwrapx.h"
+
+// Called by the callback thunk on a thread other than the one that
+// registered the callback. The arguments are converted right away (strings
+// are copied, since their buffers belong to the native caller) and the call
+// is pushed onto the owner's queue without taking a lock. Once maxQueued
+// calls of the callback are waiting, further calls are dropped and counted
+// in the owner's AsyncDropped counter.
+void QueueAsyncCall(CallbackInfo* pInfo, const LONG_PTR* argSlots)
+{
+    DynamicWrapperX* pObj = pInfo->owner;
+    int count = pInfo->paramCount;
+    
+    // Reserve a place in the queue before allocating
+    LONG queued = InterlockedIncrement(&pInfo->queuedCalls);
+    if (pInfo->maxQueued > 0 && queued > pInfo->maxQueued)
+    {
+        InterlockedDecrement(&pInfo->queuedCalls);
+        InterlockedIncrement(&pObj->asyncDropped);
+        return;
+    }
+    
+    AsyncCall* pCall = (AsyncCall*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT,
+                                               sizeof(AsyncCall) + (count > 1 ? count - 1 : 0) * sizeof(VARIANT));
+    if (!pCall)
+    {
+        DebugLog("ERROR", "QueueAsyncCall", "Out of memory, callback 0x%p dropped", pInfo->thunk);
+        InterlockedDecrement(&pInfo->queuedCalls);
+        InterlockedIncrement(&pObj->asyncDropped);
+        return;
+    }
+    
+    pCall->callback = pInfo;
+    pCall->argCount = count;
+    for (int i = 0; i < count; i++)
+    {
+        VARIANT* pArg = &pCall->args[count - 1 - i];
+        if (FAILED(SetCallbackArgument(&argSlots[pInfo->slotIndex[i]], pInfo->paramTypes[i], pArg)))
+            VariantInit(pArg);
+    }
+    
+    AsyncCall* head;
+    do
+    {
+        head = pObj->asyncCalls;
+        pCall->next = head;
+    } while (InterlockedCompareExchangePointer((PVOID volatile*)&pObj->asyncCalls, pCall, head) != head);
+    
+    // Only the push that makes the queue non-empty has to wake the pump
+    if (!head)
+        SetEvent(pObj->asyncEvent);
+}
+
+static void FreeAsyncCall(AsyncCall* pCall)
+{
+    for (int i = 0; i < pCall->argCount; i++)
+        VariantClear(&pCall->args[i]);
+    InterlockedDecrement(&pCall->callback->queuedCalls);
+    GlobalFree(pCall);
+}
+
+// Take every queued call, oldest first
+static AsyncCall* TakeAsyncCalls(DynamicWrapperX* pObj)
+{
+    AsyncCall* pCall = (AsyncCall*)InterlockedExchangePointer((PVOID volatile*)&pObj->asyncCalls, NULL);
+    AsyncCall* pOrdered = NULL;
+    
+    // The queue is pushed newest first
+    while (pCall)
+    {
+        AsyncCall* pNext = pCall->next;
+        pCall->next = pOrdered;
+        pOrdered = pCall;
+        pCall = pNext;
+    }
+    return pOrdered;
+}
+
+// Run queued calls on the calling (script) thread. Waits up to timeout ms
+// for the first call, pumping COM messages meanwhile, then delivers the
+// whole batch that has arrived. Returns the number of calls delivered.
+LONG PumpAsyncCalls(DynamicWrapperX* pObj, DWORD timeout)
+{
+    LONG delivered = 0;
+    
+    if (!pObj->asyncEvent)
+        return 0;
+    
+    AsyncCall* pCall = TakeAsyncCalls(pObj);
+    DWORD start = GetTickCount();
+    while (!pCall)
+    {
+        DWORD elapsed = GetTickCount() - start;
+        DWORD index;
+        if (elapsed >= timeout)
+            break;
+        
+        // The event may be left over from a batch already taken, so
+        // re-check the queue after every wake-up
+        CoWaitForMultipleHandles(0, timeout - elapsed, 1, &pObj->asyncEvent, &index);
+        pCall = TakeAsyncCalls(pObj);
+    }
+    
+    while (pCall)
+    {
+        AsyncCall* pNext = pCall->next;
+        CallbackInfo* pInfo = pCall->callback;
+        DISPPARAMS dispParams = { pCall->args, NULL, (UINT)pCall->argCount, 0 };
+        VARIANT varResult;
+        
+        VariantInit(&varResult);
+        HRESULT hr = pInfo->scriptFunction->lpVtbl->Invoke(
+            pInfo->scriptFunction, DISPID_VALUE, &IID_NULL, LOCALE_USER_DEFAULT,
+            DISPATCH_METHOD, &dispParams, &varResult, NULL, NULL);
+        if (FAILED(hr))
+            DebugLog("ERROR", "PumpAsyncCalls", "Callback 0x%p failed, hr=0x%08x", pInfo->thunk, hr);
+        VariantClear(&varResult);
+        
+        FreeAsyncCall(pCall);
+        delivered++;
+        pCall = pNext;
+    }
+    
+    return delivered;
+}
+
+// Discard undelivered calls (object release)
+void FreeAsyncCalls(DynamicWrapperX* pObj)
+{
+    AsyncCall* pCall = TakeAsyncCalls(pObj);
+    while (pCall)
+    {
+        AsyncCall* pNext = pCall->next;
+        FreeAsyncCall(pCall);
+        pCall = pNext;
+    }
+    
+    if (pObj->asyncEvent)
+    {
+        CloseHandle(pObj->asyncEvent);
+        pObj->asyncEvent = NULL;
+    }
+}
@@ -0,0 +1,343 @@
+#include "dynwrapx.h"
+
+// Buffers are carved from a private heap: no syscall or 64KB granularity per
+// allocation, and freeing one never touches the process heap
+static HANDLE g_bufferHeap = NULL;
+
+// Buffer object returned by Alloc. The header and the data share one heap
+// block; data is the aligned start of the usable bytes.
+typedef struct _NativeBuffer {
+    IDispatchVtbl* lpVtbl;
+    LONG refCount;
+    BYTE* data;
+    SIZE_T size;
+} NativeBuffer;
+
+// Buffer member DISPIDs: properties first, then one accessor per type
+#define DISPID_BUFFER_PTR       1
+#define DISPID_BUFFER_SIZE      2
+#define DISPID_BUFFER_ACCESSOR  3
+
+// Typed accessors, in DISPID order: buf.u32(i) reads element i,
+// buf.u32(i, value) writes it
+static const struct {
+    LPCWSTR name;
+    ParameterType type;
+} g_bufferAccessors[] = {
+    { L"i8",  TYPE_CHAR },
+    { L"u8",  TYPE_UCHAR },
+    { L"i16", TYPE_SHORT },
+    { L"u16", TYPE_USHORT },
+    { L"i32", TYPE_LONG },
+    { L"u32", TYPE_ULONG },
+    { L"i64", TYPE_LONGLONG },
+    { L"f32", TYPE_FLOAT },
+    { L"f64", TYPE_DOUBLE },
+    { L"pointer", TYPE_POINTER }
+};
+
+#define BUFFER_ACCESSOR_COUNT (sizeof(g_bufferAccessors) / sizeof(g_bufferAccessors[0]))
+
+static IDispatchVtbl g_bufferVtbl;
+
+void InitializeBuffers(void)
+{
+    g_bufferHeap = HeapCreate(0, 0, 0);
+}
+
+void CleanupBuffers(void)
+{
+    if (g_bufferHeap)
+    {
+        HeapDestroy(g_bufferHeap);
+        g_bufferHeap = NULL;
+    }
+}
+
+// Allocate a zero-filled buffer of size bytes whose data is aligned to
+// align (a power of two)
+HRESULT CreateNativeBuffer(SIZE_T size, SIZE_T align, VARIANT* pResult)
+{
+    if (!g_bufferHeap)
+        return E_OUTOFMEMORY;
+    if (align == 0 || (align & (align - 1)) != 0)
+        return E_INVALIDARG;
+    
+    // Room for the header plus the worst-case alignment gap
+    SIZE_T header = (sizeof(NativeBuffer) + 15) & ~(SIZE_T)15;
+    if (size > ((SIZE_T)-1) - header - align)
+        return E_OUTOFMEMORY;
+    
+    NativeBuffer* pBuffer = (NativeBuffer*)HeapAlloc(g_bufferHeap, HEAP_ZERO_MEMORY, header + size + align - 1);
+    if (!pBuffer)
+        return E_OUTOFMEMORY;
+    
+    pBuffer->lpVtbl = &g_bufferVtbl;
+    pBuffer->refCount = 1;
+    pBuffer->data = (BYTE*)(((ULONG_PTR)pBuffer + header + align - 1) & ~(ULONG_PTR)(align - 1));
+    pBuffer->size = size;
+    InterlockedIncrement(&g_cObjects);
+    
+    VariantInit(pResult);
+    V_VT(pResult) = VT_DISPATCH;
+    V_DISPATCH(pResult) = (IDispatch*)pBuffer;
+    return S_OK;
+}
+
+// Data pointer of a buffer object, or NULL if pDisp is something else. Lets
+// pointer arguments take a buffer without any number conversion.
+void* GetNativeBufferData(IDispatch* pDisp)
+{
+    if (pDisp && pDisp->lpVtbl == &g_bufferVtbl)
+        return ((NativeBuffer*)pDisp)->data;
+    return NULL;
+}
+
+// Element address for buf.xxx(index), checked against the buffer bounds
+static HRESULT GetElementAddress(NativeBuffer* pBuffer, ParameterType type, VARIANT* pIndexArg, BYTE** ppElement)
+{
+    SIZE_T size = GetTypeSize(type);
+    LONG index;
+    
+    if (V_VT(pIndexArg) == VT_I4)
+    {
+        index = V_I4(pIndexArg);
+    }
+    else
+    {
+        VARIANT vTemp;
+        VariantInit(&vTemp);
+        HRESULT hr = VariantChangeType(&vTemp, pIndexArg, 0, VT_I4);
+        if (FAILED(hr))
+            return hr;
+        index = V_I4(&vTemp);
+    }
+    
+    if (index < 0 || (SIZE_T)index >= pBuffer->size / size)
+        return DISP_E_BADINDEX;
+    
+    *ppElement = pBuffer->data + (SIZE_T)index * size;
+    return S_OK;
+}
+
+// Store a script value in an element. Integers and doubles arriving in the
+// matching VARIANT type are stored without a conversion call; everything
+// else (VBScript VT_I2 literals, JScript doubles) is converted to exactly
+// the element type, so values out of its range are rejected, not truncated.
+static HRESULT StoreElement(BYTE* pElement, ParameterType type, VARIANT* pValue)
+{
+    if (V_VT(pValue) == VT_I4)
+    {
+        LONG value = V_I4(pValue);
+        switch (type)
+        {
+        case TYPE_CHAR:
+            if (value < -128 || value > 127)
+                return DISP_E_OVERFLOW;
+            *(CHAR*)pElement = (CHAR)value;
+            return S_OK;
+        case TYPE_UCHAR:
+            if (value < 0 || value > 255)
+                return DISP_E_OVERFLOW;
+            *(BYTE*)pElement = (BYTE)value;
+            return S_OK;
+        case TYPE_SHORT:
+            if (value < -32768 || value > 32767)
+                return DISP_E_OVERFLOW;
+            *(SHORT*)pElement = (SHORT)value;
+            return S_OK;
+        case TYPE_USHORT:
+            if (value < 0 || value > 65535)
+                return DISP_E_OVERFLOW;
+            *(USHORT*)pElement = (USHORT)value;
+            return S_OK;
+        case TYPE_LONG:
+            *(LONG*)pElement = value;
+            return S_OK;
+        case TYPE_ULONG:
+            if (value < 0)
+                return DISP_E_OVERFLOW;
+            *(ULONG*)pElement = (ULONG)value;
+            return S_OK;
+        default:
+            break;
+        }
+    }
+    else if (V_VT(pValue) == VT_R8 && type == TYPE_DOUBLE)
+    {
+        *(DOUBLE*)pElement = V_R8(pValue);
+        return S_OK;
+    }
+    
+    if (type == TYPE_POINTER)
+        return ConvertVariantToType(pValue, TYPE_POINTER, pElement, NULL, NULL);
+    
+    // WriteTypedValue converts to the exact VARIANT type of each element
+    // (VT_I4 for i32, VT_UI4 for u32, ...), which fails on overflow
+    return WriteTypedValue(pElement, type, pValue);
+}
+
+// NativeBuffer IDispatch implementation
+
+static HRESULT STDMETHODCALLTYPE Buffer_QueryInterface(IDispatch* This, REFIID riid, void** ppv)
+{
+    if (!ppv)
+        return E_POINTER;
+    
+    if (IsEqualIID(riid, &IID_IUnknown) || IsEqualIID(riid, &IID_IDispatch))
+    {
+        *ppv = This;
+        This->lpVtbl->AddRef(This);
+        return S_OK;
+    }
+    
+    *ppv = NULL;
+    return E_NOINTERFACE;
+}
+
+static ULONG STDMETHODCALLTYPE Buffer_AddRef(IDispatch* This)
+{
+    NativeBuffer* pBuffer = (NativeBuffer*)This;
+    return InterlockedIncrement(&pBuffer->refCount);
+}
+
+// The memory is freed as soon as the last reference goes away
+static ULONG STDMETHODCALLTYPE Buffer_Release(IDispatch* This)
+{
+    NativeBuffer* pBuffer = (NativeBuffer*)This;
+    LONG refCount = InterlockedDecrement(&pBuffer->refCount);
+    
+    if (refCount == 0)
+    {
+        HeapFree(g_bufferHeap, 0, pBuffer);
+        InterlockedDecrement(&g_cObjects);
+    }
+    return refCount;
+}
+
+static HRESULT STDMETHODCALLTYPE Buffer_GetTypeInfoCount(IDispatch* This, UINT* pctinfo)
+{
+    if (!pctinfo)
+        return E_POINTER;
+    *pctinfo = 0;
+    return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE Buffer_GetTypeInfo(IDispatch* This, UINT iTInfo, LCID lcid, ITypeInfo** ppTInfo)
+{
+    if (ppTInfo)
+        *ppTInfo = NULL;
+    return E_NOTIMPL;
+}
+
+static HRESULT STDMETHODCALLTYPE Buffer_GetIDsOfNames(IDispatch* This, REFIID riid, LPOLESTR* rgszNames,
+                                                      UINT cNames, LCID lcid, DISPID* rgDispId)
+{
+    HRESULT hr = S_OK;
+    
+    for (UINT n = 0; n < cNames; n++)
+    {
+        rgDispId[n] = DISPID_UNKNOWN;
+        
+        // Only the member name can be resolved; named arguments are not
+        if (n == 0)
+        {
+            if (_wcsicmp(rgszNames[0], L"ptr") == 0)
+                rgDispId[0] = DISPID_BUFFER_PTR;
+            else if (_wcsicmp(rgszNames[0], L"size") == 0)
+                rgDispId[0] = DISPID_BUFFER_SIZE;
+            else
+            {
+                for (int i = 0; i < (int)BUFFER_ACCESSOR_COUNT; i++)
+                {
+                    if (_wcsicmp(rgszNames[0], g_bufferAccessors[i].name) == 0)
+                    {
+                        rgDispId[0] = DISPID_BUFFER_ACCESSOR + i;
+                        break;
+                    }
+                }
+            }
+        }
+        if (rgDispId[n] == DISPID_UNKNOWN)
+            hr = DISP_E_UNKNOWNNAME;
+    }
+    return hr;
+}
+
+static HRESULT STDMETHODCALLTYPE Buffer_Invoke(IDispatch* This, DISPID dispIdMember, REFIID riid, LCID lcid,
+                                               WORD wFlags, DISPPARAMS* pDispParams, VARIANT* pVarResult,
+                                               EXCEPINFO* pExcepInfo, UINT* puArgErr)
+{
+    NativeBuffer* pBuffer = (NativeBuffer*)This;
+    UINT cArgs = pDispParams ? pDispParams->cArgs : 0;
+    
+    if (dispIdMember == DISPID_BUFFER_PTR || dispIdMember == DISPID_BUFFER_SIZE)
+    {
+        if (!(wFlags & (DISPATCH_PROPERTYGET | DISPATCH_METHOD)))
+            return DISP_E_MEMBERNOTFOUND;
+        if (cArgs != 0)
+            return DISP_E_BADPARAMCOUNT;
+        if (!pVarResult)
+            return S_OK;
+        
+        VariantInit(pVarResult);
+        if (dispIdMember == DISPID_BUFFER_PTR)
+            return ConvertTypeToVariant(&pBuffer->data, TYPE_POINTER, pVarResult);
+
+#ifdef _WIN64
+        if (pBuffer->size > 0x7FFFFFFF)
+        {
+            V_VT(pVarResult) = VT_R8;
+            V_R8(pVarResult) = (double)pBuffer->size;
+            return S_OK;
+        }
+#endif
+        V_VT(pVarResult) = VT_I4;
+        V_I4(pVarResult) = (LONG)pBuffer->size;
+        return S_OK;
+    }
+    
+    if (dispIdMember < DISPID_BUFFER_ACCESSOR || dispIdMember >= DISPID_BUFFER_ACCESSOR + (DISPID)BUFFER_ACCESSOR_COUNT)
+        return DISP_E_MEMBERNOTFOUND;
+    
+    ParameterType type = g_bufferAccessors[dispIdMember - DISPID_BUFFER_ACCESSOR].type;
+    BYTE* pElement;
+    HRESULT hr;
+    
+    // Write: buf.u32(i, value), or buf.u32(i) = value from VBScript
+    // (arguments arrive in reverse order, so the value is rgvarg[0])
+    if (cArgs == 2 && (wFlags & (DISPATCH_METHOD | DISPATCH_PROPERTYPUT)))
+    {
+        hr = GetElementAddress(pBuffer, type, &pDispParams->rgvarg[1], &pElement);
+        if (FAILED(hr))
+            return hr;
+        
+        VARIANT* pValue = &pDispParams->rgvarg[0];
+        if (V_VT(pValue) == (VT_VARIANT | VT_BYREF))
+            pValue = V_VARIANTREF(pValue);
+        return StoreElement(pElement, type, pValue);
+    }
+    
+    // Read: buf.u32(i)
+    if (cArgs != 1)
+        return DISP_E_BADPARAMCOUNT;
+    hr = GetElementAddress(pBuffer, type, &pDispParams->rgvarg[0], &pElement);
+    if (FAILED(hr))
+        return hr;
+    if (pVarResult)
+    {
+        VariantInit(pVarResult);
+        ReadTypedValue(pElement, type, pVarResult);
+    }
+    return S_OK;
+}
+
+static IDispatchVtbl g_bufferVtbl = {
+    Buffer_QueryInterface,
+    Buffer_AddRef,
+    Buffer_Release,
+    Buffer_GetTypeInfoCount,
+    Buffer_GetTypeInfo,
+    Buffer_GetIDsOfNames,
+    Buffer_Invoke
+};
@@ -117,9 +117,72 @@ if errorlevel 1 (
     exit /b 1
 )
 
+cl !CFLAGS! /c ..\..\thunk.c /Fo:thunk.obj
+if errorlevel 1 (
+    echo Failed to compile thunk.c for x64
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\arena.c /Fo:arena.obj
+if errorlevel 1 (
+    echo Failed to compile arena.c for x64
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\trace.c /Fo:trace.obj
+if errorlevel 1 (
+    echo Failed to compile trace.c for x64
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\stats.c /Fo:stats.obj
+if errorlevel 1 (
+    echo Failed to compile stats.c for x64
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\collector.c /Fo:collector.obj
+if errorlevel 1 (
+    echo Failed to compile collector.c for x64
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\async.c /Fo:async.obj
+if errorlevel 1 (
+    echo Failed to compile async.c for x64
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\struct.c /Fo:struct.obj
+if errorlevel 1 (
+    echo Failed to compile struct.c for x64
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\buffer.c /Fo:buffer.obj
+if errorlevel 1 (
+    echo Failed to compile buffer.c for x64
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\transcode.c /Fo:transcode.obj
+if errorlevel 1 (
+    echo Failed to compile transcode.c for x64
+    popd
+    exit /b 1
+)
+
 REM Link the x64 DLL
 echo Linking x64 DLL...
-link !LDFLAGS! /OUT:dynwrapx.dll /DEF:..\dynwrapx.def main.obj dynwrapx.obj methods.obj factory.obj !LIBS!
+link !LDFLAGS! /OUT:dynwrapx.dll /DEF:..\dynwrapx.def main.obj dynwrapx.obj methods.obj factory.obj thunk.obj arena.obj trace.obj stats.obj collector.obj async.obj struct.obj buffer.obj transcode.obj !LIBS!
 if errorlevel 1 (
     echo Failed to link x64 DLL
     popd
@@ -171,9 +234,72 @@ if errorlevel 1 (
     exit /b 1
 )
 
+cl !CFLAGS! /c ..\..\thunk.c /Fo:thunk.obj
+if errorlevel 1 (
+    echo Failed to compile thunk.c for x86
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\arena.c /Fo:arena.obj
+if errorlevel 1 (
+    echo Failed to compile arena.c for x86
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\trace.c /Fo:trace.obj
+if errorlevel 1 (
+    echo Failed to compile trace.c for x86
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\stats.c /Fo:stats.obj
+if errorlevel 1 (
+    echo Failed to compile stats.c for x86
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\collector.c /Fo:collector.obj
+if errorlevel 1 (
+    echo Failed to compile collector.c for x86
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\async.c /Fo:async.obj
+if errorlevel 1 (
+    echo Failed to compile async.c for x86
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\struct.c /Fo:struct.obj
+if errorlevel 1 (
+    echo Failed to compile struct.c for x86
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\buffer.c /Fo:buffer.obj
+if errorlevel 1 (
+    echo Failed to compile buffer.c for x86
+    popd
+    exit /b 1
+)
+
+cl !CFLAGS! /c ..\..\transcode.c /Fo:transcode.obj
+if errorlevel 1 (
+    echo Failed to compile transcode.c for x86
+    popd
+    exit /b 1
+)
+
 REM Link the x86 DLL
 echo Linking x86 DLL...
-link !LDFLAGS! /OUT:dynwrapx.dll /DEF:..\dynwrapx.def main.obj dynwrapx.obj methods.obj factory.obj !LIBS!
+link !LDFLAGS! /OUT:dynwrapx.dll /DEF:..\dynwrapx.def main.obj dynwrapx.obj methods.obj factory.obj thunk.obj arena.obj trace.obj stats.obj collector.obj async.obj struct.obj buffer.obj transcode.obj !LIBS!
 if errorlevel 1 (
     echo Failed to link x86 DLL
     popd
@@ -102,10 +102,19 @@ $CC $CFLAGS -c ../../main.c -o main.o || exit 1
 $CC $CFLAGS -c ../../dynwrapx.c -o dynwrapx.o || exit 1
 $CC $CFLAGS -c ../../methods.c -o methods.o || exit 1
 $CC $CFLAGS -c ../../factory.c -o factory.o || exit 1
+$CC $CFLAGS -c ../../thunk.c -o thunk.o || exit 1
+$CC $CFLAGS -c ../../arena.c -o arena.o || exit 1
+$CC $CFLAGS -c ../../trace.c -o trace.o || exit 1
+$CC $CFLAGS -c ../../stats.c -o stats.o || exit 1
+$CC $CFLAGS -c ../../collector.c -o collector.o || exit 1
+$CC $CFLAGS -c ../../async.c -o async.o || exit 1
+$CC $CFLAGS -c ../../struct.c -o struct.o || exit 1
+$CC $CFLAGS -c ../../buffer.c -o buffer.o || exit 1
+$CC $CFLAGS -c ../../transcode.c -o transcode.o || exit 1
 
 # Link the x64 DLL
 echo "Linking x64 DLL..."
-$CC $LDFLAGS -o dynwrapx.dll main.o dynwrapx.o methods.o factory.o ../dynwrapx.def $LIBS || exit 1
+$CC $LDFLAGS -o dynwrapx.dll main.o dynwrapx.o methods.o factory.o thunk.o arena.o trace.o stats.o collector.o async.o struct.o buffer.o transcode.o ../dynwrapx.def $LIBS || exit 1
 
 echo "x64 build completed: build/x64/dynwrapx.dll"
 
@@ -132,10 +141,19 @@ if [ "$BUILD_X86" = true ]; then
     $CC $CFLAGS -c ../../dynwrapx.c -o dynwrapx.o || exit 1
     $CC $CFLAGS -c ../../methods.c -o methods.o || exit 1
     $CC $CFLAGS -c ../../factory.c -o factory.o || exit 1
+    $CC $CFLAGS -c ../../thunk.c -o thunk.o || exit 1
+    $CC $CFLAGS -c ../../arena.c -o arena.o || exit 1
+    $CC $CFLAGS -c ../../trace.c -o trace.o || exit 1
+    $CC $CFLAGS -c ../../stats.c -o stats.o || exit 1
+    $CC $CFLAGS -c ../../collector.c -o collector.o || exit 1
+    $CC $CFLAGS -c ../../async.c -o async.o || exit 1
+    $CC $CFLAGS -c ../../struct.c -o struct.o || exit 1
+    $CC $CFLAGS -c ../../buffer.c -o buffer.o || exit 1
+    $CC $CFLAGS -c ../../transcode.c -o transcode.o || exit 1
     
     # Link the x86 DLL
     echo "Linking x86 DLL..."
-    $CC $LDFLAGS -o dynwrapx.dll main.o dynwrapx.o methods.o factory.o ../dynwrapx.def $LIBS || exit 1
+    $CC $LDFLAGS -o dynwrapx.dll main.o dynwrapx.o methods.o factory.o thunk.o arena.o trace.o stats.o collector.o async.o struct.o buffer.o transcode.o ../dynwrapx.def $LIBS || exit 1
     
     echo "x86 build completed: build/x86/dynwrapx.dll"
     
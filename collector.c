@@ -0,0 +1,156 @@
+#include "dynwrapx.h"
+
+// Rows allocated the first time a collector stores something
+#define COLLECTOR_INITIAL_ROWS 64
+
+// Attach an empty row buffer to a callback, turning it into a collector
+HRESULT CreateCollector(CallbackInfo* pInfo, LONG maxItems, LONGLONG returnValue)
+{
+    CollectorBuffer* pCollector = (CollectorBuffer*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, sizeof(CollectorBuffer));
+    if (!pCollector)
+        return E_OUTOFMEMORY;
+    
+    pCollector->columns = pInfo->paramCount;
+    pCollector->maxItems = maxItems;
+    pCollector->returnValue = returnValue;
+    InitializeCriticalSection(&pCollector->cs);
+    
+    pInfo->collector = pCollector;
+    return S_OK;
+}
+
+void FreeCollector(CollectorBuffer* pCollector)
+{
+    if (pCollector->rows)
+    {
+        // Only rows [0, count) have been written
+        for (LONG i = 0; i < pCollector->count * pCollector->columns; i++)
+            VariantClear(&pCollector->rows[i]);
+        GlobalFree(pCollector->rows);
+    }
+    DeleteCriticalSection(&pCollector->cs);
+    GlobalFree(pCollector);
+}
+
+// Make room for one more row (caller holds pCollector->cs)
+static BOOL GrowCollector(CollectorBuffer* pCollector, int columns)
+{
+    if (pCollector->count < pCollector->capacity || columns == 0)
+        return TRUE;
+    
+    LONG capacity = pCollector->capacity ? pCollector->capacity * 2 : COLLECTOR_INITIAL_ROWS;
+    if (capacity > pCollector->maxItems)
+        capacity = pCollector->maxItems;
+    
+    VARIANT* rows = (VARIANT*)GlobalAlloc(GMEM_FIXED, (SIZE_T)capacity * columns * sizeof(VARIANT));
+    if (!rows)
+        return FALSE;
+    
+    // VARIANTs can be moved bitwise
+    if (pCollector->rows)
+    {
+        memcpy(rows, pCollector->rows, (SIZE_T)pCollector->count * columns * sizeof(VARIANT));
+        GlobalFree(pCollector->rows);
+    }
+    pCollector->rows = rows;
+    pCollector->capacity = capacity;
+    return TRUE;
+}
+
+// Called by the callback thunk instead of the script function: append the
+// arguments as one row and return the configured value. Once maxItems rows
+// are stored, further calls are dropped and return 0, which stops
+// EnumWindows-style enumerators.
+void CollectArguments(CallbackInfo* pInfo, const LONG_PTR* argSlots, LONGLONG* result)
+{
+    CollectorBuffer* pCollector = pInfo->collector;
+    int columns = pInfo->paramCount;
+    BOOL stored = FALSE;
+    
+    EnterCriticalSection(&pCollector->cs);
+    
+    if (pCollector->count < pCollector->maxItems && GrowCollector(pCollector, columns))
+    {
+        VARIANT* row = pCollector->rows + (SIZE_T)pCollector->count * columns;
+        for (int i = 0; i < columns; i++)
+        {
+            VariantInit(&row[i]);
+            if (FAILED(SetCallbackArgument(&argSlots[pInfo->slotIndex[i]], pInfo->paramTypes[i], &row[i])))
+                VariantInit(&row[i]);
+        }
+        pCollector->count++;
+        stored = TRUE;
+    }
+    else
+    {
+        pCollector->dropped++;
+    }
+    
+    LeaveCriticalSection(&pCollector->cs);
+    
+    *result = stored ? pCollector->returnValue : 0;
+}
+
+// Copy the stored rows into an array. Each row is an array of the
+// arguments, or the argument itself for one-parameter collectors. With
+// reset the buffer is emptied (its memory is kept for the next run).
+HRESULT GetCollectedRows(CallbackInfo* pInfo, BOOL reset, VARIANT* pResult)
+{
+    CollectorBuffer* pCollector = pInfo->collector;
+    int columns = pInfo->paramCount;
+    HRESULT hr = S_OK;
+    
+    EnterCriticalSection(&pCollector->cs);
+    
+    LONG count = pCollector->count;
+    VARIANT* items = (VARIANT*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, (count ? count : 1) * sizeof(VARIANT));
+    VARIANT* fields = (VARIANT*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, (columns ? columns : 1) * sizeof(VARIANT));
+    if (!items || !fields)
+        hr = E_OUTOFMEMORY;
+    
+    for (LONG r = 0; r < count && SUCCEEDED(hr); r++)
+    {
+        const VARIANT* row = pCollector->rows + (SIZE_T)r * columns;
+        if (columns == 1)
+        {
+            hr = VariantCopy(&items[r], (VARIANT*)&row[0]);
+            continue;
+        }
+        
+        for (int c = 0; c < columns; c++)
+            VariantInit(&fields[c]);
+        for (int c = 0; c < columns && SUCCEEDED(hr); c++)
+            hr = VariantCopy(&fields[c], (VARIANT*)&row[c]);
+        if (SUCCEEDED(hr))
+            hr = CreateVariantArray(fields, columns, &items[r]);
+        if (FAILED(hr))
+        {
+            for (int c = 0; c < columns; c++)
+                VariantClear(&fields[c]);
+        }
+    }
+    
+    if (SUCCEEDED(hr))
+        hr = CreateVariantArray(items, count, pResult);
+    if (FAILED(hr) && items)
+    {
+        for (LONG r = 0; r < count; r++)
+            VariantClear(&items[r]);
+    }
+    
+    if (SUCCEEDED(hr) && reset)
+    {
+        for (LONG i = 0; i < count * columns; i++)
+            VariantClear(&pCollector->rows[i]);
+        pCollector->count = 0;
+        pCollector->dropped = 0;
+    }
+    
+    LeaveCriticalSection(&pCollector->cs);
+    
+    if (items)
+        GlobalFree(items);
+    if (fields)
+        GlobalFree(fields);
+    return hr;
+}
@@ -35,16 +35,16 @@ HRESULT CreateDynamicWrapperX(IUnknown* pUnkOuter, REFIID riid, void** ppv)
         
     pObj->vtbl.lpVtbl = &DynWrapVtbl;
     pObj->refCount = 1;
-    pObj->functionList = NULL;
+    pObj->functionTable = NULL;
+    pObj->nameTable = NULL;
+    pObj->retiredTables = NULL;
     pObj->memoryBlocks = NULL;
-    
-    // Initialize callbacks array
-    for (int i = 0; i < 16; i++)
-    {
-        pObj->callbacks[i].scriptFunction = NULL;
-        pObj->callbacks[i].paramTypes = NULL;
-        pObj->callbacks[i].callbackIndex = -1;
-    }
+    pObj->openScope = NULL;
+    pObj->moduleCache = NULL;
+    pObj->callbacks = NULL;
+    pObj->asyncCalls = NULL;
+    pObj->asyncEvent = NULL;
+    pObj->options = DYNWRAPX_OPTION_STATS;
     
     InitializeCriticalSection(&pObj->cs);
     
@@ -90,33 +90,29 @@ static ULONG STDMETHODCALLTYPE DynWrap_Release(IDynamicWrapperX* This)
     
     if (refs == 0)
     {
-        // Cleanup function list
-        FunctionInfo* pFunc = pObj->functionList;
-        while (pFunc)
-        {
-            FunctionInfo* pNext = pFunc->next;
-            SAFE_SYSFREE(pFunc->functionName);
-            if (pFunc->paramTypes)
-                GlobalFree(pFunc->paramTypes);
-            GlobalFree(pFunc);
-            pFunc = pNext;
-        }
+        // Cleanup registered functions
+        FreeFunctionTable(pObj);
+        
+        // Undelivered asynchronous calls reference the callbacks
+        FreeAsyncCalls(pObj);
         
-        // Cleanup callbacks
-        for (int i = 0; i < 16; i++)
+        // Cleanup callbacks (their thunks go back to the thunk pool)
+        while (pObj->callbacks)
         {
-            if (pObj->callbacks[i].scriptFunction)
-            {
-                SAFE_RELEASE(pObj->callbacks[i].scriptFunction);
-                if (pObj->callbacks[i].paramTypes)
-                    GlobalFree(pObj->callbacks[i].paramTypes);
-                g_callbackObjects[i] = NULL;
-            }
+            CallbackInfo* pNext = pObj->callbacks->next;
+            FreeCallbackInfo(pObj->callbacks);
+            pObj->callbacks = pNext;
         }
         
+        // Struct layouts (records hold a reference, so none are in use)
+        FreeStructDefs(pObj);
+        
         // Cleanup memory blocks
         CleanupMemoryBlocks(pObj);
         
+        // Release cached module handles
+        FreeModuleCache(pObj);
+        
         DeleteCriticalSection(&pObj->cs);
         GlobalFree(pObj);
         
@@ -143,6 +139,90 @@ static HRESULT STDMETHODCALLTYPE DynWrap_GetTypeInfo(IDynamicWrapperX* This, UIN
     return E_NOTIMPL;
 }
 
+// FNV-1a hash of a function name
+static ULONG HashFunctionName(LPCWSTR name)
+{
+    ULONG hash = 2166136261u;
+    while (*name)
+    {
+        hash ^= (ULONG)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Built-in method names. They take precedence over registered functions
+// and are found through a hash index built once at load time, so
+// GetIDsOfNames costs one hash and a probe or two per name.
+typedef struct _BuiltinMethod {
+    LPCWSTR name;
+    DISPID dispId;
+} BuiltinMethod;
+
+static const BuiltinMethod g_builtinMethods[] = {
+    { L"Register",              DISPID_REGISTER },
+    { L"RegisterCallback",      DISPID_REGISTERCALLBACK },
+    { L"NumGet",                DISPID_NUMGET },
+    { L"NumPut",                DISPID_NUMPUT },
+    { L"StrPtr",                DISPID_STRPTR },
+    { L"StrGet",                DISPID_STRGET },
+    { L"Space",                 DISPID_SPACE },
+    { L"Counter",               DISPID_COUNTER },
+    { L"RegisterMany",          DISPID_REGISTERMANY },
+    { L"SetOption",             DISPID_SETOPTION },
+    { L"BeginScope",            DISPID_BEGINSCOPE },
+    { L"EndScope",              DISPID_ENDSCOPE },
+    { L"FlushTrace",            DISPID_FLUSHTRACE },
+    { L"Stats",                 DISPID_STATS },
+    { L"ResetStats",            DISPID_RESETSTATS },
+    { L"RegisterCollector",     DISPID_REGISTERCOLLECTOR },
+    { L"Collected",             DISPID_COLLECTED },
+    { L"RegisterAsyncCallback", DISPID_REGISTERASYNCCALLBACK },
+    { L"PumpCallbacks",         DISPID_PUMPCALLBACKS },
+    { L"NumGetArray",           DISPID_NUMGETARRAY },
+    { L"NumPutArray",           DISPID_NUMPUTARRAY },
+    { L"DefineStruct",          DISPID_DEFINESTRUCT },
+    { L"ReadStruct",            DISPID_READSTRUCT },
+    { L"WriteStruct",           DISPID_WRITESTRUCT },
+    { L"Alloc",                 DISPID_ALLOC },
+    { L"FreeCallback",          DISPID_FREECALLBACK }
+};
+
+#define BUILTIN_METHOD_COUNT ((int)(sizeof(g_builtinMethods) / sizeof(g_builtinMethods[0])))
+#define BUILTIN_INDEX_SIZE 64  // Power of two, at least twice BUILTIN_METHOD_COUNT
+
+static ULONG g_builtinHashes[BUILTIN_METHOD_COUNT];
+static BYTE g_builtinIndex[BUILTIN_INDEX_SIZE];  // Method index + 1, 0 for an empty slot
+
+static FunctionInfo* FindFunctionByHash(DynamicWrapperX* pObj, LPCWSTR name, ULONG hash);
+
+void InitializeBuiltinMethods(void)
+{
+    for (int i = 0; i < BUILTIN_METHOD_COUNT; i++)
+    {
+        g_builtinHashes[i] = HashFunctionName(g_builtinMethods[i].name);
+        
+        int slot = (int)(g_builtinHashes[i] & (BUILTIN_INDEX_SIZE - 1));
+        while (g_builtinIndex[slot])
+            slot = (slot + 1) & (BUILTIN_INDEX_SIZE - 1);
+        g_builtinIndex[slot] = (BYTE)(i + 1);
+    }
+}
+
+// DISPID of a built-in method, or DISPID_UNKNOWN
+static DISPID FindBuiltinMethod(LPCWSTR name, ULONG hash)
+{
+    int slot = (int)(hash & (BUILTIN_INDEX_SIZE - 1));
+    while (g_builtinIndex[slot])
+    {
+        int i = g_builtinIndex[slot] - 1;
+        if (g_builtinHashes[i] == hash && wcscmp(g_builtinMethods[i].name, name) == 0)
+            return g_builtinMethods[i].dispId;
+        slot = (slot + 1) & (BUILTIN_INDEX_SIZE - 1);
+    }
+    return DISPID_UNKNOWN;
+}
+
 static HRESULT STDMETHODCALLTYPE DynWrap_GetIDsOfNames(IDynamicWrapperX* This, REFIID riid, LPOLESTR* rgszNames, UINT cNames, LCID lcid, DISPID* rgDispId)
 {
     DynamicWrapperX* pObj = (DynamicWrapperX*)This;
@@ -153,40 +233,15 @@ static HRESULT STDMETHODCALLTYPE DynWrap_GetIDsOfNames(IDynamicWrapperX* This, R
         
     for (UINT i = 0; i < cNames; i++)
     {
-        rgDispId[i] = DISPID_UNKNOWN;
-        
-        // Check built-in methods
-        if (wcscmp(rgszNames[i], L"Register") == 0)
-            rgDispId[i] = DISPID_REGISTER;
-        else if (wcscmp(rgszNames[i], L"RegisterCallback") == 0)
-            rgDispId[i] = DISPID_REGISTERCALLBACK;
-        else if (wcscmp(rgszNames[i], L"NumGet") == 0)
-            rgDispId[i] = DISPID_NUMGET;
-        else if (wcscmp(rgszNames[i], L"NumPut") == 0)
-            rgDispId[i] = DISPID_NUMPUT;
-        else if (wcscmp(rgszNames[i], L"StrPtr") == 0)
-            rgDispId[i] = DISPID_STRPTR;
-        else if (wcscmp(rgszNames[i], L"StrGet") == 0)
-            rgDispId[i] = DISPID_STRGET;
-        else if (wcscmp(rgszNames[i], L"Space") == 0)
-            rgDispId[i] = DISPID_SPACE;
-        else
+        // Built-in methods first, then registered functions, with one hash
+        ULONG hash = HashFunctionName(rgszNames[i]);
+        rgDispId[i] = FindBuiltinMethod(rgszNames[i], hash);
+        if (rgDispId[i] == DISPID_UNKNOWN)
         {
-            // Check registered functions
-            EnterCriticalSection(&pObj->cs);
-            FunctionInfo* pFunc = pObj->functionList;
-            while (pFunc)
-            {
-                if (wcscmp(rgszNames[i], pFunc->functionName) == 0)
-                {
-                    rgDispId[i] = pFunc->functionId;
-                    break;
-                }
-                pFunc = pFunc->next;
-            }
-            LeaveCriticalSection(&pObj->cs);
-            
-            if (rgDispId[i] == DISPID_UNKNOWN)
+            FunctionInfo* pFunc = FindFunctionByHash(pObj, rgszNames[i], hash);
+            if (pFunc)
+                rgDispId[i] = pFunc->functionId;
+            else
                 hr = DISP_E_UNKNOWNNAME;
         }
     }
@@ -232,26 +287,97 @@ static HRESULT STDMETHODCALLTYPE DynWrap_Invoke(IDynamicWrapperX* This, DISPID d
         case DISPID_SPACE:
             hr = DynWrap_Space(pObj, pDispParams, pVarResult);
             break;
+        
+        case DISPID_COUNTER:
+            hr = DynWrap_Counter(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_REGISTERMANY:
+            hr = DynWrap_RegisterMany(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_SETOPTION:
+            hr = DynWrap_SetOption(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_BEGINSCOPE:
+            hr = DynWrap_BeginScope(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_ENDSCOPE:
+            hr = DynWrap_EndScope(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_FLUSHTRACE:
+            hr = DynWrap_FlushTrace(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_STATS:
+            hr = DynWrap_Stats(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_RESETSTATS:
+            hr = DynWrap_ResetStats(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_REGISTERCOLLECTOR:
+            hr = DynWrap_RegisterCollector(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_COLLECTED:
+            hr = DynWrap_Collected(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_REGISTERASYNCCALLBACK:
+            hr = DynWrap_RegisterAsyncCallback(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_PUMPCALLBACKS:
+            hr = DynWrap_PumpCallbacks(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_NUMGETARRAY:
+            hr = DynWrap_NumGetArray(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_NUMPUTARRAY:
+            hr = DynWrap_NumPutArray(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_DEFINESTRUCT:
+            hr = DynWrap_DefineStruct(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_READSTRUCT:
+            hr = DynWrap_ReadStruct(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_WRITESTRUCT:
+            hr = DynWrap_WriteStruct(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_ALLOC:
+            hr = DynWrap_Alloc(pObj, pDispParams, pVarResult);
+            break;
+        
+        case DISPID_FREECALLBACK:
+            hr = DynWrap_FreeCallback(pObj, pDispParams, pVarResult);
+            break;
             
         default:
-            // Check if it's a registered function
+            // Check if it's a registered function. No lock is held across
+            // the call, so blocking APIs do not serialize other threads.
             DebugLog("DEBUG", "DynWrap_Invoke", "Looking for registered function with ID %ld", dispIdMember);
-            EnterCriticalSection(&pObj->cs);
-            FunctionInfo* pFunc = pObj->functionList;
-            while (pFunc)
+            FunctionInfo* pFunc = FindFunctionById(pObj, dispIdMember);
+            if (pFunc)
             {
-                if (pFunc->functionId == dispIdMember)
-                {
-                    DebugLog("DEBUG", "DynWrap_Invoke", "Found registered function: %S", pFunc->functionName ? pFunc->functionName : L"<unknown>");
-                    hr = CallRegisteredFunction(pObj, pFunc, pDispParams, pVarResult);
-                    break;
-                }
-                pFunc = pFunc->next;
+                DebugLog("DEBUG", "DynWrap_Invoke", "Found registered function: %S", pFunc->functionName ? pFunc->functionName : L"<unknown>");
+                hr = CallRegisteredFunction(pObj, pFunc, pDispParams, pVarResult);
             }
-            LeaveCriticalSection(&pObj->cs);
-            
-            if (!pFunc)
+            else
+            {
                 hr = DISP_E_MEMBERNOTFOUND;
+            }
             break;
         }
     }
@@ -263,57 +389,770 @@ static HRESULT STDMETHODCALLTYPE DynWrap_Invoke(IDynamicWrapperX* This, DISPID d
     return hr;
 }
 
+// Insert into the name table, replacing an existing entry with the same name.
+// The table must have at least one free slot. Each slot is written with one
+// interlocked store, so concurrent readers see either the old or new entry.
+static void InsertFunctionName(RegistryArray* table, FunctionInfo* pFunc)
+{
+    int mask = table->size - 1;
+    int slot = (int)(pFunc->nameHash & (ULONG)mask);
+    
+    while (table->items[slot])
+    {
+        if (table->items[slot]->nameHash == pFunc->nameHash &&
+            wcscmp(table->items[slot]->functionName, pFunc->functionName) == 0)
+            break;
+        slot = (slot + 1) & mask;
+    }
+    
+    InterlockedExchangePointer((PVOID volatile*)&table->items[slot], pFunc);
+}
+
+// Allocate a zeroed registry array with room for size entries
+static RegistryArray* AllocRegistryArray(int size)
+{
+    RegistryArray* pArray = (RegistryArray*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT,
+        sizeof(RegistryArray) + (size - 1) * sizeof(FunctionInfo*));
+    if (pArray)
+        pArray->size = size;
+    return pArray;
+}
+
+// Publish a replacement array; the old one stays valid for current readers
+static void ReplaceRegistryArray(DynamicWrapperX* pObj, RegistryArray* volatile* ppArray, RegistryArray* pNew)
+{
+    RegistryArray* pOld = (RegistryArray*)InterlockedExchangePointer((PVOID volatile*)ppArray, pNew);
+    if (pOld)
+    {
+        pOld->retiredNext = pObj->retiredTables;
+        pObj->retiredTables = pOld;
+    }
+}
+
+// Add a function to the registry and assign its DISPID (caller holds pObj->cs)
+HRESULT AddFunction(DynamicWrapperX* pObj, FunctionInfo* pFunc)
+{
+    RegistryArray* pTable = pObj->functionTable;
+    RegistryArray* pNames = pObj->nameTable;
+    int count = pObj->functionCount;
+    
+    // Grow the dense DISPID array geometrically so retired arrays stay bounded
+    if (!pTable || count == pTable->size)
+    {
+        RegistryArray* pNewTable = AllocRegistryArray(pTable ? pTable->size * 2 : 64);
+        if (!pNewTable)
+            return E_OUTOFMEMORY;
+        for (int i = 0; i < count; i++)
+            pNewTable->items[i] = pTable->items[i];
+        ReplaceRegistryArray(pObj, &pObj->functionTable, pNewTable);
+        pTable = pNewTable;
+    }
+    
+    // Keep the name table at most half full
+    if (!pNames || (count + 1) * 2 > pNames->size)
+    {
+        RegistryArray* pNewNames = AllocRegistryArray(pNames ? pNames->size * 2 : 128);
+        if (!pNewNames)
+            return E_OUTOFMEMORY;
+        for (int i = 0; pNames && i < pNames->size; i++)
+        {
+            if (pNames->items[i])
+                InsertFunctionName(pNewNames, pNames->items[i]);
+        }
+        ReplaceRegistryArray(pObj, &pObj->nameTable, pNewNames);
+        pNames = pNewNames;
+    }
+    
+    pFunc->nameHash = HashFunctionName(pFunc->functionName);
+    pFunc->functionId = DISPID_FUNCTION_BASE + count;
+    
+    // Fill the slot before publishing the new count
+    InterlockedExchangePointer((PVOID volatile*)&pTable->items[count], pFunc);
+    InterlockedExchange(&pObj->functionCount, count + 1);
+    
+    // A re-registered name now resolves to the newest entry; the old DISPID stays valid
+    InsertFunctionName(pNames, pFunc);
+    
+    DebugLog("DEBUG", "AddFunction", "Registered '%S' as DISPID %lu (%d functions)", pFunc->functionName, pFunc->functionId, count + 1);
+    return S_OK;
+}
+
+// Look up a registered function by name (lock-free)
+FunctionInfo* FindFunctionByName(DynamicWrapperX* pObj, LPCWSTR name)
+{
+    if (!name)
+        return NULL;
+    return FindFunctionByHash(pObj, name, HashFunctionName(name));
+}
+
+// Look up a registered function by name and its HashFunctionName hash
+static FunctionInfo* FindFunctionByHash(DynamicWrapperX* pObj, LPCWSTR name, ULONG hash)
+{
+    RegistryArray* pNames = pObj->nameTable;
+    if (!pNames)
+        return NULL;
+    
+    int mask = pNames->size - 1;
+    int slot = (int)(hash & (ULONG)mask);
+    
+    FunctionInfo* pFunc;
+    while ((pFunc = pNames->items[slot]) != NULL)
+    {
+        if (pFunc->nameHash == hash && wcscmp(pFunc->functionName, name) == 0)
+            return pFunc;
+        slot = (slot + 1) & mask;
+    }
+    
+    return NULL;
+}
+
+// Look up a registered function by DISPID (lock-free). The count is read
+// before the array, so the array is at least as new as the count.
+FunctionInfo* FindFunctionById(DynamicWrapperX* pObj, DISPID dispId)
+{
+    LONG count = pObj->functionCount;
+    if (dispId < DISPID_FUNCTION_BASE || dispId - DISPID_FUNCTION_BASE >= count)
+        return NULL;
+    
+    return pObj->functionTable->items[dispId - DISPID_FUNCTION_BASE];
+}
+
+// Free every registered function, both lookup tables and retired arrays
+void FreeFunctionTable(DynamicWrapperX* pObj)
+{
+    for (int i = 0; i < pObj->functionCount; i++)
+        FreeFunctionInfo(pObj->functionTable->items[i]);
+    
+    if (pObj->functionTable)
+        GlobalFree(pObj->functionTable);
+    if (pObj->nameTable)
+        GlobalFree(pObj->nameTable);
+    while (pObj->retiredTables)
+    {
+        RegistryArray* pNext = pObj->retiredTables->retiredNext;
+        GlobalFree(pObj->retiredTables);
+        pObj->retiredTables = pNext;
+    }
+    
+    pObj->functionTable = NULL;
+    pObj->nameTable = NULL;
+    pObj->functionCount = 0;
+}
+
+// Free a single FunctionInfo and the strings and arrays it owns
+void FreeFunctionInfo(FunctionInfo* pFunc)
+{
+    SAFE_SYSFREE(pFunc->functionName);
+    SAFE_SYSFREE(pFunc->libraryName);
+    if (pFunc->paramTypes)
+        GlobalFree(pFunc->paramTypes);
+    GlobalFree(pFunc);
+}
+
+void FreeCallbackInfo(CallbackInfo* pInfo)
+{
+    if (pInfo->thunk)
+        FreeCallbackThunk(pInfo->thunk);
+    SAFE_RELEASE(pInfo->scriptFunction);
+    if (pInfo->paramTypes)
+        GlobalFree(pInfo->paramTypes);
+    if (pInfo->frame)
+        GlobalFree(pInfo->frame);
+    if (pInfo->slotIndex)
+        GlobalFree(pInfo->slotIndex);
+    if (pInfo->collector)
+        FreeCollector(pInfo->collector);
+    GlobalFree(pInfo);
+}
+
+// Resolve a lazily registered function on its first call. Concurrent
+// callers may both look the symbol up; the first published pointer wins.
+static HRESULT ResolveLazyFunction(DynamicWrapperX* pObj, FunctionInfo* pFunc)
+{
+    if (!pFunc->libraryName)
+        return E_FAIL;
+    
+    FARPROC proc = LoadFunction(pObj, pFunc->libraryName, pFunc->functionName);
+    if (!proc)
+    {
+        DebugLog("ERROR", "ResolveLazyFunction", "Unresolved symbol '%S' in '%S'", pFunc->functionName, pFunc->libraryName);
+        return HRESULT_FROM_WIN32(ERROR_PROC_NOT_FOUND);
+    }
+    
+    if (InterlockedCompareExchangePointer((PVOID volatile*)&pFunc->functionPtr, (PVOID)proc, NULL) == NULL)
+        InterlockedIncrement(&pObj->lazyResolves);
+    
+    return S_OK;
+}
+
+// Hidden storage for one output parameter during a call. The native
+// function gets the address of value (numbers) or of the text buffer
+// (W/S/Z/A); after the call the result is written back to the script.
+typedef struct _OutArgument {
+    ParameterType type;
+    VARIANT* target;        // VT_BYREF argument to update, NULL when only returned in the OutArray result
+    LONGLONG value;         // Storage for numeric types (8 bytes covers every one)
+    void* text;             // String buffer for W/S/Z/A, NULL for a NULL string
+    UINT capacity;          // Characters (W) or bytes (S/Z/A) in text
+    BOOL sized;             // text was allocated from a capacity argument
+    LONG_PTR* frameSlot;    // Argument slot holding the address of the storage
+} OutArgument;
+
+// Times GrowRetry calls a function again with larger string buffers
+#define DYNWRAPX_GROW_RETRIES 3
+
+// String output types (W, S, Z, A)
+BOOL IsOutputText(ParameterType type)
+{
+    return type == TYPE_OUT_WSTRING || type == TYPE_OUT_ASTRING || type == TYPE_OUT_OSTRING ||
+           type == TYPE_OUT_USTRING;
+}
+
+// Input type matching an output type (L -> l, W -> w, ...)
+static ParameterType GetOutputValueType(ParameterType type)
+{
+    if (type >= TYPE_OUT_WSTRING)
+        return (ParameterType)(type - TYPE_OUT_WSTRING + TYPE_WSTRING);
+    return (ParameterType)(type - TYPE_OUT_LONG + TYPE_LONG);
+}
+
+// A number passed for W/S/Z/A: the size of the buffer to provide
+static BOOL IsCapacityArgument(VARIANT* pArg)
+{
+    if (V_VT(pArg) == (VT_BYREF | VT_VARIANT))
+        pArg = V_VARIANTREF(pArg);
+    
+    switch (V_VT(pArg) & ~VT_BYREF)
+    {
+    case VT_I1: case VT_UI1: case VT_I2: case VT_UI2:
+    case VT_I4: case VT_UI4: case VT_INT: case VT_UINT:
+    case VT_I8: case VT_UI8: case VT_R4: case VT_R8:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+// Point a sized string output at a buffer of capacity characters (W) or
+// bytes (S/Z/A), plus room for a terminator. Buffers come from the thread
+// arena, which is reused by every call, or the heap for large sizes.
+static HRESULT AllocOutBuffer(DynamicWrapperX* pObj, OutArgument* pOut, UINT capacity, CallScope* pScope)
+{
+    SIZE_T charSize = (pOut->type == TYPE_OUT_WSTRING) ? sizeof(WCHAR) : sizeof(CHAR);
+    SIZE_T bytes = ((SIZE_T)capacity + 1) * charSize;
+    
+    void* buffer = ArenaAlloc(bytes);
+    if (!buffer)
+    {
+        buffer = GlobalAlloc(GMEM_FIXED, bytes);
+        if (!buffer)
+            return E_OUTOFMEMORY;
+        InterlockedIncrement(&pObj->callAllocations);
+        HRESULT hr = TrackMemoryBlock(pObj, pScope, buffer, TRUE, bytes);
+        if (FAILED(hr))
+            return hr;
+    }
+    
+    // An empty string if the function writes nothing, and a terminator past
+    // the capacity for functions that fill the buffer completely
+    memset(buffer, 0, charSize);
+    memset((BYTE*)buffer + capacity * charSize, 0, charSize);
+    
+    pOut->text = buffer;
+    pOut->capacity = capacity;
+    *pOut->frameSlot = (LONG_PTR)buffer;
+    return S_OK;
+}
+
+// Set up an output argument. Returns S_FALSE when the argument is passed the
+// old way (the script supplies the address itself): neither a VBScript
+// variable, the OutArray option nor a string capacity.
+static HRESULT PrepareOutArgument(DynamicWrapperX* pObj, ParameterType type, VARIANT* pArg, BOOL outArray,
+                                  OutArgument* pOut, LONG_PTR* pSlot, CallScope* pScope)
+{
+    BOOL isText = IsOutputText(type);
+    BOOL byRef = (V_VT(pArg) & VT_BYREF) != 0;
+    BOOL missing = (V_VT(pArg) == VT_EMPTY || V_VT(pArg) == VT_ERROR);
+    HRESULT hr;
+    
+    if (isText && !missing && IsCapacityArgument(pArg))
+    {
+        VARIANT vTemp;
+        VariantInit(&vTemp);
+        hr = VariantChangeType(&vTemp, pArg, 0, VT_I4);
+        if (FAILED(hr))
+            return hr;
+        if (V_I4(&vTemp) <= 0 || V_I4(&vTemp) > 0x3FFFFFFF)
+            return E_INVALIDARG;
+        
+        pOut->type = type;
+        pOut->target = byRef ? pArg : NULL;
+        pOut->value = 0;
+        pOut->sized = TRUE;
+        pOut->frameSlot = pSlot;
+        return AllocOutBuffer(pObj, pOut, (UINT)V_I4(&vTemp), pScope);
+    }
+    
+    if (!byRef && !outArray)
+    {
+        // Numbers are the address of the caller's storage; strings are
+        // copied as for the input types
+        hr = ConvertVariantToType(pArg, isText ? type : TYPE_POINTER, pSlot, pObj, pScope);
+        return FAILED(hr) ? hr : S_FALSE;
+    }
+    
+    pOut->type = type;
+    pOut->target = byRef ? pArg : NULL;
+    pOut->value = 0;
+    pOut->text = NULL;
+    pOut->capacity = 0;
+    pOut->sized = FALSE;
+    pOut->frameSlot = pSlot;
+    
+    if (isText)
+    {
+        // The native function writes into a call-scoped copy of the string
+        hr = missing ? S_OK : ConvertVariantToType(pArg, type, &pOut->text, pObj, pScope);
+        if (FAILED(hr))
+            return hr;
+        if (pOut->text)
+        {
+            // The copy is as long as the script string, NULs included
+            // (Space(n, "") buffers), plus its terminator
+            BSTR* pSource = GetVariantBstr(pArg);
+            if (pSource && *pSource)
+            {
+                UINT length = SysStringLen(*pSource);
+                if (type != TYPE_OUT_WSTRING)
+                    length = (UINT)WideToNarrow(GetStringCodePage(type), *pSource, (int)length, NULL, 0);
+                pOut->capacity = length + 1;
+            }
+            else if (type == TYPE_OUT_WSTRING)
+                pOut->capacity = (UINT)wcslen((LPCWSTR)pOut->text) + 1;
+            else
+                pOut->capacity = (UINT)strlen((LPCSTR)pOut->text) + 1;
+        }
+        *pSlot = (LONG_PTR)pOut->text;
+        return S_OK;
+    }
+    
+    // Numbers start from the script's value (in/out parameters) or zero
+    if (!missing)
+    {
+        hr = ConvertVariantToType(pArg, type, &pOut->value, pObj, pScope);
+        if (FAILED(hr))
+            return hr;
+    }
+    *pSlot = (LONG_PTR)&pOut->value;
+    return S_OK;
+}
+
+// Integer result of a function, for string lengths and required sizes
+static BOOL GetReturnedCount(ParameterType returnType, const void* returnValue, LONG* pCount)
+{
+    if (!returnValue || (returnType != TYPE_LONG && returnType != TYPE_ULONG))
+        return FALSE;
+    *pCount = *(const LONG*)returnValue;
+    return TRUE;
+}
+
+// Characters (W) or bytes (S/Z/A) of a string output: up to the first NUL, or
+// up to the count the function returned when that spans several
+// NUL-separated strings (GetLogicalDriveStrings and other multi-strings)
+static UINT GetOutTextLength(const OutArgument* pOut, const LONG* pReturnedCount)
+{
+    BOOL wide = (pOut->type == TYPE_OUT_WSTRING);
+    UINT length = 0;
+    
+    if (wide)
+    {
+        while (length < pOut->capacity && ((LPCWSTR)pOut->text)[length])
+            length++;
+    }
+    else
+    {
+        while (length < pOut->capacity && ((LPCSTR)pOut->text)[length])
+            length++;
+    }
+    
+    if (pOut->sized && pReturnedCount && *pReturnedCount > (LONG)length + 1 && (UINT)*pReturnedCount < pOut->capacity)
+    {
+        UINT count = (UINT)*pReturnedCount;
+        if (wide ? ((LPCWSTR)pOut->text)[count] == 0 : ((LPCSTR)pOut->text)[count] == 0)
+            length = count;
+    }
+    return length;
+}
+
+// Read an output argument's storage as a script value
+static HRESULT GetOutArgumentValue(const OutArgument* pOut, const LONG* pReturnedCount, VARIANT* pValue)
+{
+    VariantInit(pValue);
+    
+    if (pOut->type == TYPE_OUT_WSTRING)
+    {
+        LPCWSTR text = (LPCWSTR)pOut->text;
+        UINT length = GetOutTextLength(pOut, pReturnedCount);
+        V_VT(pValue) = VT_BSTR;
+        V_BSTR(pValue) = SysAllocStringLen(text, length);
+        return V_BSTR(pValue) ? S_OK : E_OUTOFMEMORY;
+    }
+    
+    if (IsOutputText(pOut->type))
+    {
+        int length = (int)GetOutTextLength(pOut, pReturnedCount);
+        BSTR result = NarrowToBstr(GetStringCodePage(pOut->type), (LPCSTR)pOut->text, length);
+        if (!result)
+            return E_OUTOFMEMORY;
+        V_VT(pValue) = VT_BSTR;
+        V_BSTR(pValue) = result;
+        return S_OK;
+    }
+    
+    return ConvertTypeToVariant((void*)&pOut->value, GetOutputValueType(pOut->type), pValue);
+}
+
+// Bytes a typed VT_BYREF argument holds, 0 for types outputs cannot be
+// stored into
+static SIZE_T GetByRefSize(VARTYPE vt)
+{
+    switch (vt)
+    {
+    case VT_I1: case VT_UI1:
+        return 1;
+    case VT_I2: case VT_UI2: case VT_BOOL:
+        return 2;
+    case VT_I4: case VT_UI4: case VT_INT: case VT_UINT: case VT_R4: case VT_ERROR:
+        return 4;
+    case VT_I8: case VT_UI8: case VT_R8: case VT_CY: case VT_DATE:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+// Convert an output value to the type of the VT_BYREF argument it goes to,
+// so that WriteBackArgument cannot fail; takes ownership of pValue and
+// leaves it VT_EMPTY on failure
+static HRESULT ConvertForWriteBack(VARIANT* pTarget, VARIANT* pValue)
+{
+    VARTYPE vt = V_VT(pTarget) & ~VT_BYREF;
+    VARIANT converted;
+    
+    // VBScript variables take the value as it is
+    if (vt == VT_VARIANT)
+        return S_OK;
+    
+    // Typed references (VB6/VBA): convert to the variable's type
+    VariantInit(&converted);
+    HRESULT hr = (vt == VT_BSTR || GetByRefSize(vt)) ? VariantChangeType(&converted, pValue, 0, vt) : DISP_E_TYPEMISMATCH;
+    VariantClear(pValue);
+    *pValue = converted;
+    return hr;
+}
+
+// Store a value prepared by ConvertForWriteBack into a VT_BYREF argument;
+// takes ownership of pValue
+static void WriteBackArgument(VARIANT* pTarget, VARIANT* pValue)
+{
+    VARTYPE vt = V_VT(pTarget) & ~VT_BYREF;
+    
+    if (vt == VT_VARIANT)
+    {
+        VariantClear(V_VARIANTREF(pTarget));
+        *V_VARIANTREF(pTarget) = *pValue;
+    }
+    else if (vt == VT_BSTR)
+    {
+        SysFreeString(*V_BSTRREF(pTarget));
+        *V_BSTRREF(pTarget) = V_BSTR(pValue);
+    }
+    else
+    {
+        // Every union member starts at the same address
+        memcpy(V_BYREF(pTarget), &V_I8(pValue), GetByRefSize(vt));
+    }
+    VariantInit(pValue);
+}
+
+// Deliver output values after a successful call: into VT_BYREF arguments,
+// and with the OutArray option as [result, outputs...] in *pVarResult
+// (hasResult is FALSE for void functions, which leave *pVarResult unset).
+// Without OutArray, the first string output sized by a capacity argument
+// replaces the function result. Every value is converted before anything
+// is stored, so on failure the script's variables and *pVarResult are
+// unchanged.
+static HRESULT CompleteOutArguments(OutArgument* outArgs, int outUsed, BOOL outArray, BOOL hasResult,
+                                    const LONG* pReturnedCount, VARIANT* pVarResult)
+{
+    HRESULT hr = S_OK;
+    BOOL onHeap = FALSE;
+    int returnedIndex = -1;
+    
+    // values[i] is what goes to output i's variable; with OutArray,
+    // items holds the result array elements after them
+    SIZE_T size = (outArray ? 2 * outUsed + 1 : outUsed) * sizeof(VARIANT);
+    VARIANT* values = (VARIANT*)ArenaAlloc(size);
+    if (!values)
+    {
+        values = (VARIANT*)GlobalAlloc(GMEM_FIXED, size);
+        if (!values)
+            return E_OUTOFMEMORY;
+        onHeap = TRUE;
+    }
+    VARIANT* items = outArray ? values + outUsed : NULL;
+    for (int i = 0; i < outUsed; i++)
+        VariantInit(&values[i]);
+    if (items)
+    {
+        for (int i = 0; i <= outUsed; i++)
+            VariantInit(&items[i]);
+    }
+    
+    for (int i = 0; i < outUsed && SUCCEEDED(hr); i++)
+    {
+        // NULL string buffers leave the variable unchanged
+        if (!outArgs[i].text && IsOutputText(outArgs[i].type))
+            continue;
+        
+        hr = GetOutArgumentValue(&outArgs[i], pReturnedCount, &values[i]);
+        if (FAILED(hr))
+            break;
+        
+        if (items)
+        {
+            if (outArgs[i].target)
+                hr = VariantCopy(&items[i + 1], &values[i]);
+            else
+            {
+                items[i + 1] = values[i];
+                VariantInit(&values[i]);
+            }
+        }
+        else if (!outArgs[i].target && returnedIndex < 0 && pVarResult)
+        {
+            // A sized string passed by value
+            returnedIndex = i;
+        }
+        
+        if (SUCCEEDED(hr) && outArgs[i].target)
+            hr = ConvertForWriteBack(outArgs[i].target, &values[i]);
+    }
+    
+    // The result array takes the function result as its first element
+    VARIANT array;
+    VariantInit(&array);
+    if (SUCCEEDED(hr) && items && pVarResult)
+    {
+        if (hasResult)
+            items[0] = *pVarResult;
+        hr = CreateVariantArray(items, outUsed + 1, &array);
+        VariantInit(&items[0]);     // Still owned by *pVarResult on failure
+    }
+    
+    if (SUCCEEDED(hr))
+    {
+        for (int i = 0; i < outUsed; i++)
+        {
+            if (outArgs[i].target && (outArgs[i].text || !IsOutputText(outArgs[i].type)))
+                WriteBackArgument(outArgs[i].target, &values[i]);
+        }
+        
+        if (items && pVarResult)
+        {
+            *pVarResult = array;
+        }
+        else if (returnedIndex >= 0)
+        {
+            if (hasResult)
+                VariantClear(pVarResult);
+            *pVarResult = values[returnedIndex];
+            VariantInit(&values[returnedIndex]);
+        }
+    }
+    
+    for (int i = 0; i < outUsed; i++)
+        VariantClear(&values[i]);
+    if (items && (FAILED(hr) || !pVarResult))
+    {
+        for (int i = 1; i <= outUsed; i++)
+            VariantClear(&items[i]);
+    }
+    if (onHeap)
+        GlobalFree(values);
+    return hr;
+}
+
+// GrowRetry: give a sized string output a larger buffer when the size the
+// function reported does not fit its capacity, and store the new capacity
+// in the argument marked as its size. Returns S_FALSE if it already fits.
+static HRESULT GrowOutBuffer(DynamicWrapperX* pObj, OutArgument* pOut, LONG required, LONG* pSize, CallScope* pScope)
+{
+    if (required < (LONG)pOut->capacity || required > 0x3FFFFFFF)
+        return S_FALSE;
+    
+    // Functions that truncate return the capacity itself, so at least double
+    UINT capacity = (UINT)required + 1;
+    if (capacity < pOut->capacity * 2 && pOut->capacity <= 0x1FFFFFFF)
+        capacity = pOut->capacity * 2;
+    
+    DebugLog("DEBUG", "GrowOutBuffer", "Growing output from %u to %u", pOut->capacity, capacity);
+    HRESULT hr = AllocOutBuffer(pObj, pOut, capacity, pScope);
+    if (FAILED(hr))
+        return hr;
+    *pSize = (LONG)capacity;
+    return S_OK;
+}
+
 // Call a registered function
 HRESULT CallRegisteredFunction(DynamicWrapperX* pObj, FunctionInfo* pFunc, DISPPARAMS* pDispParams, VARIANT* pVarResult)
 {
     HRESULT hr = S_OK;
-    void** args = NULL;
-    void* returnValue = NULL;
+    LONG_PTR inlineFrame[DYNWRAPX_INLINE_FRAME_SLOTS];
+    LONG_PTR* argFrame = inlineFrame;
+    ULONGLONG returnSlot = 0;   // Wide enough for q/d returns on either architecture
+    void* returnValue = (pFunc->returnType != TYPE_VOID) ? &returnSlot : NULL;
+    CallScope callScope = { NULL, NULL, NULL }; // Temporary strings and pinned arrays, released on return
+    BOOL frameOnHeap = FALSE;
+    LARGE_INTEGER start, converted, called, end;
+    BOOL timed = (pObj->options & (DYNWRAPX_OPTION_TRACE | DYNWRAPX_OPTION_STATS)) != 0;
+    OutArgument* outArgs = NULL;
+    BOOL outOnHeap = FALSE;
+    BOOL outArray = FALSE;
+    int outUsed = 0;
+    OutArgument* pGrowOut = NULL;       // GrowRetry: sized output linked to a '#' size argument
+    LONG* pGrowSize = NULL;             // and the storage the function reads that size from
+    
+    // Phase timestamps for statistics and tracing; 0 marks a phase not reached
+    converted.QuadPart = 0;
+    called.QuadPart = 0;
+    if (timed)
+        QueryPerformanceCounter(&start);
+    
+    // Everything taken from the thread arena below is released on return
+    SIZE_T arenaMark = ArenaMark();
     
     if (!pFunc->functionPtr)
-        return E_FAIL;
+    {
+        hr = ResolveLazyFunction(pObj, pFunc);
+        if (FAILED(hr))
+            goto cleanup;
+    }
     
-    // Allocate memory for arguments
-    if (pFunc->paramCount > 0)
+    // The frame size is fixed at registration; oversized frames use the
+    // arena and only touch the heap when it is exhausted
+    if (pFunc->frameSlots > DYNWRAPX_INLINE_FRAME_SLOTS)
     {
-        args = (void**)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, pFunc->paramCount * sizeof(void*));
-        if (!args)
-            return E_OUTOFMEMORY;
-        
-        // Convert parameters
-        for (int i = 0; i < pFunc->paramCount && i < (int)pDispParams->cArgs; i++)
+        argFrame = (LONG_PTR*)ArenaAlloc(pFunc->frameSlots * sizeof(LONG_PTR));
+        if (!argFrame)
         {
-            VARIANT* pArg = &pDispParams->rgvarg[pDispParams->cArgs - 1 - i]; // Parameters are in reverse order
-            
-            // Allocate space for the parameter
-            size_t argSize = GetTypeSize(pFunc->paramTypes[i]);
-            args[i] = GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, argSize);
-            if (!args[i])
+            argFrame = (LONG_PTR*)GlobalAlloc(GMEM_FIXED, pFunc->frameSlots * sizeof(LONG_PTR));
+            if (!argFrame)
+            {
+                hr = E_OUTOFMEMORY;
+                goto cleanup;
+            }
+            InterlockedIncrement(&pObj->callAllocations);
+            frameOnHeap = TRUE;
+        }
+    }
+    
+    // Output parameters need storage that outlives their conversion
+    if (pFunc->outCount > 0)
+    {
+        outArray = (pObj->options & DYNWRAPX_OPTION_OUTARRAY) != 0;
+        outArgs = (OutArgument*)ArenaAlloc(pFunc->outCount * sizeof(OutArgument));
+        if (!outArgs)
+        {
+            outArgs = (OutArgument*)GlobalAlloc(GMEM_FIXED, pFunc->outCount * sizeof(OutArgument));
+            if (!outArgs)
             {
                 hr = E_OUTOFMEMORY;
                 goto cleanup;
             }
+            InterlockedIncrement(&pObj->callAllocations);
+            outOnHeap = TRUE;
+        }
+    }
+    
+    if (pFunc->frameSlots > 0)
+    {
+        memset(argFrame, 0, pFunc->frameSlots * sizeof(LONG_PTR));
+        
+        // Convert parameters straight into their slots. With OutArray the
+        // trailing output arguments may be omitted and still get storage.
+        VARIANT missingArg;
+        VariantInit(&missingArg);
+        int slot = 0;
+        for (int i = 0; i < pFunc->paramCount; i++)
+        {
+            VARIANT* pArg;
+            if (i < (int)pDispParams->cArgs)
+                pArg = &pDispParams->rgvarg[pDispParams->cArgs - 1 - i]; // Parameters are in reverse order
+            else if (outArray && IsOutputType(pFunc->paramTypes[i]))
+                pArg = &missingArg;
+            else
+                break;
             
-            hr = ConvertVariantToType(pArg, pFunc->paramTypes[i], args[i], pObj);
+            if (outArgs && IsOutputType(pFunc->paramTypes[i]))
+            {
+                hr = PrepareOutArgument(pObj, pFunc->paramTypes[i], pArg, outArray, &outArgs[outUsed], &argFrame[slot], &callScope);
+                if (hr == S_OK)
+                {
+                    if (i == pFunc->sizeOutput && outArgs[outUsed].sized)
+                        pGrowOut = &outArgs[outUsed];
+                    else if (i == pFunc->sizeParam)
+                        pGrowSize = (LONG*)&outArgs[outUsed].value;
+                    outUsed++;
+                }
+            }
+            else
+            {
+                hr = ConvertVariantToType(pArg, pFunc->paramTypes[i], &argFrame[slot], pObj, &callScope);
+                if (i == pFunc->sizeParam)
+                    pGrowSize = (LONG*)&argFrame[slot];
+            }
             if (FAILED(hr))
                 goto cleanup;
+            slot += GetArgSlotCount(pFunc->paramTypes[i]);
         }
     }
     
-    // Allocate space for return value
-    if (pFunc->returnType != TYPE_VOID)
+    if (timed)
+        QueryPerformanceCounter(&converted);
+    
+    // Call the function through its precompiled thunk
+    hr = CallFunction(pFunc, argFrame, returnValue);
+    
+    // GrowRetry: a reported size above the capacity of the string output
+    // linked to a '#' size argument means the buffer was too small, so call
+    // again with a larger buffer and that size argument updated. The size
+    // comes from the size argument itself when it is an output (L, U), and
+    // from the function result otherwise.
+    if (pGrowOut && pGrowSize && (pObj->options & DYNWRAPX_OPTION_GROWRETRY))
     {
-        size_t retSize = GetTypeSize(pFunc->returnType);
-        returnValue = GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, retSize);
-        if (!returnValue)
+        BOOL sizeIsOutput = IsOutputType(pFunc->paramTypes[pFunc->sizeParam]);
+        LONG required;
+        for (int retry = 0; retry < DYNWRAPX_GROW_RETRIES && SUCCEEDED(hr); retry++)
         {
-            hr = E_OUTOFMEMORY;
-            goto cleanup;
+            if (sizeIsOutput)
+                required = *pGrowSize;
+            else if (!GetReturnedCount(pFunc->returnType, returnValue, &required))
+                break;
+            
+            HRESULT hrGrow = GrowOutBuffer(pObj, pGrowOut, required, pGrowSize, &callScope);
+            if (hrGrow != S_OK)
+            {
+                if (FAILED(hrGrow))
+                    hr = hrGrow;
+                break;
+            }
+            hr = CallFunction(pFunc, argFrame, returnValue);
         }
     }
     
-    // Call the function using inline assembly or a generic caller
-    hr = CallFunction(pFunc->functionPtr, args, pFunc->paramCount, returnValue);
+    if (timed)
+        QueryPerformanceCounter(&called);
     
     // Convert return value
     if (SUCCEEDED(hr) && pVarResult && returnValue)
@@ -330,20 +1169,36 @@ HRESULT CallRegisteredFunction(DynamicWrapperX* pObj, FunctionInfo* pFunc, DISPP
         }
     }
     
-cleanup:
-    // Cleanup arguments
-    if (args)
+    // Outputs are read before the call scope releases their buffers
+    if (SUCCEEDED(hr) && outUsed > 0)
     {
-        for (int i = 0; i < pFunc->paramCount; i++)
-        {
-            if (args[i])
-                GlobalFree(args[i]);
-        }
-        GlobalFree(args);
+        LONG returnedCount;
+        BOOL hasCount = GetReturnedCount(pFunc->returnType, returnValue, &returnedCount);
+        hr = CompleteOutArguments(outArgs, outUsed, outArray, returnValue != NULL,
+                                  hasCount ? &returnedCount : NULL, pVarResult);
+        
+        // The converted result is not returned to the caller on failure
+        if (FAILED(hr) && pVarResult && returnValue)
+            VariantClear(pVarResult);
     }
+
+cleanup:
+    FreeMemoryBlocks(pObj, callScope.blocks);
+    UnpinArrays(callScope.pinned);
+    if (outOnHeap)
+        GlobalFree(outArgs);
+    if (frameOnHeap)
+        GlobalFree(argFrame);
+    ArenaReset(arenaMark);
     
-    if (returnValue)
-        GlobalFree(returnValue);
+    if (timed)
+    {
+        QueryPerformanceCounter(&end);
+        if (pObj->options & DYNWRAPX_OPTION_STATS)
+            RecordCallStats(pFunc, start.QuadPart, converted.QuadPart, called.QuadPart, end.QuadPart, hr);
+        if (pObj->options & DYNWRAPX_OPTION_TRACE)
+            TraceCall(pObj, pFunc->functionId, pDispParams->cArgs, start.QuadPart, end.QuadPart, hr);
+    }
     
     return hr;
 }
@@ -391,9 +1246,11 @@ size_t GetTypeSize(ParameterType type)
     case TYPE_WSTRING:
     case TYPE_ASTRING:
     case TYPE_OSTRING:
+    case TYPE_USTRING:
     case TYPE_OUT_WSTRING:
     case TYPE_OUT_ASTRING:
     case TYPE_OUT_OSTRING:
+    case TYPE_OUT_USTRING:
         return sizeof(void*);
         
     case TYPE_VOID:
@@ -404,105 +1261,80 @@ size_t GetTypeSize(ParameterType type)
     }
 }
 
-// Enhanced generic function caller supporting more parameters
-HRESULT CallFunction(FARPROC proc, void** args, int argCount, void* returnValue)
+// Uppercase parameter types, whose argument receives a result
+BOOL IsOutputType(ParameterType type)
 {
+    return type >= TYPE_OUT_LONG && type <= TYPE_OUT_USTRING;
+}
 
-    DebugLog("DEBUG", "CallFunction", "Starting function call: proc=0x%p, argCount=%d, returnValue=0x%p", proc, argCount, returnValue);
-    
-    typedef LONG_PTR (WINAPI *GenericFunc0)(void);
-    typedef LONG_PTR (WINAPI *GenericFunc1)(LONG_PTR);
-    typedef LONG_PTR (WINAPI *GenericFunc2)(LONG_PTR, LONG_PTR);
-    typedef LONG_PTR (WINAPI *GenericFunc3)(LONG_PTR, LONG_PTR, LONG_PTR);
-    typedef LONG_PTR (WINAPI *GenericFunc4)(LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR);
-    typedef LONG_PTR (WINAPI *GenericFunc5)(LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR);
-    typedef LONG_PTR (WINAPI *GenericFunc6)(LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR);
-    typedef LONG_PTR (WINAPI *GenericFunc7)(LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR);
-    typedef LONG_PTR (WINAPI *GenericFunc8)(LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR);
-    typedef LONG_PTR (WINAPI *GenericFunc9)(LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR);
-    typedef LONG_PTR (WINAPI *GenericFunc10)(LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR, LONG_PTR);
-    
-    LONG_PTR result = 0;
+// Number of LONG_PTR frame slots an argument occupies
+int GetArgSlotCount(ParameterType type)
+{
+#if DYNWRAPX_TARGET_X86
+    // 8-byte arguments are passed as two consecutive stack DWORDs
+    if (type == TYPE_DOUBLE || type == TYPE_LONGLONG)
+        return 2;
+#endif
+    return 1;
+}
+
+// Call a native function through its precompiled thunk
+HRESULT CallFunction(FunctionInfo* pFunc, const LONG_PTR* argFrame, void* returnValue)
+{
+    DebugLog("DEBUG", "CallFunction", "Starting function call: proc=0x%p, argCount=%d, returnValue=0x%p", pFunc->functionPtr, pFunc->paramCount, returnValue);
     
     // Validate parameters
-    if (!proc) {
-        DebugLog("ERROR", "CallFunction", "proc parameter is NULL");
+    if (!pFunc->functionPtr || !pFunc->callThunk) {
+        DebugLog("ERROR", "CallFunction", "Function pointer or call thunk is NULL");
         return E_INVALIDARG;
     }
     
-    // Convert args to LONG_PTR array for easier handling with validation
-    LONG_PTR convertedArgs[10] = {0};
-    for (int i = 0; i < argCount && i < 10; i++) {
-        if (args[i]) {
-            convertedArgs[i] = *(LONG_PTR*)args[i];
-            DebugLog("DEBUG", "CallFunction", "arg[%d]: 0x%p -> 0x%llx", i, args[i], (unsigned long long)convertedArgs[i]);
-        } else {
-            DebugLog("DEBUG", "CallFunction", "arg[%d]: NULL -> 0x0", i);
-        }
+#ifdef DEBUG_BUILD
+    for (int i = 0; i < pFunc->frameSlots; i++) {
+        DebugLog("DEBUG", "CallFunction", "arg[%d]: 0x%llx", i, (unsigned long long)argFrame[i]);
     }
+#endif
     
-    // Call function - simplified without exception handling for MinGW compatibility
-    DebugLog("DEBUG", "CallFunction", "About to call function with %d parameters", argCount);
-    
-    switch (argCount)
+    // Floating-point results come back in XMM0 (x64) or ST0 (x86), and 64-bit
+    // integers in EDX:EAX on x86, so pick the thunk type by return type
+    switch (pFunc->returnType)
     {
-    case 0:
-        DebugLog("DEBUG", "CallFunction", "Calling 0-parameter function");
-        result = ((GenericFunc0)proc)();
-        break;
-    case 1:
-        DebugLog("DEBUG", "CallFunction", "Calling 1-parameter function with args[0]=0x%llx", (unsigned long long)convertedArgs[0]);
-        result = ((GenericFunc1)proc)(convertedArgs[0]);
-        break;
-    case 2:
-        DebugLog("DEBUG", "CallFunction", "Calling 2-parameter function with args[0]=0x%llx, args[1]=0x%llx", (unsigned long long)convertedArgs[0], (unsigned long long)convertedArgs[1]);
-        result = ((GenericFunc2)proc)(convertedArgs[0], convertedArgs[1]);
-        break;
-    case 3:
-        DebugLog("DEBUG", "CallFunction", "Calling 3-parameter function");
-        result = ((GenericFunc3)proc)(convertedArgs[0], convertedArgs[1], convertedArgs[2]);
-        break;
-    case 4:
-        DebugLog("DEBUG", "CallFunction", "Calling 4-parameter function");
-        result = ((GenericFunc4)proc)(convertedArgs[0], convertedArgs[1], convertedArgs[2], convertedArgs[3]);
-        break;
-    case 5:
-        DebugLog("DEBUG", "CallFunction", "Calling 5-parameter function");
-        result = ((GenericFunc5)proc)(convertedArgs[0], convertedArgs[1], convertedArgs[2], convertedArgs[3], convertedArgs[4]);
-        break;
-    case 6:
-        DebugLog("DEBUG", "CallFunction", "Calling 6-parameter function");
-        result = ((GenericFunc6)proc)(convertedArgs[0], convertedArgs[1], convertedArgs[2], convertedArgs[3], convertedArgs[4], convertedArgs[5]);
-        break;
-    case 7:
-        DebugLog("DEBUG", "CallFunction", "Calling 7-parameter function");
-        result = ((GenericFunc7)proc)(convertedArgs[0], convertedArgs[1], convertedArgs[2], convertedArgs[3], convertedArgs[4], convertedArgs[5], convertedArgs[6]);
-        break;
-    case 8:
-        DebugLog("DEBUG", "CallFunction", "Calling 8-parameter function");
-        result = ((GenericFunc8)proc)(convertedArgs[0], convertedArgs[1], convertedArgs[2], convertedArgs[3], convertedArgs[4], convertedArgs[5], convertedArgs[6], convertedArgs[7]);
-        break;
-    case 9:
-        DebugLog("DEBUG", "CallFunction", "Calling 9-parameter function");
-        result = ((GenericFunc9)proc)(convertedArgs[0], convertedArgs[1], convertedArgs[2], convertedArgs[3], convertedArgs[4], convertedArgs[5], convertedArgs[6], convertedArgs[7], convertedArgs[8]);
+    case TYPE_FLOAT:
+        {
+            FLOAT result = ((CallThunkFloat)pFunc->callThunk)(pFunc->functionPtr, argFrame);
+            DebugLog("DEBUG", "CallFunction", "Function call completed, float result=%f", (double)result);
+            if (returnValue)
+                *(FLOAT*)returnValue = result;
+        }
         break;
-    case 10:
-        DebugLog("DEBUG", "CallFunction", "Calling 10-parameter function (CreateProcessW)");
-        result = ((GenericFunc10)proc)(convertedArgs[0], convertedArgs[1], convertedArgs[2], convertedArgs[3], convertedArgs[4], convertedArgs[5], convertedArgs[6], convertedArgs[7], convertedArgs[8], convertedArgs[9]);
+    
+    case TYPE_DOUBLE:
+        {
+            DOUBLE result = ((CallThunkDouble)pFunc->callThunk)(pFunc->functionPtr, argFrame);
+            DebugLog("DEBUG", "CallFunction", "Function call completed, double result=%f", result);
+            if (returnValue)
+                *(DOUBLE*)returnValue = result;
+        }
         break;
-    default:
-        DebugLog("ERROR", "CallFunction", "Too many parameters: %d (maximum 10)", argCount);
-        return E_NOTIMPL; // More than 10 parameters - very rare for Windows APIs
-    }
     
-    DebugLog("DEBUG", "CallFunction", "Function call completed, result=0x%llx (%lld)", (unsigned long long)result, (long long)result);
+    case TYPE_LONGLONG:
+        {
+            LONGLONG result = ((CallThunkInt64)pFunc->callThunk)(pFunc->functionPtr, argFrame);
+            DebugLog("DEBUG", "CallFunction", "Function call completed, result=%lld", result);
+            if (returnValue)
+                *(LONGLONG*)returnValue = result;
+        }
+        break;
     
-    // Store result
-    if (returnValue) {
-        *(LONG_PTR*)returnValue = result;
-        DebugLog("DEBUG", "CallFunction", "Result stored at 0x%p", returnValue);
+    default:
+        {
+            LONG_PTR result = pFunc->callThunk(pFunc->functionPtr, argFrame);
+            DebugLog("DEBUG", "CallFunction", "Function call completed, result=0x%llx (%lld)", (unsigned long long)result, (long long)result);
+            if (returnValue)
+                *(LONG_PTR*)returnValue = result;
+        }
+        break;
     }
     
-    DebugLog("DEBUG", "CallFunction", "CallFunction completed successfully");
     return S_OK;
 }
@@ -84,6 +84,7 @@ typedef enum {
     TYPE_WSTRING,           // w - Unicode string
     TYPE_ASTRING,           // s - ANSI string
     TYPE_OSTRING,           // z - OEM string
+    TYPE_USTRING,           // a - UTF-8 string
     
     // Output parameter types (uppercase)
     TYPE_OUT_LONG,          // L - pointer to LONG
@@ -99,36 +100,169 @@ typedef enum {
     TYPE_OUT_WSTRING,       // W - output Unicode string
     TYPE_OUT_ASTRING,       // S - output ANSI string
     TYPE_OUT_OSTRING,       // Z - output OEM string
+    TYPE_OUT_USTRING,       // A - output UTF-8 string
     TYPE_VOID               // v - no return value
 } ParameterType;
 
+// Precompiled call thunk: loads a packed argument frame into registers/stack
+// and calls proc. The thunk leaves the native return registers untouched, so
+// it is invoked through the typedef matching the function's return type.
+typedef LONG_PTR (__cdecl *CallThunk)(FARPROC proc, const LONG_PTR* argFrame);
+typedef LONGLONG (__cdecl *CallThunkInt64)(FARPROC proc, const LONG_PTR* argFrame);
+typedef FLOAT (__cdecl *CallThunkFloat)(FARPROC proc, const LONG_PTR* argFrame);
+typedef DOUBLE (__cdecl *CallThunkDouble)(FARPROC proc, const LONG_PTR* argFrame);
+
+// Per-function call statistics, updated lock-free on every call
+#define DYNWRAPX_STATS_BUCKETS 32   // log2 latency buckets, in nanoseconds
+#define DYNWRAPX_STATS_FIELDS  10   // Entries in a Stats() row
+
+typedef struct _FunctionStats {
+    LONGLONG volatile calls;
+    LONGLONG volatile failures;
+    LONGLONG volatile totalTicks;   // QPC ticks, whole call
+    LONGLONG volatile minTicks;     // 0 until the first call
+    LONGLONG volatile maxTicks;
+    LONGLONG volatile convertTicks; // Argument conversion
+    LONGLONG volatile nativeTicks;  // Native call
+    LONGLONG volatile resultTicks;  // Return value conversion
+    LONGLONG volatile histogram[DYNWRAPX_STATS_BUCKETS];
+} FunctionStats;
+
 // Function registration structure
 typedef struct _FunctionInfo {
     BSTR functionName;
     DWORD functionId;
+    ULONG nameHash;         // Cached hash of functionName for the name table
     int paramCount;
     ParameterType* paramTypes;
     ParameterType returnType;
-    FARPROC functionPtr;
-    struct _FunctionInfo* next;
+    FARPROC volatile functionPtr;   // NULL until resolved when registered lazily
+    BSTR libraryName;       // Kept for lazy resolution; NULL when resolved at registration
+    CallThunk callThunk;    // Shared by all functions with the same argument layout
+    int frameSlots;         // LONG_PTR slots needed for the packed argument frame
+    int outCount;           // Uppercase (output) parameters
+    int sizeParam;          // Parameter marked '#': GrowRetry stores the new capacity in it, -1 if none
+    int sizeOutput;         // String output whose capacity sizeParam carries, -1 if none
+    FunctionStats stats;
 } FunctionInfo;
 
-// Callback registration structure
+// Argument frames up to this many slots live on the stack during a call
+#define DYNWRAPX_INLINE_FRAME_SLOTS 16
+
+// Argument rows stored by a collector callback (RegisterCollector)
+typedef struct _CollectorBuffer {
+    VARIANT* rows;          // count rows of columns values each
+    int columns;            // Parameters of the callback
+    LONG count;
+    LONG capacity;          // Rows allocated
+    LONG maxItems;
+    LONG dropped;           // Invocations that arrived while full
+    LONGLONG returnValue;   // Returned to native code while not full
+    CRITICAL_SECTION cs;
+} CollectorBuffer;
+
+// Callback registration structure. Each callback owns a generated thunk
+// that native code calls directly; the thunk hands the CallbackInfo and the
+// caller's argument slots to InvokeCallback.
 typedef struct _CallbackInfo {
     IDispatch* scriptFunction;
     int paramCount;
     ParameterType* paramTypes;
     ParameterType returnType;
-    int callbackIndex;
+    struct _DynamicWrapperX* owner;     // Not AddRef'd: the object owns its callbacks
+    void* thunk;                        // Entry point handed out by RegisterCallback
+    VARIANT* frame;                     // Argument VARIANTs reused by every invocation
+    int* slotIndex;                     // Native argument slot of each parameter
+    BOOL frameHasStrings;               // Frame entries need VariantClear after a call
+    volatile LONG frameBusy;            // Frame in use; reentrant calls use the arena
+    volatile LONG activeCalls;          // Native calls inside InvokeCallback
+    volatile LONG queuedCalls;          // Calls waiting in the owner's async queue
+    CollectorBuffer* collector;         // Set for collectors, which never enter script
+    BOOL async;                         // Calls from other threads are queued (RegisterAsyncCallback)
+    DWORD threadId;                     // Thread that registered the callback
+    LONGLONG asyncReturn;               // Returned to native code for queued calls
+    LONG maxQueued;                     // Queued calls kept at most, 0 for no limit
+    struct _CallbackInfo* next;
 } CallbackInfo;
 
+// Default limit on queued calls per asynchronous callback
+#define DYNWRAPX_ASYNC_MAX_QUEUED 10000
+
+// Callback invocation queued by a foreign thread for PumpCallbacks
+typedef struct _AsyncCall {
+    struct _AsyncCall* next;
+    CallbackInfo* callback;
+    int argCount;
+    VARIANT args[1];            // argCount entries, in IDispatch (reverse) order
+} AsyncCall;
+
+// Field of a struct layout (DefineStruct)
+typedef struct _StructField {
+    BSTR name;
+    ParameterType type;
+    LONG offset;
+    LONG count;             // Elements; 1 for a scalar field
+    BOOL isText;            // w/s/z character buffer read and written as a string
+} StructField;
+
+// Struct layout compiled once by DefineStruct and used by ReadStruct/WriteStruct
+typedef struct _StructDef {
+    BSTR name;
+    int fieldCount;
+    StructField* fields;
+    LONG size;              // Including trailing padding
+    LONG align;             // Largest field alignment
+    struct _StructDef* next;
+} StructDef;
+
 // Memory allocation tracking
 typedef struct _MemoryBlock {
     void* ptr;
     BOOL isGlobal;      // TRUE for GlobalAlloc, FALSE for SysAllocString
+    SIZE_T size;        // Bytes counted in DynamicWrapperX.liveBytes
     struct _MemoryBlock* next;
 } MemoryBlock;
 
+// SAFEARRAY passed as a p argument, locked with SafeArrayAccessData until
+// the call returns
+typedef struct _PinnedArray {
+    SAFEARRAY* psa;
+    BOOL onHeap;                // Node from GlobalAlloc (thread arena exhausted)
+    struct _PinnedArray* next;
+} PinnedArray;
+
+// Temporary allocations that share a lifetime: one native call, or one
+// BeginScope/EndScope pair opened by the script
+typedef struct _CallScope {
+    MemoryBlock* blocks;
+    struct _CallScope* parent;  // Enclosing script scope
+    PinnedArray* pinned;        // Arrays lent to native code (native calls only)
+} CallScope;
+
+// Object-wide options (SetOption)
+#define DYNWRAPX_OPTION_LAZY        0x0001  // Defer GetProcAddress until the first call
+#define DYNWRAPX_OPTION_TRACE       0x0002  // Record each call in the per-thread trace ring
+#define DYNWRAPX_OPTION_STATS       0x0004  // Per-function call statistics (on by default)
+#define DYNWRAPX_OPTION_OUTARRAY    0x0008  // Return [result, outputs...] from calls with output parameters
+#define DYNWRAPX_OPTION_GROWRETRY   0x0010  // Call again with larger string outputs when a larger size is returned
+
+// Loaded module cache entry (one LoadLibrary reference per module)
+typedef struct _ModuleEntry {
+    LPWSTR name;        // Normalized: lowercase, ".dll" appended when no extension
+    HMODULE hModule;
+    struct _ModuleEntry* next;
+} ModuleEntry;
+
+// Registry array read without a lock. Published arrays are only changed by
+// filling or replacing single slots; growing allocates a new array and the
+// old one is retired (kept until the object is released) because readers
+// may still hold it.
+typedef struct _RegistryArray {
+    struct _RegistryArray* retiredNext;
+    int size;
+    FunctionInfo* volatile items[1];    // size entries
+} RegistryArray;
+
 // Main interface declaration
 #undef INTERFACE
 #define INTERFACE IDynamicWrapperX
@@ -154,9 +288,25 @@ DECLARE_INTERFACE_(IDynamicWrapperX, IDispatch)
 typedef struct _DynamicWrapperX {
     IDynamicWrapperX vtbl;
     LONG refCount;
-    FunctionInfo* functionList;
-    CallbackInfo callbacks[16];  // Maximum 16 callbacks
-    MemoryBlock* memoryBlocks;
+    RegistryArray* volatile functionTable;  // Dense array indexed by functionId - DISPID_FUNCTION_BASE
+    volatile LONG functionCount;            // Published after the slot is filled
+    RegistryArray* volatile nameTable;      // Open-addressed by name hash, size a power of two
+    RegistryArray* retiredTables;           // Replaced arrays, freed on release
+    CallbackInfo* callbacks;        // Registered callbacks, freed on release
+    AsyncCall* volatile asyncCalls; // Lock-free LIFO of queued calls, newest first
+    HANDLE asyncEvent;              // Signaled when the queue becomes non-empty
+    StructDef* structs;             // DefineStruct layouts, newest first; freed on release
+    MemoryBlock* memoryBlocks;      // Live until the object is released
+    CallScope* openScope;           // Innermost BeginScope scope, NULL if none
+    int scopeDepth;
+    LONG liveBytes;                 // Bytes held by tracked memory blocks
+    ModuleEntry* moduleCache;
+    LONG moduleCacheHits;
+    LONG moduleCacheMisses;
+    LONG lazyResolves;              // Functions resolved on first call
+    volatile LONG asyncDropped;     // Asynchronous calls dropped (queue full or out of memory)
+    DWORD options;                  // DYNWRAPX_OPTION_* flags
+    LONG callAllocations;           // Heap allocations made while marshaling calls
     CRITICAL_SECTION cs;
 } DynamicWrapperX;
 
@@ -184,50 +334,139 @@ typedef struct _ClassFactory IDynWrapXFactory;
 // Function declarations
 HRESULT CreateDynamicWrapperX(IUnknown* pUnkOuter, REFIID riid, void** ppv);
 ParameterType ParseParameterType(WCHAR c);
-HRESULT ConvertVariantToType(VARIANT* pVar, ParameterType type, void* pOut, DynamicWrapperX* pObj);
+HRESULT ConvertVariantToType(VARIANT* pVar, ParameterType type, void* pOut, DynamicWrapperX* pObj, CallScope* pScope);
 HRESULT ConvertTypeToVariant(void* pData, ParameterType type, VARIANT* pVar);
-FARPROC LoadFunction(LPCWSTR libraryName, LPCWSTR functionName);
+BSTR* GetVariantBstr(VARIANT* pVar);
+FARPROC LoadFunction(DynamicWrapperX* pObj, LPCWSTR libraryName, LPCWSTR functionName);
+HMODULE LoadCachedModule(DynamicWrapperX* pObj, LPCWSTR libraryName);
+FARPROC ResolveFunction(HMODULE hLib, LPCWSTR functionName);
+void FreeModuleCache(DynamicWrapperX* pObj);
 void CleanupMemoryBlocks(DynamicWrapperX* pObj);
+HRESULT TrackMemoryBlock(DynamicWrapperX* pObj, CallScope* pScope, void* ptr, BOOL isGlobal, SIZE_T size);
+void FreeMemoryBlocks(DynamicWrapperX* pObj, MemoryBlock* pBlock);
+void UnpinArrays(PinnedArray* pPin);
+HRESULT CreateVariantArray(const VARIANT* items, LONG count, VARIANT* pResult);
+
+// Function registry (name -> DISPID and DISPID -> FunctionInfo, both O(1)).
+// Lookups are lock-free; AddFunction callers hold pObj->cs.
+HRESULT AddFunction(DynamicWrapperX* pObj, FunctionInfo* pFunc);
+FunctionInfo* FindFunctionByName(DynamicWrapperX* pObj, LPCWSTR name);
+void InitializeBuiltinMethods(void);
+FunctionInfo* FindFunctionById(DynamicWrapperX* pObj, DISPID dispId);
+void FreeFunctionTable(DynamicWrapperX* pObj);
+void FreeFunctionInfo(FunctionInfo* pFunc);
 
 // Additional function declarations
 HRESULT CallRegisteredFunction(DynamicWrapperX* pObj, FunctionInfo* pFunc, DISPPARAMS* pDispParams, VARIANT* pVarResult);
 size_t GetTypeSize(ParameterType type);
-HRESULT CallFunction(FARPROC proc, void** args, int argCount, void* returnValue);
+BOOL IsOutputType(ParameterType type);
+BOOL IsOutputText(ParameterType type);
+int GetArgSlotCount(ParameterType type);
+HRESULT CallFunction(FunctionInfo* pFunc, const LONG_PTR* argFrame, void* returnValue);
 HRESULT ParseParameterString(LPCWSTR paramStr, ParameterType** types, int* count);
-HRESULT CallScriptFunction(DynamicWrapperX* pObj, int callbackIndex, void** args, void* returnValue);
+HRESULT CallScriptFunction(CallbackInfo* pInfo, const LONG_PTR* argSlots, void* returnValue);
+void __cdecl InvokeCallback(CallbackInfo* pInfo, const LONG_PTR* argSlots, LONGLONG* result);
+HRESULT SetCallbackArgument(const LONG_PTR* pSlot, ParameterType type, VARIANT* pVar);
+void FreeCallbackInfo(CallbackInfo* pInfo);
+
+// Per-thread scratch arena for call temporaries
+void InitializeArenas(void);
+void CleanupArenas(void);
+void ReleaseThreadArena(void);
+SIZE_T ArenaMark(void);
+void ArenaReset(SIZE_T mark);
+void* ArenaAlloc(SIZE_T size);
+
+// Call tracing (per-thread event rings, flushed on demand)
+void InitializeTracing(void);
+void CleanupTracing(void);
+void ReleaseThreadTrace(void);
+void TraceCall(const void* owner, DWORD functionId, DWORD argCount, LONGLONG start, LONGLONG end, HRESULT hr);
+LONG FlushTrace(DynamicWrapperX* pObj, LPCWSTR path);
+
+// Per-function call statistics
+void RecordCallStats(FunctionInfo* pFunc, LONGLONG start, LONGLONG converted, LONGLONG called, LONGLONG end, HRESULT hr);
+void ResetCallStats(FunctionInfo* pFunc);
+HRESULT GetCallStatsRow(FunctionInfo* pFunc, VARIANT* pRow);
+
+// Collector callbacks
+HRESULT CreateCollector(CallbackInfo* pInfo, LONG maxItems, LONGLONG returnValue);
+void FreeCollector(CollectorBuffer* pCollector);
+void CollectArguments(CallbackInfo* pInfo, const LONG_PTR* argSlots, LONGLONG* result);
+HRESULT GetCollectedRows(CallbackInfo* pInfo, BOOL reset, VARIANT* pResult);
+
+// Asynchronous callbacks (queued from foreign threads, run by PumpCallbacks)
+void QueueAsyncCall(CallbackInfo* pInfo, const LONG_PTR* argSlots);
+LONG PumpAsyncCalls(DynamicWrapperX* pObj, DWORD timeout);
+void FreeAsyncCalls(DynamicWrapperX* pObj);
+
+// Typed memory access shared by NumGet/NumPut and the struct methods
+BOOL LookupNumTypeName(LPCWSTR typeStr, ParameterType* pType);
+ParameterType ParseNumTypeName(LPCWSTR typeStr);
+void ReadTypedValue(const void* finalAddr, ParameterType type, VARIANT* pVarResult);
+HRESULT WriteTypedValue(void* finalAddr, ParameterType type, VARIANT* pValueArg);
+HRESULT GetScriptArrayLength(IDispatch* pArray, LONG* pLength);
+HRESULT GetScriptArrayItem(IDispatch* pArray, LONG index, VARIANT* pItem);
+
+// Struct layouts (DefineStruct/ReadStruct/WriteStruct)
+HRESULT DefineStruct(DynamicWrapperX* pObj, LPCWSTR name, LPCWSTR layout, StructDef** ppDef);
+StructDef* FindStruct(DynamicWrapperX* pObj, LPCWSTR name);
+void FreeStructDefs(DynamicWrapperX* pObj);
+HRESULT ReadStruct(DynamicWrapperX* pObj, StructDef* pDef, const void* address, VARIANT* pResult);
+HRESULT WriteStruct(StructDef* pDef, void* address, VARIANT* pSource);
+
+// Buffer objects returned by Alloc (private heap)
+void InitializeBuffers(void);
+void CleanupBuffers(void);
+HRESULT CreateNativeBuffer(SIZE_T size, SIZE_T align, VARIANT* pResult);
+void* GetNativeBufferData(IDispatch* pDisp);
+
+// Text conversion between UTF-16 and the s/z/a code pages
+UINT GetStringCodePage(ParameterType type);
+int WideToNarrow(UINT codePage, LPCWSTR text, int length, LPSTR dst, int capacity);
+int NarrowToWide(UINT codePage, LPCSTR text, int length, LPWSTR dst, int capacity);
+BSTR NarrowToBstr(UINT codePage, LPCSTR text, int length);
+
+// Call thunk generation
+void InitializeThunks(void);
+void CleanupThunks(void);
+CallThunk GetCallThunk(const ParameterType* paramTypes, int paramCount);
+void* CreateCallbackThunk(CallbackInfo* pInfo);
+void FreeCallbackThunk(void* thunk);
 
 // Built-in method implementations
 HRESULT DynWrap_Register(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
 HRESULT DynWrap_RegisterCallback(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_FreeCallback(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
 HRESULT DynWrap_NumGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
 HRESULT DynWrap_NumPut(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
 HRESULT DynWrap_StrPtr(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
 HRESULT DynWrap_StrGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
 HRESULT DynWrap_Space(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
-
-// Callback stubs (16 maximum)
-LRESULT CALLBACK CallbackStub0(void);
-LRESULT CALLBACK CallbackStub1(void);
-LRESULT CALLBACK CallbackStub2(void);
-LRESULT CALLBACK CallbackStub3(void);
-LRESULT CALLBACK CallbackStub4(void);
-LRESULT CALLBACK CallbackStub5(void);
-LRESULT CALLBACK CallbackStub6(void);
-LRESULT CALLBACK CallbackStub7(void);
-LRESULT CALLBACK CallbackStub8(void);
-LRESULT CALLBACK CallbackStub9(void);
-LRESULT CALLBACK CallbackStub10(void);
-LRESULT CALLBACK CallbackStub11(void);
-LRESULT CALLBACK CallbackStub12(void);
-LRESULT CALLBACK CallbackStub13(void);
-LRESULT CALLBACK CallbackStub14(void);
-LRESULT CALLBACK CallbackStub15(void);
+HRESULT DynWrap_Counter(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_RegisterMany(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_SetOption(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_BeginScope(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_EndScope(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_FlushTrace(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_Stats(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_ResetStats(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_RegisterCollector(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_Collected(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_RegisterAsyncCallback(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_PumpCallbacks(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_NumGetArray(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_NumPutArray(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_DefineStruct(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_ReadStruct(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_WriteStruct(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
+HRESULT DynWrap_Alloc(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult);
 
 // Global variables
 extern HMODULE g_hModule;
 extern LONG g_cObjects;
 extern LONG g_cLocks;
-extern DynamicWrapperX* g_callbackObjects[16];
+extern LONGLONG g_qpcFrequency;
 
 // Method name constants
 #define DISPID_REGISTER         1000
@@ -237,6 +476,28 @@ extern DynamicWrapperX* g_callbackObjects[16];
 #define DISPID_STRPTR          1004
 #define DISPID_STRGET          1005
 #define DISPID_SPACE           1006
+#define DISPID_COUNTER         1007
+#define DISPID_REGISTERMANY    1008
+#define DISPID_SETOPTION       1009
+#define DISPID_BEGINSCOPE      1010
+#define DISPID_ENDSCOPE        1011
+#define DISPID_FLUSHTRACE      1012
+#define DISPID_STATS           1013
+#define DISPID_RESETSTATS      1014
+#define DISPID_REGISTERCOLLECTOR 1015
+#define DISPID_COLLECTED       1016
+#define DISPID_REGISTERASYNCCALLBACK 1017
+#define DISPID_PUMPCALLBACKS   1018
+#define DISPID_NUMGETARRAY     1019
+#define DISPID_NUMPUTARRAY     1020
+#define DISPID_DEFINESTRUCT    1021
+#define DISPID_READSTRUCT      1022
+#define DISPID_WRITESTRUCT     1023
+#define DISPID_ALLOC           1024
+#define DISPID_FREECALLBACK    1025
+
+// Registered functions get DISPIDs starting here
+#define DISPID_FUNCTION_BASE   2000
 
 // Helper macros
 #define SAFE_RELEASE(p) if(p) { (p)->lpVtbl->Release(p); (p) = NULL; }
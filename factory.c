@@ -99,5 +99,5 @@ static HRESULT STDMETHODCALLTYPE ClassFactory_LockServer(IClassFactory* This, BO
 
 HRESULT CallRegisteredFunction(DynamicWrapperX* pObj, FunctionInfo* pFunc, DISPPARAMS* pDispParams, VARIANT* pVarResult);
 size_t GetTypeSize(ParameterType type);
-HRESULT CallFunction(FARPROC proc, void** args, int argCount, void* returnValue);
+HRESULT CallFunction(FunctionInfo* pFunc, const LONG_PTR* argFrame, void* returnValue);
 
@@ -12,8 +12,21 @@ void InitializeDebugLogging(void)
 {
     if (g_debugInitialized) return;
     
+    char logPath[MAX_PATH];
+    DWORD length;
+    
     InitializeCriticalSection(&g_debugCS);
-    g_debugFile = fopen("C:\\Users\\kaganisildak\\Desktop\\test2\\debugdyn.log", "w");
+    
+    // %DYNWRAPX_LOG% if set, else debugdyn.log in the temp directory
+    length = GetEnvironmentVariableA("DYNWRAPX_LOG", logPath, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH)
+    {
+        length = GetTempPathA(MAX_PATH, logPath);
+        if (length == 0 || length + 13 >= MAX_PATH)
+            logPath[0] = '\0';
+        strcat(logPath, "debugdyn.log");
+    }
+    g_debugFile = fopen(logPath, "w");
     if (g_debugFile) {
         fprintf(g_debugFile, "=== DynamicWrapperX Debug Log Started ===\n");
         fflush(g_debugFile);
@@ -91,7 +104,7 @@ const GUID IID_IDynamicWrapperX = {0x89565276, 0xA714, 0x4a43, {0x91, 0x2E, 0x97
 HMODULE g_hModule = NULL;
 LONG g_cObjects = 0;
 LONG g_cLocks = 0;
-DynamicWrapperX* g_callbackObjects[16] = {0};
+LONGLONG g_qpcFrequency = 0;   // QueryPerformanceCounter ticks per second
 
 // DLL Entry Point
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserved)
@@ -100,14 +113,32 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
     {
     case DLL_PROCESS_ATTACH:
         g_hModule = hModule;
-        DisableThreadLibraryCalls(hModule);
+        {
+            LARGE_INTEGER frequency;
+            if (QueryPerformanceFrequency(&frequency))
+                g_qpcFrequency = frequency.QuadPart;
+        }
         InitializeDebugLogging();
+        InitializeBuiltinMethods();
+        InitializeThunks();
+        InitializeArenas();
+        InitializeTracing();
+        InitializeBuffers();
         DebugLog("INFO", "DllMain", "DLL_PROCESS_ATTACH - DLL loaded, hModule=0x%p", hModule);
         break;
     case DLL_PROCESS_DETACH:
         DebugLog("INFO", "DllMain", "DLL_PROCESS_DETACH - DLL unloading");
+        CleanupThunks();
+        CleanupArenas();
+        CleanupTracing();
+        CleanupBuffers();
         CleanupDebugLogging();
         break;
+    case DLL_THREAD_DETACH:
+        // Thread notifications stay enabled so per-thread arenas are freed
+        ReleaseThreadArena();
+        ReleaseThreadTrace();
+        break;
     }
     return TRUE;
 }
@@ -192,6 +223,7 @@ ParameterType ParseParameterType(WCHAR c)
     case L'w': return TYPE_WSTRING;
     case L's': return TYPE_ASTRING;
     case L'z': return TYPE_OSTRING;
+    case L'a': return TYPE_USTRING;
     
     // Output parameters (uppercase)
     case L'L': return TYPE_OUT_LONG;
@@ -207,63 +239,265 @@ ParameterType ParseParameterType(WCHAR c)
     case L'W': return TYPE_OUT_WSTRING;
     case L'S': return TYPE_OUT_ASTRING;
     case L'Z': return TYPE_OUT_OSTRING;
+    case L'A': return TYPE_OUT_USTRING;
     case L'v': return TYPE_VOID;
     
     default: return TYPE_LONG; // Default fallback
     }
 }
 
-// Load function from DLL
-FARPROC LoadFunction(LPCWSTR libraryName, LPCWSTR functionName)
+// Normalize a library name for the module cache: lowercase, with ".dll"
+// appended when the file name has no extension (as LoadLibrary does)
+static LPWSTR NormalizeModuleName(LPCWSTR libraryName)
 {
-    HMODULE hLib;
-    FARPROC proc;
-    char szFuncName[256];
-    char szLibName[MAX_PATH];
+    size_t len = wcslen(libraryName);
+    LPCWSTR fileName = libraryName;
+    BOOL hasExtension = FALSE;
+    
+    for (LPCWSTR p = libraryName; *p; p++)
+    {
+        if (*p == L'\\' || *p == L'/')
+            fileName = p + 1;
+    }
+    hasExtension = wcschr(fileName, L'.') != NULL;
     
-    // Convert to ANSI for logging
-    WideCharToMultiByte(CP_ACP, 0, libraryName, -1, szLibName, MAX_PATH, NULL, NULL);
-    WideCharToMultiByte(CP_ACP, 0, functionName, -1, szFuncName, 256, NULL, NULL);
+    LPWSTR name = (LPWSTR)GlobalAlloc(GMEM_FIXED, (len + 5) * sizeof(WCHAR));
+    if (!name)
+        return NULL;
     
-    DebugLog("DEBUG", "LoadFunction", "Loading function '%s' from library '%s'", szFuncName, szLibName);
+    for (size_t i = 0; i <= len; i++)
+        name[i] = (libraryName[i] >= L'A' && libraryName[i] <= L'Z') ? libraryName[i] + (L'a' - L'A') : libraryName[i];
+    if (!hasExtension)
+        wcscat(name, L".dll");
     
-    // Try loading as Unicode first
-    hLib = LoadLibraryW(libraryName);
-    if (!hLib)
+    return name;
+}
+
+// Load a library once per object; later requests for the same module are cache hits
+HMODULE LoadCachedModule(DynamicWrapperX* pObj, LPCWSTR libraryName)
+{
+    HMODULE hLib = NULL;
+    LPWSTR name = NormalizeModuleName(libraryName);
+    if (!name)
+        return NULL;
+    
+    EnterCriticalSection(&pObj->cs);
+    
+    for (ModuleEntry* pEntry = pObj->moduleCache; pEntry; pEntry = pEntry->next)
     {
-        DebugLog("DEBUG", "LoadFunction", "LoadLibraryW failed, trying LoadLibraryA");
-        // Try again with ANSI
-        hLib = LoadLibraryA(szLibName);
+        if (wcscmp(pEntry->name, name) == 0)
+        {
+            hLib = pEntry->hModule;
+            break;
+        }
+    }
+    
+    if (hLib)
+    {
+        pObj->moduleCacheHits++;
+        GlobalFree(name);
+    }
+    else
+    {
+        pObj->moduleCacheMisses++;
+        DebugLog("DEBUG", "LoadCachedModule", "Module cache miss for '%S'", name);
+        
+        // Try loading as Unicode first
+        hLib = LoadLibraryW(libraryName);
         if (!hLib)
         {
-            DebugLog("ERROR", "LoadFunction", "Failed to load library '%s', GetLastError=%lu", szLibName, GetLastError());
-            return NULL;
+            char szLibName[MAX_PATH];
+            
+            DebugLog("DEBUG", "LoadCachedModule", "LoadLibraryW failed, trying LoadLibraryA");
+            // Try again with ANSI
+            WideCharToMultiByte(CP_ACP, 0, libraryName, -1, szLibName, MAX_PATH, NULL, NULL);
+            hLib = LoadLibraryA(szLibName);
+        }
+        
+        ModuleEntry* pEntry = hLib ? (ModuleEntry*)GlobalAlloc(GMEM_FIXED, sizeof(ModuleEntry)) : NULL;
+        if (pEntry)
+        {
+            pEntry->name = name;
+            pEntry->hModule = hLib;
+            pEntry->next = pObj->moduleCache;
+            pObj->moduleCache = pEntry;
+            DebugLog("DEBUG", "LoadCachedModule", "Library loaded successfully, hLib=0x%p", hLib);
         }
+        else
+        {
+            if (hLib)
+            {
+                FreeLibrary(hLib);
+                hLib = NULL;
+            }
+            else
+            {
+                DebugLog("ERROR", "LoadCachedModule", "Failed to load library '%S', GetLastError=%lu", libraryName, GetLastError());
+            }
+            GlobalFree(name);
+        }
+    }
+    
+    LeaveCriticalSection(&pObj->cs);
+    return hLib;
+}
+
+// Release every cached module handle
+void FreeModuleCache(DynamicWrapperX* pObj)
+{
+    ModuleEntry* pEntry = pObj->moduleCache;
+    while (pEntry)
+    {
+        ModuleEntry* pNext = pEntry->next;
+        FreeLibrary(pEntry->hModule);
+        GlobalFree(pEntry->name);
+        GlobalFree(pEntry);
+        pEntry = pNext;
     }
+    pObj->moduleCache = NULL;
+}
+
+// Look up an exported function in a loaded module
+FARPROC ResolveFunction(HMODULE hLib, LPCWSTR functionName)
+{
+    FARPROC proc;
+    char szFuncName[256];
     
-    DebugLog("DEBUG", "LoadFunction", "Library loaded successfully, hLib=0x%p", hLib);
+    WideCharToMultiByte(CP_ACP, 0, functionName, -1, szFuncName, 255, NULL, NULL);
+    szFuncName[255] = '\0';
     
     // Try to get the function
     proc = GetProcAddress(hLib, szFuncName);
-    if (!proc)
+    if (!proc && strlen(szFuncName) < 255)
     {
-        DebugLog("DEBUG", "LoadFunction", "GetProcAddress failed for '%s', trying with 'A' suffix", szFuncName);
+        DebugLog("DEBUG", "ResolveFunction", "GetProcAddress failed for '%s', trying with 'A' suffix", szFuncName);
         // Try with 'A' suffix for ANSI version
         strcat(szFuncName, "A");
         proc = GetProcAddress(hLib, szFuncName);
     }
     
     if (proc) {
-        DebugLog("DEBUG", "LoadFunction", "Function '%s' loaded successfully, proc=0x%p", szFuncName, proc);
+        DebugLog("DEBUG", "ResolveFunction", "Function '%s' loaded successfully, proc=0x%p", szFuncName, proc);
     } else {
-        DebugLog("ERROR", "LoadFunction", "Failed to load function '%s', GetLastError=%lu", szFuncName, GetLastError());
+        DebugLog("ERROR", "ResolveFunction", "Failed to load function '%s', GetLastError=%lu", szFuncName, GetLastError());
     }
     
     return proc;
 }
 
+// Load function from DLL
+FARPROC LoadFunction(DynamicWrapperX* pObj, LPCWSTR libraryName, LPCWSTR functionName)
+{
+    DebugLog("DEBUG", "LoadFunction", "Loading function '%S' from library '%S'", functionName, libraryName);
+    
+    HMODULE hLib = LoadCachedModule(pObj, libraryName);
+    if (!hLib)
+        return NULL;
+    
+    return ResolveFunction(hLib, functionName);
+}
+
+// Wrap count VARIANTs in a one-dimensional VT_ARRAY | VT_VARIANT result.
+// The items are moved into the array and must not be cleared by the caller.
+HRESULT CreateVariantArray(const VARIANT* items, LONG count, VARIANT* pResult)
+{
+    VARIANT* data;
+    SAFEARRAY* psa = SafeArrayCreateVector(VT_VARIANT, 0, (ULONG)count);
+    if (!psa)
+        return E_OUTOFMEMORY;
+    
+    HRESULT hr = SafeArrayAccessData(psa, (void**)&data);
+    if (FAILED(hr))
+    {
+        SafeArrayDestroy(psa);
+        return hr;
+    }
+    if (count > 0)
+        memcpy(data, items, count * sizeof(VARIANT));
+    SafeArrayUnaccessData(psa);
+    
+    VariantInit(pResult);
+    V_VT(pResult) = VT_ARRAY | VT_VARIANT;
+    V_ARRAY(pResult) = psa;
+    return S_OK;
+}
+
+// The BSTR a VARIANT holds, directly or by reference (VBScript variables),
+// or NULL if it holds something else
+BSTR* GetVariantBstr(VARIANT* pVar)
+{
+    if (pVar->vt == (VT_BYREF | VT_VARIANT) && pVar->pvarVal)
+        pVar = pVar->pvarVal;
+    
+    if (pVar->vt == VT_BSTR)
+        return &pVar->bstrVal;
+    if (pVar->vt == (VT_BYREF | VT_BSTR))
+        return pVar->pbstrVal;
+    return NULL;
+}
+
+// Lend the data of a typed SAFEARRAY (VBScript byte arrays, typed
+// NumGetArray results) to native code without copying. The array stays
+// locked until the call scope is released, so the script cannot resize or
+// free it while native code holds the pointer. Only native calls have a
+// scope that unpins, so other conversions reject arrays.
+static HRESULT PinSafeArray(VARIANT* pVar, CallScope* pScope, void** ppData)
+{
+    SAFEARRAY* psa;
+    
+    if (pVar->vt & VT_BYREF)
+        psa = pVar->pparray ? *pVar->pparray : NULL;
+    else
+        psa = pVar->parray;
+    
+    // Element types that are plain data; arrays of BSTRs, VARIANTs or
+    // objects have no meaningful native layout
+    switch (pVar->vt & VT_TYPEMASK)
+    {
+    case VT_I1: case VT_UI1: case VT_I2: case VT_UI2:
+    case VT_I4: case VT_UI4: case VT_INT: case VT_UINT:
+    case VT_I8: case VT_UI8: case VT_R4: case VT_R8:
+    case VT_CY: case VT_DATE: case VT_BOOL: case VT_ERROR:
+        break;
+    default:
+        return DISP_E_TYPEMISMATCH;
+    }
+    
+    if (!pScope)
+        return DISP_E_TYPEMISMATCH;
+    if (!psa)
+    {
+        *ppData = NULL;
+        return S_OK;
+    }
+    
+    PinnedArray* pPin = (PinnedArray*)ArenaAlloc(sizeof(PinnedArray));
+    BOOL onHeap = FALSE;
+    if (!pPin)
+    {
+        pPin = (PinnedArray*)GlobalAlloc(GMEM_FIXED, sizeof(PinnedArray));
+        if (!pPin)
+            return E_OUTOFMEMORY;
+        onHeap = TRUE;
+    }
+    
+    HRESULT hr = SafeArrayAccessData(psa, ppData);
+    if (FAILED(hr))
+    {
+        if (onHeap)
+            GlobalFree(pPin);
+        return hr;
+    }
+    
+    pPin->psa = psa;
+    pPin->onHeap = onHeap;
+    pPin->next = pScope->pinned;
+    pScope->pinned = pPin;
+    return S_OK;
+}
+
 // Convert VARIANT to specific type
-HRESULT ConvertVariantToType(VARIANT* pVar, ParameterType type, void* pOut, DynamicWrapperX* pObj)
+HRESULT ConvertVariantToType(VARIANT* pVar, ParameterType type, void* pOut, DynamicWrapperX* pObj, CallScope* pScope)
 {
     HRESULT hr = S_OK;
     VARIANT vTemp;
@@ -293,6 +527,23 @@ HRESULT ConvertVariantToType(VARIANT* pVar, ParameterType type, void* pOut, Dyna
     case TYPE_OUT_HANDLE:
     case TYPE_OUT_POINTER:
         DebugLog("DEBUG", "ConvertVariantToType", "Converting POINTER/HANDLE, vt=%d", pVar->vt);
+        {
+            // Arrays and Alloc buffers, including VBScript variables passed
+            // by reference
+            VARIANT* pInner = (pVar->vt == (VT_BYREF | VT_VARIANT) && pVar->pvarVal) ? pVar->pvarVal : pVar;
+            if (type == TYPE_POINTER && (pInner->vt & VT_ARRAY))
+            {
+                hr = PinSafeArray(pInner, pScope, (void**)pOut);
+                break;
+            }
+            if (pInner->vt == VT_DISPATCH)
+            {
+                // Alloc buffer: its data pointer, no number conversion
+                *(void**)pOut = GetNativeBufferData(pInner->pdispVal);
+                hr = *(void**)pOut ? S_OK : DISP_E_TYPEMISMATCH;
+                break;
+            }
+        }
         // Handle various VARIANT types that might represent pointers
         switch (pVar->vt) {
             case VT_NULL:
@@ -446,9 +697,11 @@ HRESULT ConvertVariantToType(VARIANT* pVar, ParameterType type, void* pOut, Dyna
     case TYPE_WSTRING:
     case TYPE_ASTRING:
     case TYPE_OSTRING:
+    case TYPE_USTRING:
     case TYPE_OUT_WSTRING:
     case TYPE_OUT_ASTRING:
     case TYPE_OUT_OSTRING:
+    case TYPE_OUT_USTRING:
         DebugLog("DEBUG", "ConvertVariantToType", "Converting STRING type, vt=%d to string type %d", pVar->vt, type);
         
         // Handle NULL strings explicitly
@@ -459,43 +712,117 @@ HRESULT ConvertVariantToType(VARIANT* pVar, ParameterType type, void* pOut, Dyna
             break;
         }
         
-        hr = VariantChangeType(&vTemp, pVar, 0, VT_BSTR);
-        if (SUCCEEDED(hr))
+        // w arguments of a native call borrow the caller's BSTR: the function
+        // only reads it, and the script keeps it alive until the call returns.
+        // Values that outlive the call (callback results) are still copied.
+        BSTR* pBorrowed = GetVariantBstr(pVar);
+        if (pBorrowed && type == TYPE_WSTRING && pScope)
         {
-            DebugLog("DEBUG", "ConvertVariantToType", "Successfully converted to BSTR");
+            *(BSTR*)pOut = *pBorrowed;
+            hr = S_OK;
+            break;
+        }
+        
+        // Strings already held as a BSTR, directly or by reference, are read
+        // in place
+        BSTR source;
+        if (pBorrowed)
+        {
+            source = *pBorrowed;
+        }
+        else
+        {
+            hr = VariantChangeType(&vTemp, pVar, 0, VT_BSTR);
+            source = V_BSTR(&vTemp);
+        }
+        
+        if (SUCCEEDED(hr) && !source)
+        {
+            *(void**)pOut = NULL;
+        }
+        else if (SUCCEEDED(hr))
+        {
+            UINT len = SysStringLen(source);
             if (type == TYPE_WSTRING || type == TYPE_OUT_WSTRING)
             {
-                *(BSTR*)pOut = V_BSTR(&vTemp);
-                V_BSTR(&vTemp) = NULL; // Transfer ownership
-                DebugLog("DEBUG", "ConvertVariantToType", "Stored as Unicode string");
+                // Call-scoped copies are built in the thread arena as a
+                // length-prefixed BSTR image; otherwise a real BSTR is tracked
+                BYTE* image = pScope ? (BYTE*)ArenaAlloc(sizeof(DWORD) + (len + 1) * sizeof(WCHAR)) : NULL;
+                if (image)
+                {
+                    WCHAR* chars = (WCHAR*)(image + sizeof(DWORD));
+                    *(DWORD*)image = len * sizeof(WCHAR);
+                    memcpy(chars, source, len * sizeof(WCHAR));
+                    chars[len] = L'\0';
+                    *(BSTR*)pOut = chars;
+                }
+                else
+                {
+                    BSTR copy = SysAllocStringLen(source, len);
+                    if (copy)
+                    {
+                        InterlockedIncrement(&pObj->callAllocations);
+                        hr = TrackMemoryBlock(pObj, pScope, copy, FALSE, (len + 1) * sizeof(WCHAR));
+                        if (SUCCEEDED(hr))
+                            *(BSTR*)pOut = copy;
+                    }
+                    else
+                    {
+                        hr = E_OUTOFMEMORY;
+                    }
+                }
+                DebugLog("DEBUG", "ConvertVariantToType", "Stored as Unicode string, len=%u", len);
             }
             else
             {
-                // Convert to ANSI/OEM
-                int len = SysStringLen(V_BSTR(&vTemp));
-                char* pszAnsi = (char*)GlobalAlloc(GMEM_FIXED, len + 1);
-                if (pszAnsi)
+                // Convert to ANSI/OEM/UTF-8, in the thread arena when the call
+                // scope allows it. The first buffer holds one byte per
+                // character; text that needs more is converted again into a
+                // buffer of the size the first attempt reported.
+                UINT codePage = GetStringCodePage(type);
+                int capacity = (int)len;
+                char* pszAnsi = NULL;
+                BOOL inArena = FALSE;
+                
+                for (int attempt = 0; attempt < 2; attempt++)
                 {
-                    UINT codePage = (type == TYPE_OSTRING || type == TYPE_OUT_OSTRING) ? CP_OEMCP : CP_ACP;
-                    WideCharToMultiByte(codePage, 0, V_BSTR(&vTemp), len, pszAnsi, len + 1, NULL, NULL);
-                    pszAnsi[len] = '\0';
-                    *(char**)pOut = pszAnsi;
-                    
-                    DebugLog("DEBUG", "ConvertVariantToType", "Converted to ANSI string, len=%d", len);
+                    pszAnsi = pScope ? (char*)ArenaAlloc((SIZE_T)capacity + 1) : NULL;
+                    inArena = pszAnsi != NULL;
+                    if (!pszAnsi)
+                    {
+                        pszAnsi = (char*)GlobalAlloc(GMEM_FIXED, (SIZE_T)capacity + 1);
+                        if (!pszAnsi)
+                            break;
+                        InterlockedIncrement(&pObj->callAllocations);
+                    }
                     
-                    // Track memory allocation
-                    MemoryBlock* pBlock = (MemoryBlock*)GlobalAlloc(GMEM_FIXED, sizeof(MemoryBlock));
-                    if (pBlock)
+                    int needed = WideToNarrow(codePage, source, (int)len, pszAnsi, capacity);
+                    if (needed <= capacity)
                     {
-                        pBlock->ptr = pszAnsi;
-                        pBlock->isGlobal = TRUE;
-                        pBlock->next = pObj->memoryBlocks;
-                        pObj->memoryBlocks = pBlock;
+                        pszAnsi[needed] = '\0';
+                        break;
                     }
+                    
+                    // Arena space is reclaimed when the call ends
+                    if (!inArena)
+                        GlobalFree(pszAnsi);
+                    pszAnsi = NULL;
+                    capacity = needed;
+                }
+                
+                if (pszAnsi)
+                {
+                    DebugLog("DEBUG", "ConvertVariantToType", "Converted to narrow string, len=%u, bytes=%d", len, capacity);
+                    
+                    // Heap buffers are tracked; arena buffers go away with the call
+                    if (!inArena)
+                        hr = TrackMemoryBlock(pObj, pScope, pszAnsi, TRUE, (SIZE_T)capacity + 1);
+                    if (SUCCEEDED(hr))
+                        *(char**)pOut = pszAnsi;
                 }
                 else
                 {
-                    DebugLog("ERROR", "ConvertVariantToType", "Failed to allocate memory for ANSI string");
+                    DebugLog("ERROR", "ConvertVariantToType", "Failed to allocate memory for narrow string");
                     hr = E_OUTOFMEMORY;
                 }
             }
@@ -595,27 +922,25 @@ HRESULT ConvertTypeToVariant(void* pData, ParameterType type, VARIANT* pVar)
         V_R8(pVar) = *(DOUBLE*)pData;
         break;
         
+    // pData holds the string pointer; a NULL string becomes ""
     case TYPE_WSTRING:
         V_VT(pVar) = VT_BSTR;
-        V_BSTR(pVar) = SysAllocString((BSTR)pData);
+        V_BSTR(pVar) = SysAllocString(*(LPCWSTR*)pData ? *(LPCWSTR*)pData : L"");
+        if (!V_BSTR(pVar))
+            return E_OUTOFMEMORY;
         break;
         
     case TYPE_ASTRING:
     case TYPE_OSTRING:
+    case TYPE_USTRING:
         {
-            V_VT(pVar) = VT_BSTR;
-            int len = strlen((char*)pData);
-            BSTR bstr = SysAllocStringLen(NULL, len);
-            if (bstr)
-            {
-                UINT codePage = (type == TYPE_OSTRING) ? CP_OEMCP : CP_ACP;
-                MultiByteToWideChar(codePage, 0, (char*)pData, len, bstr, len);
-                V_BSTR(pVar) = bstr;
-            }
-            else
-            {
+            const char* str = *(const char**)pData;
+            int len = str ? (int)strlen(str) : 0;
+            BSTR bstr = NarrowToBstr(GetStringCodePage(type), str, len);
+            if (!bstr)
                 return E_OUTOFMEMORY;
-            }
+            V_VT(pVar) = VT_BSTR;
+            V_BSTR(pVar) = bstr;
         }
         break;
         
@@ -629,7 +954,75 @@ HRESULT ConvertTypeToVariant(void* pData, ParameterType type, VARIANT* pVar)
 // Memory cleanup
 void CleanupMemoryBlocks(DynamicWrapperX* pObj)
 {
-    MemoryBlock* pBlock = pObj->memoryBlocks;
+    // Script scopes left open are released with the object
+    while (pObj->openScope)
+    {
+        CallScope* pScope = pObj->openScope;
+        pObj->openScope = pScope->parent;
+        FreeMemoryBlocks(pObj, pScope->blocks);
+        GlobalFree(pScope);
+    }
+    pObj->scopeDepth = 0;
+    
+    FreeMemoryBlocks(pObj, pObj->memoryBlocks);
+    pObj->memoryBlocks = NULL;
+}
+
+// Record an allocation in a scope. With pScope NULL the block goes to the
+// innermost script scope, or lives as long as the object when none is open.
+// On failure the allocation itself is freed.
+HRESULT TrackMemoryBlock(DynamicWrapperX* pObj, CallScope* pScope, void* ptr, BOOL isGlobal, SIZE_T size)
+{
+    MemoryBlock* pBlock = (MemoryBlock*)GlobalAlloc(GMEM_FIXED, sizeof(MemoryBlock));
+    if (!pBlock)
+    {
+        if (isGlobal)
+            GlobalFree(ptr);
+        else
+            SysFreeString((BSTR)ptr);
+        return E_OUTOFMEMORY;
+    }
+    InterlockedIncrement(&pObj->callAllocations);
+    InterlockedExchangeAdd(&pObj->liveBytes, (LONG)size);
+    
+    pBlock->ptr = ptr;
+    pBlock->isGlobal = isGlobal;
+    pBlock->size = size;
+    
+    if (pScope)
+    {
+        // Call scopes belong to the calling thread
+        pBlock->next = pScope->blocks;
+        pScope->blocks = pBlock;
+    }
+    else
+    {
+        EnterCriticalSection(&pObj->cs);
+        MemoryBlock** ppList = pObj->openScope ? &pObj->openScope->blocks : &pObj->memoryBlocks;
+        pBlock->next = *ppList;
+        *ppList = pBlock;
+        LeaveCriticalSection(&pObj->cs);
+    }
+    
+    return S_OK;
+}
+
+// Release the arrays pinned for a call
+void UnpinArrays(PinnedArray* pPin)
+{
+    while (pPin)
+    {
+        PinnedArray* pNext = pPin->next;
+        SafeArrayUnaccessData(pPin->psa);
+        if (pPin->onHeap)
+            GlobalFree(pPin);
+        pPin = pNext;
+    }
+}
+
+// Free a list of tracked blocks
+void FreeMemoryBlocks(DynamicWrapperX* pObj, MemoryBlock* pBlock)
+{
     while (pBlock)
     {
         MemoryBlock* pNext = pBlock->next;
@@ -638,9 +1031,9 @@ void CleanupMemoryBlocks(DynamicWrapperX* pObj)
             GlobalFree(pBlock->ptr);
         else
             SysFreeString((BSTR)pBlock->ptr);
-            
+        InterlockedExchangeAdd(&pObj->liveBytes, -(LONG)pBlock->size);
+        
         GlobalFree(pBlock);
         pBlock = pNext;
     }
-    pObj->memoryBlocks = NULL;
 }
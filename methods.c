@@ -40,9 +40,14 @@ HRESULT ParseParameterString(LPCWSTR paramStr, ParameterType** types, int* count
     if (!equalPos)
         return E_INVALIDARG;
     
-    // Skip past the '='
+    // Skip past the '='; '#' size markers are not parameters
     LPCWSTR typeStr = equalPos + 1;
-    int len = wcslen(typeStr);
+    int len = 0;
+    for (LPCWSTR p = typeStr; *p; p++)
+    {
+        if (*p != L'#')
+            len++;
+    }
     
     if (len == 0)
         return S_OK; // Empty parameter list is valid
@@ -51,15 +56,145 @@ HRESULT ParseParameterString(LPCWSTR paramStr, ParameterType** types, int* count
     if (!*types)
         return E_OUTOFMEMORY;
     
-    for (int i = 0; i < len; i++)
+    for (int i = 0; *typeStr; typeStr++)
     {
-        (*types)[i] = ParseParameterType(typeStr[i]);
+        if (*typeStr != L'#')
+            (*types)[i++] = ParseParameterType(*typeStr);
     }
     
     *count = len;
     return S_OK;
 }
 
+// Index of the parameter marked as a buffer size by a '#' after its letter
+// ("l=Wl#"), or -1. GrowRetry rewrites that argument with the new capacity.
+static int FindSizeMarker(LPCWSTR paramStr)
+{
+    LPCWSTR equalPos = wcschr(paramStr, L'=');
+    int index = -1;
+    
+    for (LPCWSTR p = equalPos ? equalPos + 1 : paramStr; *p; p++)
+    {
+        if (*p != L'#')
+            index++;
+        else if (index >= 0)
+            return index;
+    }
+    return -1;
+}
+
+// Allocate a FunctionInfo for a resolved export (default signature: no
+// parameters, long return)
+static FunctionInfo* CreateFunctionInfo(LPCWSTR functionName, FARPROC proc)
+{
+    FunctionInfo* pFunc = (FunctionInfo*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, sizeof(FunctionInfo));
+    if (!pFunc)
+        return NULL;
+    
+    pFunc->functionName = SysAllocString(functionName);
+    if (!pFunc->functionName)
+    {
+        GlobalFree(pFunc);
+        return NULL;
+    }
+    pFunc->functionPtr = proc;
+    pFunc->returnType = TYPE_LONG; // Default return type
+    pFunc->sizeParam = -1;
+    pFunc->sizeOutput = -1;
+    return pFunc;
+}
+
+// Parse the signature arguments accepted by Register
+static HRESULT ParseRegisterSignature(FunctionInfo* pFunc, LPCWSTR paramTypes, LPCWSTR returnType)
+{
+    HRESULT hr = S_OK;
+    
+    // Parse parameter types and return type
+    if (paramTypes)
+    {
+        LPCWSTR equalPos = wcschr(paramTypes, L'=');
+        if (equalPos && equalPos > paramTypes)
+        {
+            // Combined format like "p=puuu" - return type before '=', parameters after
+            pFunc->returnType = ParseParameterType(paramTypes[0]);
+            DebugLog("DEBUG", "ParseRegisterSignature", "Parsed return type '%c' as %d from combined signature", paramTypes[0], pFunc->returnType);
+            
+            // Parse parameters after '=' sign
+            hr = ParseParameterString(paramTypes, &pFunc->paramTypes, &pFunc->paramCount);
+        }
+        else
+        {
+            // Just parameter types, no return type specified
+            hr = ParseParameterString(paramTypes, &pFunc->paramTypes, &pFunc->paramCount);
+        }
+        pFunc->sizeParam = FindSizeMarker(paramTypes);
+    }
+    
+    // Parse separate return type (from the 4th argument, if provided)
+    if (returnType)
+    {
+        LPCWSTR equalPos = wcschr(returnType, L'=');
+        if (equalPos && equalPos > returnType)
+        {
+            // Return type is the character before the '=' sign
+            pFunc->returnType = ParseParameterType(returnType[0]);
+            DebugLog("DEBUG", "ParseRegisterSignature", "Parsed return type '%c' as %d from separate argument", returnType[0], pFunc->returnType);
+        }
+        else if (wcslen(returnType) > 0)
+        {
+            // No '=' sign, entire string is return type
+            pFunc->returnType = ParseParameterType(returnType[0]);
+            DebugLog("DEBUG", "ParseRegisterSignature", "Parsed return type '%c' as %d from separate argument", returnType[0], pFunc->returnType);
+        }
+    }
+    
+    return hr;
+}
+
+// Attach the call thunk and frame size for the parsed parameter list
+static HRESULT PrepareFunctionCall(FunctionInfo* pFunc)
+{
+    // Get the precompiled call thunk for this argument layout
+    pFunc->callThunk = GetCallThunk(pFunc->paramTypes, pFunc->paramCount);
+    if (!pFunc->callThunk)
+        return E_OUTOFMEMORY;
+    
+    pFunc->frameSlots = 0;
+    pFunc->outCount = 0;
+    for (int i = 0; i < pFunc->paramCount; i++)
+    {
+        pFunc->frameSlots += GetArgSlotCount(pFunc->paramTypes[i]);
+        if (IsOutputType(pFunc->paramTypes[i]))
+            pFunc->outCount++;
+    }
+    
+    // A '#' size parameter belongs to the nearest string output; it must
+    // be an integer, passed by value (l, u) or as an output (L, U)
+    pFunc->sizeOutput = -1;
+    if (pFunc->sizeParam >= pFunc->paramCount)
+        pFunc->sizeParam = -1;
+    if (pFunc->sizeParam >= 0)
+    {
+        ParameterType sizeType = pFunc->paramTypes[pFunc->sizeParam];
+        if (sizeType == TYPE_LONG || sizeType == TYPE_ULONG || sizeType == TYPE_OUT_LONG || sizeType == TYPE_OUT_ULONG)
+        {
+            for (int distance = 1; distance < pFunc->paramCount && pFunc->sizeOutput < 0; distance++)
+            {
+                int before = pFunc->sizeParam - distance;
+                int after = pFunc->sizeParam + distance;
+                if (before >= 0 && IsOutputText(pFunc->paramTypes[before]))
+                    pFunc->sizeOutput = before;
+                else if (after < pFunc->paramCount && IsOutputText(pFunc->paramTypes[after]))
+                    pFunc->sizeOutput = after;
+            }
+        }
+        if (pFunc->sizeOutput < 0)
+            pFunc->sizeParam = -1;
+    }
+    
+    return S_OK;
+}
+
 // Register method implementation
 HRESULT DynWrap_Register(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
 {
@@ -159,100 +294,47 @@ HRESULT DynWrap_Register(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT
         }
     }
     
-    // Load the function
-    FARPROC proc = LoadFunction(libraryName, functionName);
-    if (!proc)
+    // Load the function now, or leave it for the first call in lazy mode
+    FARPROC proc = NULL;
+    if (!(pObj->options & DYNWRAPX_OPTION_LAZY))
     {
-        hr = E_FAIL;
-        goto cleanup;
+        proc = LoadFunction(pObj, libraryName, functionName);
+        if (!proc)
+        {
+            hr = E_FAIL;
+            goto cleanup;
+        }
     }
     
     // Create function info structure
-    pFunc = (FunctionInfo*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, sizeof(FunctionInfo));
+    pFunc = CreateFunctionInfo(functionName, proc);
     if (!pFunc)
     {
         hr = E_OUTOFMEMORY;
         goto cleanup;
     }
-    
-    pFunc->functionName = SysAllocString(functionName);
-    pFunc->functionPtr = proc;
-    pFunc->returnType = TYPE_LONG; // Default return type
-    
-    // Parse parameter types and return type
-    if (paramTypes)
-    {
-        LPCWSTR equalPos = wcschr(paramTypes, L'=');
-        if (equalPos && equalPos > paramTypes)
-        {
-            // Combined format like "p=puuu" - return type before '=', parameters after
-            pFunc->returnType = ParseParameterType(paramTypes[0]);
-            DebugLog("DEBUG", "DynWrap_Register", "Parsed return type '%c' as %d from combined signature", paramTypes[0], pFunc->returnType);
-            
-            // Parse parameters after '=' sign
-            LPCWSTR paramStr = equalPos + 1;
-            if (wcslen(paramStr) > 0) {
-                int len = wcslen(paramStr);
-                pFunc->paramTypes = (ParameterType*)GlobalAlloc(GMEM_FIXED, len * sizeof(ParameterType));
-                if (!pFunc->paramTypes) {
-                    hr = E_OUTOFMEMORY;
-                    goto cleanup;
-                }
-                
-                for (int i = 0; i < len; i++) {
-                    pFunc->paramTypes[i] = ParseParameterType(paramStr[i]);
-                }
-                pFunc->paramCount = len;
-            }
-        }
-        else
-        {
-            // Just parameter types, no return type specified
-            hr = ParseParameterString(paramTypes, &pFunc->paramTypes, &pFunc->paramCount);
-            if (FAILED(hr))
-                goto cleanup;
-        }
-    }
-    
-    // Parse separate return type (from the 4th argument, if provided)
-    if (returnType)
-    {
-        LPCWSTR equalPos = wcschr(returnType, L'=');
-        if (equalPos && equalPos > returnType)
-        {
-            // Return type is the character before the '=' sign
-            pFunc->returnType = ParseParameterType(returnType[0]);
-            DebugLog("DEBUG", "DynWrap_Register", "Parsed return type '%c' as %d from separate argument", returnType[0], pFunc->returnType);
-        }
-        else if (wcslen(returnType) > 0)
-        {
-            // No '=' sign, entire string is return type
-            pFunc->returnType = ParseParameterType(returnType[0]);
-            DebugLog("DEBUG", "DynWrap_Register", "Parsed return type '%c' as %d from separate argument", returnType[0], pFunc->returnType);
-        }
-    }
-    
-    // Assign function ID
-    EnterCriticalSection(&pObj->cs);
-    
-    // Find a unique function ID
-    DWORD funcId = 2000; // Start from 2000 to avoid conflicts with built-in methods
-    FunctionInfo* pExisting = pObj->functionList;
-    while (pExisting)
+    if (!proc)
     {
-        if (pExisting->functionId >= funcId)
-            funcId = pExisting->functionId + 1;
-        pExisting = pExisting->next;
+        pFunc->libraryName = libraryName;
+        libraryName = NULL;
     }
     
-    pFunc->functionId = funcId;
+    hr = ParseRegisterSignature(pFunc, paramTypes, returnType);
+    if (FAILED(hr))
+        goto cleanup;
     
-    // Add to function list
-    pFunc->next = pObj->functionList;
-    pObj->functionList = pFunc;
+    hr = PrepareFunctionCall(pFunc);
+    if (FAILED(hr))
+        goto cleanup;
     
+    // Assign function ID and add to the registry
+    EnterCriticalSection(&pObj->cs);
+    hr = AddFunction(pObj, pFunc);
     LeaveCriticalSection(&pObj->cs);
     
+    if (FAILED(hr))
+        goto cleanup;
+    
     // Return success
     if (pVarResult)
     {
@@ -270,176 +352,465 @@ cleanup:
     SAFE_SYSFREE(returnType);
     
     if (pFunc)
-    {
-        SAFE_SYSFREE(pFunc->functionName);
-        if (pFunc->paramTypes)
-            GlobalFree(pFunc->paramTypes);
-        GlobalFree(pFunc);
-    }
+        FreeFunctionInfo(pFunc);
     
     return hr;
 }
 
-// RegisterCallback method implementation
-HRESULT DynWrap_RegisterCallback(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+// Trim blanks (and a trailing CR) from a manifest field in place
+static LPWSTR TrimManifestField(LPWSTR field)
 {
-    HRESULT hr = S_OK;
-    IDispatch* pCallback = NULL;
-    BSTR paramTypes = NULL;
-    BSTR returnType = NULL;
-    int callbackIndex = -1;
+    while (*field == L' ' || *field == L'\t')
+        field++;
     
-    // Validate parameters (minimum 1: callback function)
-    if (pDispParams->cArgs < 1)
-        return DISP_E_BADPARAMCOUNT;
+    LPWSTR end = field + wcslen(field);
+    while (end > field && (end[-1] == L' ' || end[-1] == L'\t' || end[-1] == L'\r'))
+        *--end = L'\0';
     
-    // Get callback function (parameter 0)
-    VARIANT* pCallbackArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
-    if (V_VT(pCallbackArg) != VT_DISPATCH)
-        return E_INVALIDARG;
+    return field;
+}
+
+// Register one manifest line "lib|func|i=...|r=..." (caller holds pObj->cs).
+// The module handle of the previous line is reused when the library repeats.
+static HRESULT RegisterManifestEntry(DynamicWrapperX* pObj, LPWSTR line, LPWSTR* pLastLibrary, HMODULE* pLastModule)
+{
+    LPWSTR fields[4] = { NULL, NULL, NULL, NULL };
+    int fieldCount = 0;
+    HRESULT hr;
     
-    pCallback = V_DISPATCH(pCallbackArg);
-    if (!pCallback)
+    // Split on '|'
+    for (LPWSTR p = line; fieldCount < 4; )
+    {
+        LPWSTR bar = wcschr(p, L'|');
+        if (bar)
+            *bar = L'\0';
+        fields[fieldCount++] = TrimManifestField(p);
+        if (!bar)
+            break;
+        p = bar + 1;
+    }
+    
+    if (fieldCount < 2 || !*fields[0] || !*fields[1])
         return E_INVALIDARG;
     
-    // Get parameter types (parameter 1, optional)
-    if (pDispParams->cArgs >= 2)
+    FARPROC proc = NULL;
+    if (!(pObj->options & DYNWRAPX_OPTION_LAZY))
     {
-        VARIANT* pParamArg = &pDispParams->rgvarg[pDispParams->cArgs - 2];
-        if (V_VT(pParamArg) == VT_BSTR)
+        // Consecutive entries for the same module skip the cache lookup entirely
+        if (!*pLastLibrary || _wcsicmp(*pLastLibrary, fields[0]) != 0)
         {
-            paramTypes = SysAllocString(V_BSTR(pParamArg));
+            *pLastLibrary = NULL;
+            *pLastModule = LoadCachedModule(pObj, fields[0]);
+            if (!*pLastModule)
+                return HRESULT_FROM_WIN32(ERROR_MOD_NOT_FOUND);
+            *pLastLibrary = fields[0];
         }
+        
+        proc = ResolveFunction(*pLastModule, fields[1]);
+        if (!proc)
+            return HRESULT_FROM_WIN32(ERROR_PROC_NOT_FOUND);
     }
     
-    // Get return type (parameter 2, optional)
-    if (pDispParams->cArgs >= 3)
+    FunctionInfo* pFunc = CreateFunctionInfo(fields[1], proc);
+    if (!pFunc)
+        return E_OUTOFMEMORY;
+    
+    hr = S_OK;
+    if (!proc)
     {
-        VARIANT* pRetArg = &pDispParams->rgvarg[pDispParams->cArgs - 3];
-        if (V_VT(pRetArg) == VT_BSTR)
+        // Lazy mode: resolved on the first call
+        pFunc->libraryName = SysAllocString(fields[0]);
+        if (!pFunc->libraryName)
+            hr = E_OUTOFMEMORY;
+    }
+    for (int i = 2; i < fieldCount && SUCCEEDED(hr); i++)
+    {
+        LPCWSTR field = fields[i];
+        if ((field[0] == L'i' || field[0] == L'I') && field[1] == L'=')
         {
-            returnType = SysAllocString(V_BSTR(pRetArg));
+            // Parameter list
+            if (pFunc->paramTypes)
+            {
+                GlobalFree(pFunc->paramTypes);
+                pFunc->paramTypes = NULL;
+            }
+            hr = ParseParameterString(field, &pFunc->paramTypes, &pFunc->paramCount);
+            pFunc->sizeParam = FindSizeMarker(field);
+        }
+        else if ((field[0] == L'r' || field[0] == L'R') && field[1] == L'=')
+        {
+            // Return type
+            if (field[2])
+                pFunc->returnType = ParseParameterType(field[2]);
+        }
+        else if (*field)
+        {
+            // Anything else is read the way Register reads its third argument
+            hr = ParseRegisterSignature(pFunc, field, NULL);
         }
     }
     
-    // Find an available callback slot
-    EnterCriticalSection(&pObj->cs);
+    if (SUCCEEDED(hr))
+        hr = PrepareFunctionCall(pFunc);
+    if (SUCCEEDED(hr))
+        hr = AddFunction(pObj, pFunc);
+    
+    if (FAILED(hr))
+        FreeFunctionInfo(pFunc);
+    
+    return hr;
+}
+
+// RegisterMany method implementation - registers every line of a manifest
+// ("lib|func|i=...|r=..." per line; blank lines and lines starting with '#'
+// or ';' are skipped) under a single lock and returns an array holding the
+// HRESULT of each entry (0 on success)
+HRESULT DynWrap_RegisterMany(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    HRESULT hr = S_OK;
+    BSTR manifest = NULL;
+    BOOL ownsManifest = FALSE;
+    LPWSTR buffer = NULL;
+    VARIANT* results = NULL;
+    int entryCount = 0;
+    
+    // Validate parameters (exactly 1: manifest text)
+    if (pDispParams->cArgs < 1)
+        return DISP_E_BADPARAMCOUNT;
     
-    for (int i = 0; i < 16; i++)
+    VARIANT* pManifestArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    if (V_VT(pManifestArg) == VT_BSTR)
     {
-        if (pObj->callbacks[i].scriptFunction == NULL)
-        {
-            callbackIndex = i;
-            break;
-        }
+        manifest = V_BSTR(pManifestArg);
+    }
+    else
+    {
+        VARIANT vTemp;
+        VariantInit(&vTemp);
+        hr = VariantChangeType(&vTemp, pManifestArg, 0, VT_BSTR);
+        if (FAILED(hr))
+            return hr;
+        manifest = V_BSTR(&vTemp);
+        ownsManifest = TRUE;
     }
     
-    if (callbackIndex == -1)
+    // Work on a private copy; lines and fields are split in place
+    UINT length = manifest ? SysStringLen(manifest) : 0;
+    buffer = (LPWSTR)GlobalAlloc(GMEM_FIXED, (length + 1) * sizeof(WCHAR));
+    if (!buffer)
     {
-        LeaveCriticalSection(&pObj->cs);
-        hr = E_FAIL; // No available callback slots
+        hr = E_OUTOFMEMORY;
         goto cleanup;
     }
+    if (length)
+        memcpy(buffer, manifest, length * sizeof(WCHAR));
+    buffer[length] = L'\0';
     
-    // Initialize callback info
-    CallbackInfo* pInfo = &pObj->callbacks[callbackIndex];
-    pInfo->scriptFunction = pCallback;
-    pCallback->lpVtbl->AddRef(pCallback);
-    pInfo->callbackIndex = callbackIndex;
-    pInfo->returnType = TYPE_LONG; // Default return type
-    
-    // Parse parameter types
-    if (paramTypes)
+    // One result per line, at most
+    int lineCount = 1;
+    for (UINT i = 0; i < length; i++)
     {
-        hr = ParseParameterString(paramTypes, &pInfo->paramTypes, &pInfo->paramCount);
-        if (FAILED(hr))
-        {
-            SAFE_RELEASE(pInfo->scriptFunction);
-            pInfo->callbackIndex = -1;
-            LeaveCriticalSection(&pObj->cs);
-            goto cleanup;
-        }
+        if (buffer[i] == L'\n')
+            lineCount++;
     }
-    
-    // Parse return type (from the part BEFORE the '=' sign)
-    if (returnType)
+    results = (VARIANT*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, lineCount * sizeof(VARIANT));
+    if (!results)
     {
-        LPCWSTR equalPos = wcschr(returnType, L'=');
-        if (equalPos && equalPos > returnType)
-        {
-            // Return type is the character before the '=' sign
-            pInfo->returnType = ParseParameterType(returnType[0]);
-            DebugLog("DEBUG", "DynWrap_RegisterCallback", "Parsed return type '%c' as %d", returnType[0], pInfo->returnType);
-        }
-        else if (wcslen(returnType) > 0)
-        {
-            // No '=' sign, entire string is return type
-            pInfo->returnType = ParseParameterType(returnType[0]);
-            DebugLog("DEBUG", "DynWrap_RegisterCallback", "Parsed return type '%c' as %d", returnType[0], pInfo->returnType);
-        }
+        hr = E_OUTOFMEMORY;
+        goto cleanup;
     }
     
-    // Store object reference for callback
-    g_callbackObjects[callbackIndex] = pObj;
-    
-    LeaveCriticalSection(&pObj->cs);
+    EnterCriticalSection(&pObj->cs);
     
-    // Return callback pointer
-    if (pVarResult)
+    LPWSTR lastLibrary = NULL;
+    HMODULE lastModule = NULL;
+    LPWSTR line = buffer;
+    while (line)
     {
-        VariantInit(pVarResult);
-        V_VT(pVarResult) = VT_UI4;
+        LPWSTR next = wcschr(line, L'\n');
+        if (next)
+            *next++ = L'\0';
         
-        // Return pointer to appropriate callback stub
-        switch (callbackIndex)
+        line = TrimManifestField(line);
+        if (*line && *line != L'#' && *line != L';')
         {
-        case 0: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub0; break;
-        case 1: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub1; break;
-        case 2: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub2; break;
-        case 3: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub3; break;
-        case 4: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub4; break;
-        case 5: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub5; break;
-        case 6: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub6; break;
-        case 7: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub7; break;
-        case 8: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub8; break;
-        case 9: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub9; break;
-        case 10: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub10; break;
-        case 11: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub11; break;
-        case 12: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub12; break;
-        case 13: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub13; break;
-        case 14: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub14; break;
-        case 15: V_UI4(pVarResult) = (ULONG)(ULONG_PTR)CallbackStub15; break;
+            V_VT(&results[entryCount]) = VT_I4;
+            V_I4(&results[entryCount]) = RegisterManifestEntry(pObj, line, &lastLibrary, &lastModule);
+            if (FAILED(V_I4(&results[entryCount])))
+                DebugLog("ERROR", "DynWrap_RegisterMany", "Entry %d failed with 0x%08lX", entryCount, V_I4(&results[entryCount]));
+            entryCount++;
         }
+        
+        line = next;
     }
     
+    LeaveCriticalSection(&pObj->cs);
+    
+    DebugLog("DEBUG", "DynWrap_RegisterMany", "Processed %d manifest entries", entryCount);
+    
+    if (pVarResult)
+        hr = CreateVariantArray(results, entryCount, pVarResult);
+
 cleanup:
-    SAFE_SYSFREE(paramTypes);
-    SAFE_SYSFREE(returnType);
+    if (ownsManifest)
+        SysFreeString(manifest);
+    if (buffer)
+        GlobalFree(buffer);
+    if (results)
+        GlobalFree(results);
     
     return hr;
 }
 
-// NumGet method implementation
-HRESULT DynWrap_NumGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+// RegisterCallback method implementation
+// Size the reusable argument frame of a callback and map each parameter
+// to its native argument slot, so invocations do no per-call setup
+static HRESULT PrepareCallbackFrame(CallbackInfo* pInfo)
 {
-    HRESULT hr = S_OK;
-    void* address = NULL;
-    LONG offset = 0;
-    ParameterType type = TYPE_LONG;
+    if (pInfo->paramCount == 0)
+        return S_OK;
     
-    DebugLog("DEBUG", "DynWrap_NumGet", "NumGet called with %d parameters", pDispParams->cArgs);
+    pInfo->frame = (VARIANT*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, pInfo->paramCount * sizeof(VARIANT));
+    pInfo->slotIndex = (int*)GlobalAlloc(GMEM_FIXED, pInfo->paramCount * sizeof(int));
+    if (!pInfo->frame || !pInfo->slotIndex)
+        return E_OUTOFMEMORY;
     
-    // Validate parameters (minimum 1: address)
+    for (int i = 0, slot = 0; i < pInfo->paramCount; i++)
+    {
+        VariantInit(&pInfo->frame[i]);
+        pInfo->slotIndex[i] = slot;
+        slot += GetArgSlotCount(pInfo->paramTypes[i]);
+        
+        switch (pInfo->paramTypes[i])
+        {
+        case TYPE_WSTRING:
+        case TYPE_ASTRING:
+        case TYPE_OSTRING:
+        case TYPE_USTRING:
+            pInfo->frameHasStrings = TRUE;
+            break;
+        default:
+            break;
+        }
+    }
+    return S_OK;
+}
+
+// Generate the native entry point of a parsed callback, add it to the
+// object's list and return the pointer (VT_I8 when it does not fit in
+// 32 bits). On failure the caller still owns pInfo.
+static HRESULT PublishCallback(DynamicWrapperX* pObj, CallbackInfo* pInfo, VARIANT* pVarResult)
+{
+    HRESULT hr = PrepareCallbackFrame(pInfo);
+    if (FAILED(hr))
+        return hr;
+    
+    pInfo->thunk = CreateCallbackThunk(pInfo);
+    if (!pInfo->thunk)
+        return E_OUTOFMEMORY;
+    
+    EnterCriticalSection(&pObj->cs);
+    pInfo->next = pObj->callbacks;
+    pObj->callbacks = pInfo;
+    LeaveCriticalSection(&pObj->cs);
+    
+    if (pVarResult)
+        ConvertTypeToVariant(&pInfo->thunk, TYPE_POINTER, pVarResult);
+    return S_OK;
+}
+
+// Find the callback whose entry point is thunk
+static CallbackInfo* FindCallback(DynamicWrapperX* pObj, void* thunk)
+{
+    CallbackInfo* pInfo;
+    
+    EnterCriticalSection(&pObj->cs);
+    for (pInfo = pObj->callbacks; pInfo; pInfo = pInfo->next)
+    {
+        if (pInfo->thunk == thunk)
+            break;
+    }
+    LeaveCriticalSection(&pObj->cs);
+    
+    return pInfo;
+}
+
+// Build the CallbackInfo for RegisterCallback-style arguments:
+// (function[, "r=params"[, returnType]]). The callback is not published.
+static HRESULT CreateScriptCallback(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, CallbackInfo** ppInfo)
+{
+    HRESULT hr = S_OK;
+    IDispatch* pCallback = NULL;
+    BSTR paramTypes = NULL;
+    BSTR returnType = NULL;
+    CallbackInfo* pInfo = NULL;
+    
+    // Validate parameters (minimum 1: callback function)
     if (pDispParams->cArgs < 1)
         return DISP_E_BADPARAMCOUNT;
     
-    // Get address (parameter 0)
-    VARIANT* pAddrArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    // Get callback function (parameter 0)
+    VARIANT* pCallbackArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    if (V_VT(pCallbackArg) != VT_DISPATCH)
+        return E_INVALIDARG;
+    
+    pCallback = V_DISPATCH(pCallbackArg);
+    if (!pCallback)
+        return E_INVALIDARG;
+    
+    // Get parameter types (parameter 1, optional)
+    if (pDispParams->cArgs >= 2)
+    {
+        VARIANT* pParamArg = &pDispParams->rgvarg[pDispParams->cArgs - 2];
+        if (V_VT(pParamArg) == VT_BSTR)
+        {
+            paramTypes = SysAllocString(V_BSTR(pParamArg));
+        }
+    }
+    
+    // Get return type (parameter 2, optional)
+    if (pDispParams->cArgs >= 3)
+    {
+        VARIANT* pRetArg = &pDispParams->rgvarg[pDispParams->cArgs - 3];
+        if (V_VT(pRetArg) == VT_BSTR)
+        {
+            returnType = SysAllocString(V_BSTR(pRetArg));
+        }
+    }
+    
+    // Initialize callback info
+    pInfo = (CallbackInfo*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, sizeof(CallbackInfo));
+    if (!pInfo)
+    {
+        hr = E_OUTOFMEMORY;
+        goto cleanup;
+    }
+    pInfo->scriptFunction = pCallback;
+    pCallback->lpVtbl->AddRef(pCallback);
+    pInfo->owner = pObj;
+    pInfo->returnType = TYPE_LONG; // Default return type
+    
+    // Parse parameter types
+    if (paramTypes)
+    {
+        hr = ParseParameterString(paramTypes, &pInfo->paramTypes, &pInfo->paramCount);
+        if (FAILED(hr))
+            goto cleanup;
+    }
+    
+    // Parse return type (from the part BEFORE the '=' sign)
+    if (returnType)
+    {
+        LPCWSTR equalPos = wcschr(returnType, L'=');
+        if (equalPos && equalPos > returnType)
+        {
+            // Return type is the character before the '=' sign
+            pInfo->returnType = ParseParameterType(returnType[0]);
+            DebugLog("DEBUG", "CreateScriptCallback", "Parsed return type '%c' as %d", returnType[0], pInfo->returnType);
+        }
+        else if (wcslen(returnType) > 0)
+        {
+            // No '=' sign, entire string is return type
+            pInfo->returnType = ParseParameterType(returnType[0]);
+            DebugLog("DEBUG", "CreateScriptCallback", "Parsed return type '%c' as %d", returnType[0], pInfo->returnType);
+        }
+    }
+    
+    *ppInfo = pInfo;
+    pInfo = NULL; // Owned by the caller now
+    
+cleanup:
+    if (pInfo)
+        FreeCallbackInfo(pInfo);
+    SAFE_SYSFREE(paramTypes);
+    SAFE_SYSFREE(returnType);
+    
+    return hr;
+}
+
+HRESULT DynWrap_RegisterCallback(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    CallbackInfo* pInfo = NULL;
+    HRESULT hr = CreateScriptCallback(pObj, pDispParams, &pInfo);
+    if (FAILED(hr))
+        return hr;
+    
+    hr = PublishCallback(pObj, pInfo, pVarResult);
+    if (FAILED(hr))
+        FreeCallbackInfo(pInfo);
+    return hr;
+}
+
+// FreeCallback(pointer) - release a callback, collector or asynchronous
+// callback before the object is released. Its entry point goes back to the
+// thunk pool for later callbacks, so native code must no longer call it.
+// Fails with ERROR_BUSY while the callback is running or has calls queued
+// for PumpCallbacks.
+HRESULT DynWrap_FreeCallback(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    void* thunk = NULL;
+    HRESULT hr;
+    
+    if (pDispParams->cArgs < 1)
+        return DISP_E_BADPARAMCOUNT;
+    
+    hr = ConvertVariantToType(&pDispParams->rgvarg[pDispParams->cArgs - 1], TYPE_POINTER, &thunk, pObj, NULL);
+    if (FAILED(hr))
+        return hr;
+    
+    CallbackInfo* pInfo = NULL;
+    hr = E_INVALIDARG;
+    
+    EnterCriticalSection(&pObj->cs);
+    for (CallbackInfo** ppInfo = &pObj->callbacks; *ppInfo; ppInfo = &(*ppInfo)->next)
+    {
+        if ((*ppInfo)->thunk != thunk)
+            continue;
+        
+        if ((*ppInfo)->activeCalls || (*ppInfo)->frameBusy || (*ppInfo)->queuedCalls)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_BUSY);
+        }
+        else
+        {
+            pInfo = *ppInfo;
+            *ppInfo = pInfo->next;
+            hr = S_OK;
+        }
+        break;
+    }
+    LeaveCriticalSection(&pObj->cs);
+    
+    if (pInfo)
+        FreeCallbackInfo(pInfo);
+    else
+        DebugLog("ERROR", "DynWrap_FreeCallback", "Cannot free callback 0x%p, hr=0x%08x", thunk, hr);
+    return hr;
+}
+
+// Decode a script address argument: a BSTR (its buffer) or a number that
+// may arrive as a double, 64-bit or 32-bit integer
+static HRESULT GetAddressArg(VARIANT* pAddrArg, void** pAddress)
+{
+    HRESULT hr = S_OK;
+    void* address = NULL;
+    
+    // VBScript passes variables by reference
+    if (V_VT(pAddrArg) == (VT_BYREF | VT_VARIANT) && V_VARIANTREF(pAddrArg))
+        pAddrArg = V_VARIANTREF(pAddrArg);
+    
     if (V_VT(pAddrArg) == VT_BSTR)
     {
         // String pointer
         address = V_BSTR(pAddrArg);
     }
+    else if (V_VT(pAddrArg) == VT_DISPATCH)
+    {
+        // Alloc buffer
+        address = GetNativeBufferData(V_DISPATCH(pAddrArg));
+        if (!address)
+            return DISP_E_TYPEMISMATCH;
+    }
     else
     {
         VARIANT vTemp;
@@ -448,7 +819,7 @@ HRESULT DynWrap_NumGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT*
         // Handle both 32-bit and 64-bit addresses properly
 #ifdef _WIN64
         // On 64-bit, try multiple conversion methods (same as NumPut)
-        DebugLog("DEBUG", "DynWrap_NumGet", "Original VT: %d", V_VT(pAddrArg));
+        DebugLog("DEBUG", "GetAddressArg", "Original VT: %d", V_VT(pAddrArg));
         
         // Try VT_R8 (double) first for large JavaScript numbers
         hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_R8);
@@ -456,25 +827,25 @@ HRESULT DynWrap_NumGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT*
             // Convert double to ULONG_PTR, avoiding sign extension
             double dblValue = V_R8(&vTemp);
             address = (void*)(ULONG_PTR)(UINT64)dblValue;
-            DebugLog("DEBUG", "DynWrap_NumGet", "VT_R8 conversion successful, double=%.0f, address=0x%p", dblValue, address);
+            DebugLog("DEBUG", "GetAddressArg", "VT_R8 conversion successful, double=%.0f, address=0x%p", dblValue, address);
         }
         else 
         {
-            DebugLog("DEBUG", "DynWrap_NumGet", "VT_R8 failed, trying VT_I8...");
+            DebugLog("DEBUG", "GetAddressArg", "VT_R8 failed, trying VT_I8...");
             hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_I8);
             if (SUCCEEDED(hr)) {
                 // Treat as unsigned to avoid sign extension issues
                 UINT64 unsignedAddr = (UINT64)V_I8(&vTemp);
                 address = (void*)unsignedAddr;
-                DebugLog("DEBUG", "DynWrap_NumGet", "VT_I8 conversion successful, signed=%lld, unsigned=0x%llx, address=0x%p", V_I8(&vTemp), unsignedAddr, address);
+                DebugLog("DEBUG", "GetAddressArg", "VT_I8 conversion successful, signed=%lld, unsigned=0x%llx, address=0x%p", V_I8(&vTemp), unsignedAddr, address);
             }
             else
             {
-                DebugLog("DEBUG", "DynWrap_NumGet", "VT_I8 failed, trying VT_UI4...");
+                DebugLog("DEBUG", "GetAddressArg", "VT_I8 failed, trying VT_UI4...");
                 hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_UI4);
                 if (SUCCEEDED(hr)) {
                     address = (void*)(ULONG_PTR)V_UI4(&vTemp);
-                    DebugLog("DEBUG", "DynWrap_NumGet", "VT_UI4 conversion successful, address=0x%p", address);
+                    DebugLog("DEBUG", "GetAddressArg", "VT_UI4 conversion successful, address=0x%p", address);
                 }
             }
         }
@@ -489,6 +860,145 @@ HRESULT DynWrap_NumGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT*
             return hr;
     }
     
+    *pAddress = address;
+    return S_OK;
+}
+
+// Look up a NumGet/NumPut type name (UInt, Int, UShort, Short, UChar, Char,
+// Float, Double, Ptr and their aliases, case-insensitive)
+BOOL LookupNumTypeName(LPCWSTR typeStr, ParameterType* pType)
+{
+    if (_wcsicmp(typeStr, L"UInt") == 0 || _wcsicmp(typeStr, L"ULong") == 0)
+        *pType = TYPE_ULONG;
+    else if (_wcsicmp(typeStr, L"Int") == 0 || _wcsicmp(typeStr, L"Long") == 0)
+        *pType = TYPE_LONG;
+    else if (_wcsicmp(typeStr, L"UShort") == 0)
+        *pType = TYPE_USHORT;
+    else if (_wcsicmp(typeStr, L"Short") == 0)
+        *pType = TYPE_SHORT;
+    else if (_wcsicmp(typeStr, L"UChar") == 0)
+        *pType = TYPE_UCHAR;
+    else if (_wcsicmp(typeStr, L"Char") == 0)
+        *pType = TYPE_CHAR;
+    else if (_wcsicmp(typeStr, L"Float") == 0)
+        *pType = TYPE_FLOAT;
+    else if (_wcsicmp(typeStr, L"Double") == 0)
+        *pType = TYPE_DOUBLE;
+    else if (_wcsicmp(typeStr, L"Ptr") == 0 || _wcsicmp(typeStr, L"Pointer") == 0)
+        *pType = TYPE_POINTER;
+    else
+        return FALSE;
+    return TRUE;
+}
+
+// Parse a NumGet/NumPut type: a type letter or a type name
+ParameterType ParseNumTypeName(LPCWSTR typeStr)
+{
+    ParameterType type;
+    
+    // Handle full type names (case-insensitive)
+    if (typeStr[0] && typeStr[1] && LookupNumTypeName(typeStr, &type))
+        return type;
+    return ParseParameterType(typeStr[0]);
+}
+
+// Decode a NumGet/NumPut type argument (TYPE_LONG when omitted)
+static ParameterType GetNumTypeArg(VARIANT* pTypeArg)
+{
+    if (V_VT(pTypeArg) == VT_BSTR && SysStringLen(V_BSTR(pTypeArg)) > 0)
+        return ParseNumTypeName(V_BSTR(pTypeArg));
+    return TYPE_LONG;
+}
+
+// Read one value of the given type from memory into a VARIANT
+void ReadTypedValue(const void* finalAddr, ParameterType type, VARIANT* pVarResult)
+{
+    switch (type)
+    {
+        case TYPE_CHAR:
+            V_VT(pVarResult) = VT_I1;
+            V_I1(pVarResult) = *(const CHAR*)finalAddr;
+            break;
+        case TYPE_UCHAR:
+            V_VT(pVarResult) = VT_UI1;
+            V_UI1(pVarResult) = *(const UCHAR*)finalAddr;
+            break;
+        case TYPE_SHORT:
+            V_VT(pVarResult) = VT_I2;
+            V_I2(pVarResult) = *(const SHORT*)finalAddr;
+            break;
+        case TYPE_USHORT:
+            {
+                USHORT value = *(const USHORT*)finalAddr;
+                DebugLog("DEBUG", "ReadTypedValue", "Reading USHORT from 0x%p, value=%u (0x%04x)", finalAddr, value, value);
+                V_VT(pVarResult) = VT_UI2;
+                V_UI2(pVarResult) = value;
+            }
+            break;
+        case TYPE_LONG:
+            V_VT(pVarResult) = VT_I4;
+            V_I4(pVarResult) = *(const LONG*)finalAddr;
+            break;
+        case TYPE_HANDLE:
+        case TYPE_POINTER:
+            {
+#ifdef _WIN64
+                ULONG_PTR ptrValue = *(const ULONG_PTR*)finalAddr;
+                if (ptrValue > 0xFFFFFFFFULL) {
+                    V_VT(pVarResult) = VT_I8;
+                    V_I8(pVarResult) = (LONGLONG)ptrValue;
+                } else {
+                    V_VT(pVarResult) = VT_I4;
+                    V_I4(pVarResult) = (LONG)ptrValue;
+                }
+#else
+                V_VT(pVarResult) = VT_I4;
+                V_I4(pVarResult) = *(const LONG*)finalAddr;
+#endif
+            }
+            break;
+        case TYPE_ULONG:
+            V_VT(pVarResult) = VT_UI4;
+            V_UI4(pVarResult) = *(const ULONG*)finalAddr;
+            break;
+        case TYPE_LONGLONG:
+            V_VT(pVarResult) = VT_I8;
+            V_I8(pVarResult) = *(const LONGLONG*)finalAddr;
+            break;
+        case TYPE_FLOAT:
+            V_VT(pVarResult) = VT_R4;
+            V_R4(pVarResult) = *(const FLOAT*)finalAddr;
+            break;
+        case TYPE_DOUBLE:
+            V_VT(pVarResult) = VT_R8;
+            V_R8(pVarResult) = *(const DOUBLE*)finalAddr;
+            break;
+        default:
+            V_VT(pVarResult) = VT_I4;
+            V_I4(pVarResult) = *(const LONG*)finalAddr;
+            break;
+    }
+}
+
+// NumGet method implementation
+HRESULT DynWrap_NumGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    HRESULT hr = S_OK;
+    void* address = NULL;
+    LONG offset = 0;
+    ParameterType type = TYPE_LONG;
+    
+    DebugLog("DEBUG", "DynWrap_NumGet", "NumGet called with %d parameters", pDispParams->cArgs);
+    
+    // Validate parameters (minimum 1: address)
+    if (pDispParams->cArgs < 1)
+        return DISP_E_BADPARAMCOUNT;
+    
+    // Get address (parameter 0)
+    hr = GetAddressArg(&pDispParams->rgvarg[pDispParams->cArgs - 1], &address);
+    if (FAILED(hr))
+        return hr;
+    
     // Get offset (parameter 1, optional)
     if (pDispParams->cArgs >= 2)
     {
@@ -502,43 +1012,7 @@ HRESULT DynWrap_NumGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT*
     
     // Get type (parameter 2, optional)
     if (pDispParams->cArgs >= 3)
-    {
-        VARIANT* pTypeArg = &pDispParams->rgvarg[pDispParams->cArgs - 3];
-        if (V_VT(pTypeArg) == VT_BSTR && SysStringLen(V_BSTR(pTypeArg)) > 0)
-        {
-            BSTR typeStr = V_BSTR(pTypeArg);
-            int len = SysStringLen(typeStr);
-            
-            // Handle full type names (case-insensitive)
-            if (len > 1)
-            {
-                if (_wcsicmp(typeStr, L"UInt") == 0 || _wcsicmp(typeStr, L"ULong") == 0)
-                    type = TYPE_ULONG;
-                else if (_wcsicmp(typeStr, L"Int") == 0 || _wcsicmp(typeStr, L"Long") == 0)
-                    type = TYPE_LONG;
-                else if (_wcsicmp(typeStr, L"UShort") == 0)
-                    type = TYPE_USHORT;
-                else if (_wcsicmp(typeStr, L"Short") == 0)
-                    type = TYPE_SHORT;
-                else if (_wcsicmp(typeStr, L"UChar") == 0)
-                    type = TYPE_UCHAR;
-                else if (_wcsicmp(typeStr, L"Char") == 0)
-                    type = TYPE_CHAR;
-                else if (_wcsicmp(typeStr, L"Float") == 0)
-                    type = TYPE_FLOAT;
-                else if (_wcsicmp(typeStr, L"Double") == 0)
-                    type = TYPE_DOUBLE;
-                else if (_wcsicmp(typeStr, L"Ptr") == 0 || _wcsicmp(typeStr, L"Pointer") == 0)
-                    type = TYPE_POINTER;
-                else
-                    type = ParseParameterType(typeStr[0]);
-            }
-            else
-            {
-                type = ParseParameterType(typeStr[0]);
-            }
-        }
-    }
+        type = GetNumTypeArg(&pDispParams->rgvarg[pDispParams->cArgs - 3]);
     
     // Calculate final address
     void* finalAddr = (BYTE*)address + offset;
@@ -556,157 +1030,261 @@ HRESULT DynWrap_NumGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT*
     if (pVarResult)
     {
         VariantInit(pVarResult);
-        
-        switch (type)
-        {
-            case TYPE_CHAR:
-                V_VT(pVarResult) = VT_I1;
-                V_I1(pVarResult) = *(CHAR*)finalAddr;
-                break;
-            case TYPE_UCHAR:
-                V_VT(pVarResult) = VT_UI1;
-                V_UI1(pVarResult) = *(UCHAR*)finalAddr;
-                break;
-            case TYPE_SHORT:
-                V_VT(pVarResult) = VT_I2;
-                V_I2(pVarResult) = *(SHORT*)finalAddr;
-                break;
-            case TYPE_USHORT:
-                {
-                    USHORT value = *(USHORT*)finalAddr;
-                    DebugLog("DEBUG", "DynWrap_NumGet", "Reading USHORT from 0x%p, value=%u (0x%04x)", finalAddr, value, value);
-                    V_VT(pVarResult) = VT_UI2;
-                    V_UI2(pVarResult) = value;
-                }
-                break;
-            case TYPE_LONG:
-                V_VT(pVarResult) = VT_I4;
-                V_I4(pVarResult) = *(LONG*)finalAddr;
-                break;
-            case TYPE_HANDLE:
-            case TYPE_POINTER:
-                {
-#ifdef _WIN64
-                    ULONG_PTR ptrValue = *(ULONG_PTR*)finalAddr;
-                    if (ptrValue > 0xFFFFFFFFULL) {
-                        V_VT(pVarResult) = VT_I8;
-                        V_I8(pVarResult) = (LONGLONG)ptrValue;
-                    } else {
-                        V_VT(pVarResult) = VT_I4;
-                        V_I4(pVarResult) = (LONG)ptrValue;
-                    }
-#else
-                    V_VT(pVarResult) = VT_I4;
-                    V_I4(pVarResult) = *(LONG*)finalAddr;
-#endif
-                }
-                break;
-            case TYPE_ULONG:
-                V_VT(pVarResult) = VT_UI4;
-                V_UI4(pVarResult) = *(ULONG*)finalAddr;
-                break;
-            case TYPE_LONGLONG:
-                V_VT(pVarResult) = VT_I8;
-                V_I8(pVarResult) = *(LONGLONG*)finalAddr;
-                break;
-            case TYPE_FLOAT:
-                V_VT(pVarResult) = VT_R4;
-                V_R4(pVarResult) = *(FLOAT*)finalAddr;
-                break;
-            case TYPE_DOUBLE:
-                V_VT(pVarResult) = VT_R8;
-                V_R8(pVarResult) = *(DOUBLE*)finalAddr;
-                break;
-            default:
-                V_VT(pVarResult) = VT_I4;
-                V_I4(pVarResult) = *(LONG*)finalAddr;
-                break;
-        }
+        ReadTypedValue(finalAddr, type, pVarResult);
     }
     
     return S_OK;
 }
 
-
-// NumPut method implementation
-HRESULT DynWrap_NumPut(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+// Element VARTYPE of a typed NumGetArray result, VT_EMPTY if the type has none
+static VARTYPE GetArrayElementType(ParameterType type)
 {
-    HRESULT hr = S_OK;
+    switch (type)
+    {
+    case TYPE_CHAR:     return VT_I1;
+    case TYPE_UCHAR:    return VT_UI1;
+    case TYPE_SHORT:    return VT_I2;
+    case TYPE_USHORT:   return VT_UI2;
+    case TYPE_LONG:     return VT_I4;
+    case TYPE_ULONG:    return VT_UI4;
+    case TYPE_LONGLONG: return VT_I8;
+    case TYPE_FLOAT:    return VT_R4;
+    case TYPE_DOUBLE:   return VT_R8;
+    case TYPE_HANDLE:
+    case TYPE_POINTER:  return sizeof(void*) == 8 ? VT_I8 : VT_I4;
+    default:            return VT_EMPTY;
+    }
+}
+
+// An optional argument the script left out or passed as undefined
+static BOOL IsMissingArg(DISPPARAMS* pDispParams, UINT index)
+{
+    if (index >= pDispParams->cArgs)
+        return TRUE;
+    VARIANT* pArg = &pDispParams->rgvarg[pDispParams->cArgs - 1 - index];
+    return V_VT(pArg) == VT_EMPTY || V_VT(pArg) == VT_ERROR;
+}
+
+// NumGetArray(address, offset, type, count[, stride[, typed]]) - read count
+// values in one call. The result is a VARIANT array (what JScript's VBArray
+// expects) or, with typed = true, a SAFEARRAY of the element type filled by
+// a block copy when the elements are contiguous.
+HRESULT DynWrap_NumGetArray(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    HRESULT hr;
     void* address = NULL;
     LONG offset = 0;
-    ParameterType type = TYPE_LONG;
-    
-    DebugLog("DEBUG", "DynWrap_NumPut", "NumPut called with %d arguments", pDispParams->cArgs);
+    ParameterType type;
+    LONG count;
+    LONG stride;
+    BOOL typed = FALSE;
+    VARIANT vTemp;
     
-    // Validate parameters (minimum 2: value and address)
-    if (pDispParams->cArgs < 2) {
-        DebugLog("ERROR", "DynWrap_NumPut", "Insufficient parameters: %d", pDispParams->cArgs);
+    if (pDispParams->cArgs < 4)
         return DISP_E_BADPARAMCOUNT;
+    
+    hr = GetAddressArg(&pDispParams->rgvarg[pDispParams->cArgs - 1], &address);
+    if (FAILED(hr))
+        return hr;
+    
+    VariantInit(&vTemp);
+    if (!IsMissingArg(pDispParams, 1))
+    {
+        hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 2], 0, VT_I4);
+        if (FAILED(hr))
+            return hr;
+        offset = V_I4(&vTemp);
     }
     
-    // Get value (parameter 0)
-    VARIANT* pValueArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    type = GetNumTypeArg(&pDispParams->rgvarg[pDispParams->cArgs - 3]);
     
-    // Get address (parameter 1)
-    VARIANT* pAddrArg = &pDispParams->rgvarg[pDispParams->cArgs - 2];
-    DebugLog("DEBUG", "DynWrap_NumPut", "Address parameter VT: %d", V_VT(pAddrArg));
+    hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 4], 0, VT_I4);
+    if (FAILED(hr))
+        return hr;
+    count = V_I4(&vTemp);
     
-    if (V_VT(pAddrArg) == VT_BSTR)
+    // Stride defaults to the element size (a packed array)
+    LONG size = (LONG)GetTypeSize(type);
+    stride = size;
+    if (!IsMissingArg(pDispParams, 4))
     {
-        address = V_BSTR(pAddrArg);
-        DebugLog("DEBUG", "DynWrap_NumPut", "Using BSTR address");
+        hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 5], 0, VT_I4);
+        if (FAILED(hr))
+            return hr;
+        stride = V_I4(&vTemp);
+    }
+    
+    if (!IsMissingArg(pDispParams, 5))
+    {
+        hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 6], 0, VT_BOOL);
+        if (FAILED(hr))
+            return hr;
+        typed = V_BOOL(&vTemp) != VARIANT_FALSE;
+    }
+    
+    if (count < 0 || size == 0)
+        return E_INVALIDARG;
+    
+    const BYTE* src = (const BYTE*)address + offset;
+    if (!src)
+        return E_POINTER;
+    
+    if (!pVarResult)
+        return S_OK;
+    
+    VARTYPE vt = typed ? GetArrayElementType(type) : VT_VARIANT;
+    if (vt == VT_EMPTY)
+        return E_INVALIDARG;
+    
+    SAFEARRAY* psa = SafeArrayCreateVector(vt, 0, (ULONG)count);
+    if (!psa)
+        return E_OUTOFMEMORY;
+    
+    BYTE* data;
+    hr = SafeArrayAccessData(psa, (void**)&data);
+    if (FAILED(hr))
+    {
+        SafeArrayDestroy(psa);
+        return hr;
+    }
+    
+    if (vt == VT_VARIANT)
+    {
+        // The vector is zero-initialized, so every element starts as VT_EMPTY
+        VARIANT* items = (VARIANT*)data;
+        for (LONG i = 0; i < count; i++)
+            ReadTypedValue(src + (LONG_PTR)i * stride, type, &items[i]);
+    }
+    else if (stride == size)
+    {
+        // Contiguous elements: one block copy (the CRT memcpy is vectorized)
+        memcpy(data, src, (SIZE_T)count * size);
     }
     else
     {
-        VARIANT vTemp;
-        VariantInit(&vTemp);
-        
-        DebugLog("DEBUG", "DynWrap_NumPut", "Converting address parameter...");
-        
-        // Handle both 32-bit and 64-bit addresses properly
+        for (LONG i = 0; i < count; i++)
+            memcpy(data + (SIZE_T)i * size, src + (LONG_PTR)i * stride, size);
+    }
+    
+    SafeArrayUnaccessData(psa);
+    
+    VariantInit(pVarResult);
+    V_VT(pVarResult) = VT_ARRAY | vt;
+    V_ARRAY(pVarResult) = psa;
+    return S_OK;
+}
+
+
+// Convert a script value to the given type and store it in memory
+HRESULT WriteTypedValue(void* finalAddr, ParameterType type, VARIANT* pValueArg)
+{
+    VARIANT vTemp;
+    HRESULT hr;
+    
+    VariantInit(&vTemp);
+    switch (type)
+    {
+    case TYPE_CHAR:
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I1);
+        if (SUCCEEDED(hr))
+            *(CHAR*)finalAddr = V_I1(&vTemp);
+        break;
+    case TYPE_UCHAR:
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_UI1);
+        if (SUCCEEDED(hr))
+            *(UCHAR*)finalAddr = V_UI1(&vTemp);
+        break;
+    case TYPE_SHORT:
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I2);
+        if (SUCCEEDED(hr))
+            *(SHORT*)finalAddr = V_I2(&vTemp);
+        break;
+    case TYPE_USHORT:
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_UI2);
+        if (SUCCEEDED(hr))
+            *(USHORT*)finalAddr = V_UI2(&vTemp);
+        break;
+    case TYPE_LONG:
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I4);
+        if (SUCCEEDED(hr))
+            *(LONG*)finalAddr = V_I4(&vTemp);
+        break;
+    case TYPE_HANDLE:
+    case TYPE_POINTER:
 #ifdef _WIN64
-        // On 64-bit, try multiple conversion methods
-        DebugLog("DEBUG", "DynWrap_NumPut", "Original VT: %d", V_VT(pAddrArg));
-        
-        // Try VT_R8 (double) first for large JavaScript numbers
-        hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_R8);
-        if (SUCCEEDED(hr)) {
-            // Convert double to ULONG_PTR, avoiding sign extension
-            double dblValue = V_R8(&vTemp);
-            address = (void*)(ULONG_PTR)(UINT64)dblValue;
-            DebugLog("DEBUG", "DynWrap_NumPut", "VT_R8 conversion successful, double=%.0f, address=0x%p", dblValue, address);
+        // On 64-bit, try VT_I8 first for large values, fallback to VT_I4
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I8);
+        if (SUCCEEDED(hr))
+        {
+            *(ULONG_PTR*)finalAddr = (ULONG_PTR)V_I8(&vTemp);
         }
-        else 
+        else
         {
-            DebugLog("DEBUG", "DynWrap_NumPut", "VT_R8 failed, trying VT_I8...");
-            hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_I8);
-            if (SUCCEEDED(hr)) {
-                // Treat as unsigned to avoid sign extension issues
-                UINT64 unsignedAddr = (UINT64)V_I8(&vTemp);
-                address = (void*)unsignedAddr;
-                DebugLog("DEBUG", "DynWrap_NumPut", "VT_I8 conversion successful, signed=%lld, unsigned=0x%llx, address=0x%p", V_I8(&vTemp), unsignedAddr, address);
-            }
-            else
-            {
-                DebugLog("DEBUG", "DynWrap_NumPut", "VT_I8 failed, trying VT_UI4...");
-                hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_UI4);
-                if (SUCCEEDED(hr)) {
-                    address = (void*)(ULONG_PTR)V_UI4(&vTemp);
-                    DebugLog("DEBUG", "DynWrap_NumPut", "VT_UI4 conversion successful, address=0x%p", address);
-                }
-            }
+            hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I4);
+            if (SUCCEEDED(hr))
+                *(ULONG_PTR*)finalAddr = (ULONG_PTR)V_I4(&vTemp);
         }
 #else
-        // On 32-bit, use VT_UI4
-        hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_UI4);
+        // On 32-bit, use VT_I4
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I4);
         if (SUCCEEDED(hr))
-            address = (void*)(ULONG_PTR)V_UI4(&vTemp);
+            *(LONG*)finalAddr = V_I4(&vTemp);
 #endif
-        
-        if (FAILED(hr)) {
-            DebugLog("ERROR", "DynWrap_NumPut", "Address conversion failed, hr=0x%08x", hr);
-            return hr;
-        }
+        break;
+    case TYPE_ULONG:
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_UI4);
+        if (SUCCEEDED(hr))
+            *(ULONG*)finalAddr = V_UI4(&vTemp);
+        break;
+    case TYPE_LONGLONG:
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I8);
+        if (SUCCEEDED(hr))
+            *(LONGLONG*)finalAddr = V_I8(&vTemp);
+        break;
+    case TYPE_FLOAT:
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_R4);
+        if (SUCCEEDED(hr))
+            *(FLOAT*)finalAddr = V_R4(&vTemp);
+        break;
+    case TYPE_DOUBLE:
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_R8);
+        if (SUCCEEDED(hr))
+            *(DOUBLE*)finalAddr = V_R8(&vTemp);
+        break;
+    default:
+        hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I4);
+        if (SUCCEEDED(hr))
+            *(LONG*)finalAddr = V_I4(&vTemp);
+        break;
+    }
+    
+    return hr;
+}
+
+// NumPut method implementation
+HRESULT DynWrap_NumPut(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    HRESULT hr = S_OK;
+    void* address = NULL;
+    LONG offset = 0;
+    ParameterType type = TYPE_LONG;
+    
+    DebugLog("DEBUG", "DynWrap_NumPut", "NumPut called with %d arguments", pDispParams->cArgs);
+    
+    // Validate parameters (minimum 2: value and address)
+    if (pDispParams->cArgs < 2) {
+        DebugLog("ERROR", "DynWrap_NumPut", "Insufficient parameters: %d", pDispParams->cArgs);
+        return DISP_E_BADPARAMCOUNT;
+    }
+    
+    // Get value (parameter 0)
+    VARIANT* pValueArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    
+    // Get address (parameter 1)
+    hr = GetAddressArg(&pDispParams->rgvarg[pDispParams->cArgs - 2], &address);
+    if (FAILED(hr)) {
+        DebugLog("ERROR", "DynWrap_NumPut", "Address conversion failed, hr=0x%08x", hr);
+        return hr;
     }
     
     // Get offset (parameter 2, optional)
@@ -722,43 +1300,7 @@ HRESULT DynWrap_NumPut(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT*
     
     // Get type (parameter 3, optional)
     if (pDispParams->cArgs >= 4)
-    {
-        VARIANT* pTypeArg = &pDispParams->rgvarg[pDispParams->cArgs - 4];
-        if (V_VT(pTypeArg) == VT_BSTR && SysStringLen(V_BSTR(pTypeArg)) > 0)
-        {
-            BSTR typeStr = V_BSTR(pTypeArg);
-            int len = SysStringLen(typeStr);
-            
-            // Handle full type names (case-insensitive)
-            if (len > 1)
-            {
-                if (_wcsicmp(typeStr, L"UInt") == 0 || _wcsicmp(typeStr, L"ULong") == 0)
-                    type = TYPE_ULONG;
-                else if (_wcsicmp(typeStr, L"Int") == 0 || _wcsicmp(typeStr, L"Long") == 0)
-                    type = TYPE_LONG;
-                else if (_wcsicmp(typeStr, L"UShort") == 0)
-                    type = TYPE_USHORT;
-                else if (_wcsicmp(typeStr, L"Short") == 0)
-                    type = TYPE_SHORT;
-                else if (_wcsicmp(typeStr, L"UChar") == 0)
-                    type = TYPE_UCHAR;
-                else if (_wcsicmp(typeStr, L"Char") == 0)
-                    type = TYPE_CHAR;
-                else if (_wcsicmp(typeStr, L"Float") == 0)
-                    type = TYPE_FLOAT;
-                else if (_wcsicmp(typeStr, L"Double") == 0)
-                    type = TYPE_DOUBLE;
-                else if (_wcsicmp(typeStr, L"Ptr") == 0 || _wcsicmp(typeStr, L"Pointer") == 0)
-                    type = TYPE_POINTER;
-                else
-                    type = ParseParameterType(typeStr[0]);
-            }
-            else
-            {
-                type = ParseParameterType(typeStr[0]);
-            }
-        }
-    }
+        type = GetNumTypeArg(&pDispParams->rgvarg[pDispParams->cArgs - 4]);
     
     // Calculate final address
     void* finalAddr = (BYTE*)address + offset;
@@ -774,196 +1316,537 @@ HRESULT DynWrap_NumPut(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT*
     
     DebugLog("DEBUG", "DynWrap_NumPut", "About to write value of type %d", type);
     
+    // ULONG writes are checked against the page protection first
+    if (type == TYPE_ULONG)
+    {
+        MEMORY_BASIC_INFORMATION mbi;
+        SIZE_T result = VirtualQuery(finalAddr, &mbi, sizeof(mbi));
+        if (result == sizeof(mbi)) {
+            DebugLog("DEBUG", "DynWrap_NumPut", "Memory state: 0x%08x, protect: 0x%08x, type: 0x%08x", 
+                     mbi.State, mbi.Protect, mbi.Type);
+            
+            if (!(mbi.State == MEM_COMMIT && (mbi.Protect & PAGE_READWRITE || mbi.Protect & PAGE_EXECUTE_READWRITE))) {
+                DebugLog("ERROR", "DynWrap_NumPut", "Memory not writable: state=0x%08x, protect=0x%08x", mbi.State, mbi.Protect);
+                return E_ACCESSDENIED;
+            }
+        } else {
+            // Try the write anyway
+            DebugLog("ERROR", "DynWrap_NumPut", "VirtualQuery failed for address 0x%p", finalAddr);
+        }
+    }
+    
     // Write value with type conversion
-    switch (type)
+    hr = WriteTypedValue(finalAddr, type, pValueArg);
+    if (FAILED(hr))
+        DebugLog("ERROR", "DynWrap_NumPut", "Value conversion failed, hr=0x%08x", hr);
+    
+    // Return address after written data
+    if (pVarResult)
     {
-        case TYPE_CHAR:
+        ULONG_PTR resultAddr = (ULONG_PTR)((BYTE*)finalAddr + GetTypeSize(type));
+        ConvertTypeToVariant(&resultAddr, TYPE_POINTER, pVarResult);
+    }
+    
+    DebugLog("DEBUG", "DynWrap_NumPut", "NumPut completed successfully, hr=0x%08x", hr);
+    return hr;
+}
+
+// length property of a JScript array
+HRESULT GetScriptArrayLength(IDispatch* pArray, LONG* pLength)
+{
+    LPOLESTR name = L"length";
+    DISPID dispId;
+    DISPPARAMS noArgs = { NULL, NULL, 0, 0 };
+    VARIANT varLength;
+    
+    HRESULT hr = pArray->lpVtbl->GetIDsOfNames(pArray, &IID_NULL, &name, 1, LOCALE_USER_DEFAULT, &dispId);
+    if (FAILED(hr))
+        return hr;
+    
+    VariantInit(&varLength);
+    hr = pArray->lpVtbl->Invoke(pArray, dispId, &IID_NULL, LOCALE_USER_DEFAULT,
+                                DISPATCH_PROPERTYGET, &noArgs, &varLength, NULL, NULL);
+    if (SUCCEEDED(hr))
+        hr = VariantChangeType(&varLength, &varLength, 0, VT_I4);
+    if (SUCCEEDED(hr))
+        *pLength = V_I4(&varLength);
+    VariantClear(&varLength);
+    return hr;
+}
+
+// Element of a JScript array: the property named after its index. Missing
+// elements (holes) read as undefined.
+HRESULT GetScriptArrayItem(IDispatch* pArray, LONG index, VARIANT* pItem)
+{
+    WCHAR digits[12];
+    WCHAR* name = digits + 11;
+    DISPID dispId;
+    DISPPARAMS noArgs = { NULL, NULL, 0, 0 };
+    
+    *name = L'\0';
+    do
+    {
+        *--name = (WCHAR)(L'0' + index % 10);
+        index /= 10;
+    } while (index > 0);
+    
+    VariantInit(pItem);
+    HRESULT hr = pArray->lpVtbl->GetIDsOfNames(pArray, &IID_NULL, &name, 1, LOCALE_USER_DEFAULT, &dispId);
+    if (hr == DISP_E_UNKNOWNNAME)
+        return S_OK;
+    if (FAILED(hr))
+        return hr;
+    
+    return pArray->lpVtbl->Invoke(pArray, dispId, &IID_NULL, LOCALE_USER_DEFAULT,
+                                  DISPATCH_PROPERTYGET, &noArgs, pItem, NULL, NULL);
+}
+
+// NumPutArray(array, address[, offset[, type[, stride]]]) - write every
+// element of a SAFEARRAY (VBScript array, VBArray) or JScript array in one
+// call, stride bytes apart (default: the element size). Returns the address
+// just past the last element slot (address + offset + count * stride).
+HRESULT DynWrap_NumPutArray(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    HRESULT hr;
+    void* address = NULL;
+    LONG offset = 0;
+    ParameterType type = TYPE_LONG;
+    LONG count = 0;
+    LONG stride;
+    VARIANT vTemp;
+    
+    if (pDispParams->cArgs < 2)
+        return DISP_E_BADPARAMCOUNT;
+    
+    VARIANT* pArrayArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    if (V_VT(pArrayArg) == (VT_VARIANT | VT_BYREF))
+        pArrayArg = V_VARIANTREF(pArrayArg);
+    
+    hr = GetAddressArg(&pDispParams->rgvarg[pDispParams->cArgs - 2], &address);
+    if (FAILED(hr))
+        return hr;
+    
+    VariantInit(&vTemp);
+    if (!IsMissingArg(pDispParams, 2))
+    {
+        hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 3], 0, VT_I4);
+        if (FAILED(hr))
+            return hr;
+        offset = V_I4(&vTemp);
+    }
+    
+    if (!IsMissingArg(pDispParams, 3))
+        type = GetNumTypeArg(&pDispParams->rgvarg[pDispParams->cArgs - 4]);
+    
+    LONG size = (LONG)GetTypeSize(type);
+    stride = size;
+    if (!IsMissingArg(pDispParams, 4))
+    {
+        hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 5], 0, VT_I4);
+        if (FAILED(hr))
+            return hr;
+        stride = V_I4(&vTemp);
+    }
+    
+    BYTE* dst = (BYTE*)address + offset;
+    if (!dst)
+        return E_POINTER;
+    
+    if (V_VT(pArrayArg) & VT_ARRAY)
+    {
+        SAFEARRAY* psa = (V_VT(pArrayArg) & VT_BYREF) ? *V_ARRAYREF(pArrayArg) : V_ARRAY(pArrayArg);
+        VARTYPE vt = V_VT(pArrayArg) & VT_TYPEMASK;
+        LONG lower, upper;
+        BYTE* data;
+        
+        if (!psa || SafeArrayGetDim(psa) != 1)
+            return E_INVALIDARG;
+        SafeArrayGetLBound(psa, 1, &lower);
+        SafeArrayGetUBound(psa, 1, &upper);
+        count = upper - lower + 1;
+        UINT elementSize = SafeArrayGetElemsize(psa);
+        
+        hr = SafeArrayAccessData(psa, (void**)&data);
+        if (FAILED(hr))
+            return hr;
+        
+        if (vt == GetArrayElementType(type) && stride == size)
+        {
+            // Same element type, packed: one block copy
+            memcpy(dst, data, (SIZE_T)count * size);
+        }
+        else if (vt == VT_VARIANT)
+        {
+            VARIANT* items = (VARIANT*)data;
+            for (LONG i = 0; i < count && SUCCEEDED(hr); i++)
+                hr = WriteTypedValue(dst + (LONG_PTR)i * stride, type, &items[i]);
+        }
+        else if (elementSize <= sizeof(LONGLONG))
+        {
+            // Typed elements are viewed through a borrowed VARIANT
+            for (LONG i = 0; i < count && SUCCEEDED(hr); i++)
             {
-                VARIANT vTemp;
-                VariantInit(&vTemp);
-                hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I1);
-                if (SUCCEEDED(hr))
-                    *(CHAR*)finalAddr = V_I1(&vTemp);
+                VARIANT item;
+                VariantInit(&item);
+                V_VT(&item) = vt;
+                memcpy(&V_UI1(&item), data + (SIZE_T)i * elementSize, elementSize);
+                hr = WriteTypedValue(dst + (LONG_PTR)i * stride, type, &item);
             }
-            break;
-    case TYPE_UCHAR:
+        }
+        else
         {
-            VARIANT vTemp;
-            VariantInit(&vTemp);
-            hr = VariantChangeType(&vTemp, pValueArg, 0, VT_UI1);
-            if (SUCCEEDED(hr))
-                *(UCHAR*)finalAddr = V_UI1(&vTemp);
+            hr = DISP_E_TYPEMISMATCH;
         }
-        break;
-    case TYPE_SHORT:
+        
+        SafeArrayUnaccessData(psa);
+    }
+    else if (V_VT(pArrayArg) == VT_DISPATCH && V_DISPATCH(pArrayArg))
+    {
+        IDispatch* pArray = V_DISPATCH(pArrayArg);
+        hr = GetScriptArrayLength(pArray, &count);
+        
+        for (LONG i = 0; i < count && SUCCEEDED(hr); i++)
         {
-            VARIANT vTemp;
-            VariantInit(&vTemp);
-            hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I2);
+            VARIANT item;
+            hr = GetScriptArrayItem(pArray, i, &item);
             if (SUCCEEDED(hr))
-                *(SHORT*)finalAddr = V_I2(&vTemp);
+                hr = WriteTypedValue(dst + (LONG_PTR)i * stride, type, &item);
+            VariantClear(&item);
         }
-        break;
-    case TYPE_USHORT:
+    }
+    else
+    {
+        return DISP_E_TYPEMISMATCH;
+    }
+    
+    if (FAILED(hr))
+        return hr;
+    
+    if (pVarResult)
+    {
+        ULONG_PTR resultAddr = (ULONG_PTR)(dst + (LONG_PTR)count * stride);
+        ConvertTypeToVariant(&resultAddr, TYPE_POINTER, pVarResult);
+    }
+    return S_OK;
+}
+
+// Look up the struct named by argument 0
+static HRESULT GetStructArg(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, StructDef** ppDef)
+{
+    VARIANT* pNameArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    if (V_VT(pNameArg) != VT_BSTR || !V_BSTR(pNameArg))
+        return DISP_E_TYPEMISMATCH;
+    
+    *ppDef = FindStruct(pObj, V_BSTR(pNameArg));
+    if (!*ppDef)
+    {
+        DebugLog("ERROR", "GetStructArg", "Struct '%S' is not defined", V_BSTR(pNameArg));
+        return E_INVALIDARG;
+    }
+    return S_OK;
+}
+
+// DefineStruct(name, layout) - compile a layout such as
+// "u dwSize; u th32ProcessID; w szExeFile[260]" once, with natural
+// alignment. Fields are "type name" or "type name[count]"; w/s/z fields must
+// have a count and hold inline strings. Returns the struct size in bytes.
+HRESULT DynWrap_DefineStruct(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    StructDef* pDef = NULL;
+    
+    if (pDispParams->cArgs < 2)
+        return DISP_E_BADPARAMCOUNT;
+    
+    VARIANT* pNameArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    VARIANT* pLayoutArg = &pDispParams->rgvarg[pDispParams->cArgs - 2];
+    if (V_VT(pNameArg) != VT_BSTR || V_VT(pLayoutArg) != VT_BSTR)
+        return DISP_E_TYPEMISMATCH;
+    
+    HRESULT hr = DefineStruct(pObj, V_BSTR(pNameArg), V_BSTR(pLayoutArg), &pDef);
+    if (FAILED(hr))
+        return hr;
+    
+    if (pVarResult)
+    {
+        VariantInit(pVarResult);
+        V_VT(pVarResult) = VT_I4;
+        V_I4(pVarResult) = pDef->size;
+    }
+    return S_OK;
+}
+
+// ReadStruct(name, address[, offset]) - read every field in one pass; the
+// result exposes the fields as properties (rec.dwSize, rec.szExeFile)
+HRESULT DynWrap_ReadStruct(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    StructDef* pDef;
+    void* address = NULL;
+    LONG offset = 0;
+    HRESULT hr;
+    
+    if (pDispParams->cArgs < 2)
+        return DISP_E_BADPARAMCOUNT;
+    
+    hr = GetStructArg(pObj, pDispParams, &pDef);
+    if (FAILED(hr))
+        return hr;
+    
+    hr = GetAddressArg(&pDispParams->rgvarg[pDispParams->cArgs - 2], &address);
+    if (FAILED(hr))
+        return hr;
+    
+    if (!IsMissingArg(pDispParams, 2))
+    {
+        VARIANT vTemp;
+        VariantInit(&vTemp);
+        hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 3], 0, VT_I4);
+        if (FAILED(hr))
+            return hr;
+        offset = V_I4(&vTemp);
+    }
+    
+    const BYTE* src = (const BYTE*)address + offset;
+    if (!src)
+        return E_POINTER;
+    
+    if (!pVarResult)
+        return S_OK;
+    return ReadStruct(pObj, pDef, src, pVarResult);
+}
+
+// WriteStruct(name, address, object) - store the fields of a ReadStruct
+// record or any script object with matching property names; fields the
+// object does not have are left unchanged. Returns the address just past
+// the struct.
+HRESULT DynWrap_WriteStruct(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    StructDef* pDef;
+    void* address = NULL;
+    HRESULT hr;
+    
+    if (pDispParams->cArgs < 3)
+        return DISP_E_BADPARAMCOUNT;
+    
+    hr = GetStructArg(pObj, pDispParams, &pDef);
+    if (FAILED(hr))
+        return hr;
+    
+    hr = GetAddressArg(&pDispParams->rgvarg[pDispParams->cArgs - 2], &address);
+    if (FAILED(hr))
+        return hr;
+    if (!address)
+        return E_POINTER;
+    
+    hr = WriteStruct(pDef, address, &pDispParams->rgvarg[pDispParams->cArgs - 3]);
+    if (FAILED(hr))
+        return hr;
+    
+    if (pVarResult)
+    {
+        void* next = (BYTE*)address + pDef->size;
+        ConvertTypeToVariant(&next, TYPE_POINTER, pVarResult);
+    }
+    return S_OK;
+}
+
+// StrPtr method implementation  
+HRESULT DynWrap_StrPtr(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    HRESULT hr = S_OK;
+    BSTR inputStr = NULL;
+    ParameterType type = TYPE_WSTRING;
+    
+    // Validate parameters (minimum 1: string)
+    if (pDispParams->cArgs < 1)
+        return DISP_E_BADPARAMCOUNT;
+    
+    // Get string (parameter 0). Script strings are read in place; other
+    // values are converted into a temporary BSTR.
+    VARIANT* pStrArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    BSTR* pSource = GetVariantBstr(pStrArg);
+    if (pSource)
+    {
+        inputStr = *pSource;
+    }
+    else
+    {
+        VARIANT vTemp;
+        VariantInit(&vTemp);
+        hr = VariantChangeType(&vTemp, pStrArg, 0, VT_BSTR);
+        if (FAILED(hr))
+            return hr;
+        inputStr = V_BSTR(&vTemp);
+        if (!inputStr)
+            return E_OUTOFMEMORY;
+    }
+    
+    // Get type (parameter 1, optional)
+    if (pDispParams->cArgs >= 2)
+    {
+        VARIANT* pTypeArg = &pDispParams->rgvarg[pDispParams->cArgs - 2];
+        if (V_VT(pTypeArg) == VT_BSTR && SysStringLen(V_BSTR(pTypeArg)) > 0)
         {
-            VARIANT vTemp;
-            VariantInit(&vTemp);
-            hr = VariantChangeType(&vTemp, pValueArg, 0, VT_UI2);
-            if (SUCCEEDED(hr))
-                *(USHORT*)finalAddr = V_UI2(&vTemp);
+            WCHAR typeChar = V_BSTR(pTypeArg)[0];
+            if (typeChar == L'w')
+                type = TYPE_WSTRING;
+            else if (typeChar == L's')
+                type = TYPE_ASTRING;
+            else if (typeChar == L'z')
+                type = TYPE_OSTRING;
+            else if (typeChar == L'a')
+                type = TYPE_USTRING;
         }
-        break;
-    case TYPE_LONG:
-    case TYPE_HANDLE:
-    case TYPE_POINTER:
+    }
+    
+    // Get borrow flag (parameter 2, optional): return the script string's
+    // own buffer instead of a copy
+    BOOL borrow = FALSE;
+    if (pDispParams->cArgs >= 3)
+    {
+        VARIANT vFlag;
+        VariantInit(&vFlag);
+        if (SUCCEEDED(VariantChangeType(&vFlag, &pDispParams->rgvarg[pDispParams->cArgs - 3], 0, VT_BOOL)))
+            borrow = V_BOOL(&vFlag) != VARIANT_FALSE;
+    }
+    
+    void* resultPtr = NULL;
+    
+    if (type == TYPE_WSTRING && borrow && pSource)
+    {
+        // Borrowed: valid only as long as the script holds that string, so
+        // never for a temporary such as StrPtr(Space(260)) or StrPtr("a" + b)
+        resultPtr = inputStr;
+    }
+    else if (type == TYPE_WSTRING)
+    {
+        // A copy lives until the innermost BeginScope scope ends, or until
+        // the object is released when no scope is open
+        if (pSource)
         {
-            VARIANT vTemp;
-            VariantInit(&vTemp);
+            inputStr = SysAllocStringLen(inputStr, SysStringLen(inputStr));
+            if (!inputStr)
+                return E_OUTOFMEMORY;
+        }
+        hr = TrackMemoryBlock(pObj, NULL, inputStr, FALSE, SysStringByteLen(inputStr) + sizeof(WCHAR));
+        if (FAILED(hr))
+            return hr;
+        resultPtr = inputStr;
+    }
+    else
+    {
+        // Convert to ANSI, OEM or UTF-8, tracked like a converted w string.
+        // Sized for one byte per character, and converted again when the
+        // text needs more.
+        UINT codePage = GetStringCodePage(type);
+        int len = SysStringLen(inputStr);
+        int capacity = len;
+        char* pszConverted = NULL;
+        
+        for (int attempt = 0; attempt < 2 && !pszConverted; attempt++)
+        {
+            pszConverted = (char*)GlobalAlloc(GMEM_FIXED, (SIZE_T)capacity + 1);
+            if (!pszConverted)
+                break;
             
-#ifdef _WIN64
-            // On 64-bit, try VT_I8 first for large values, fallback to VT_I4
-            hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I8);
-            if (SUCCEEDED(hr))
+            int needed = WideToNarrow(codePage, inputStr, len, pszConverted, capacity);
+            if (needed <= capacity)
             {
-                *(ULONG_PTR*)finalAddr = (ULONG_PTR)V_I8(&vTemp);
+                pszConverted[needed] = '\0';
             }
             else
             {
-                hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I4);
-                if (SUCCEEDED(hr))
-                    *(ULONG_PTR*)finalAddr = (ULONG_PTR)V_I4(&vTemp);
-            }
-#else
-            // On 32-bit, use VT_I4
-            hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I4);
-            if (SUCCEEDED(hr))
-                *(LONG*)finalAddr = V_I4(&vTemp);
-#endif
-        }
-        break;
-    case TYPE_ULONG:
-        {
-            VARIANT vTemp;
-            VariantInit(&vTemp);
-            DebugLog("DEBUG", "DynWrap_NumPut", "Writing ULONG value...");
-            hr = VariantChangeType(&vTemp, pValueArg, 0, VT_UI4);
-            if (SUCCEEDED(hr)) {
-                ULONG valueToWrite = V_UI4(&vTemp);
-                DebugLog("DEBUG", "DynWrap_NumPut", "About to write ULONG %u to address 0x%p", valueToWrite, finalAddr);
-                
-                // Check if memory is writable using VirtualQuery
-                MEMORY_BASIC_INFORMATION mbi;
-                SIZE_T result = VirtualQuery(finalAddr, &mbi, sizeof(mbi));
-                if (result == sizeof(mbi)) {
-                    DebugLog("DEBUG", "DynWrap_NumPut", "Memory state: 0x%08x, protect: 0x%08x, type: 0x%08x", 
-                             mbi.State, mbi.Protect, mbi.Type);
-                    
-                    if (mbi.State == MEM_COMMIT && (mbi.Protect & PAGE_READWRITE || mbi.Protect & PAGE_EXECUTE_READWRITE)) {
-                        *(ULONG*)finalAddr = valueToWrite;
-                        DebugLog("DEBUG", "DynWrap_NumPut", "ULONG value written successfully: %u", valueToWrite);
-                    } else {
-                        DebugLog("ERROR", "DynWrap_NumPut", "Memory not writable: state=0x%08x, protect=0x%08x", mbi.State, mbi.Protect);
-                        hr = E_ACCESSDENIED;
-                    }
-                } else {
-                    DebugLog("ERROR", "DynWrap_NumPut", "VirtualQuery failed for address 0x%p", finalAddr);
-                    // Try the write anyway
-                    *(ULONG*)finalAddr = valueToWrite;
-                    DebugLog("DEBUG", "DynWrap_NumPut", "ULONG value written (VirtualQuery failed): %u", valueToWrite);
-                }
-            } else {
-                DebugLog("ERROR", "DynWrap_NumPut", "ULONG conversion failed, hr=0x%08x", hr);
+                GlobalFree(pszConverted);
+                pszConverted = NULL;
+                capacity = needed;
             }
         }
-        break;
-    case TYPE_FLOAT:
-        {
-            VARIANT vTemp;
-            VariantInit(&vTemp);
-            hr = VariantChangeType(&vTemp, pValueArg, 0, VT_R4);
-            if (SUCCEEDED(hr))
-                *(FLOAT*)finalAddr = V_R4(&vTemp);
-        }
-        break;
-    case TYPE_DOUBLE:
-        {
-            VARIANT vTemp;
-            VariantInit(&vTemp);
-            hr = VariantChangeType(&vTemp, pValueArg, 0, VT_R8);
-            if (SUCCEEDED(hr))
-                *(DOUBLE*)finalAddr = V_R8(&vTemp);
-        }
-        break;
-    default:
+        
+        if (!pszConverted)
+            hr = E_OUTOFMEMORY;
+        else
         {
-            VARIANT vTemp;
-            VariantInit(&vTemp);
-            hr = VariantChangeType(&vTemp, pValueArg, 0, VT_I4);
-            if (SUCCEEDED(hr))
-                *(LONG*)finalAddr = V_I4(&vTemp);
+            hr = TrackMemoryBlock(pObj, NULL, pszConverted, TRUE, (SIZE_T)capacity + 1);
+            resultPtr = pszConverted;
         }
-        break;
+        
+        if (!pSource)
+            SysFreeString(inputStr);
+        if (FAILED(hr))
+            return hr;
     }
     
-    // Return address after written data
+    // Return pointer
     if (pVarResult)
     {
         VariantInit(pVarResult);
-        ULONG_PTR resultAddr = (ULONG_PTR)((BYTE*)finalAddr + GetTypeSize(type));
+        ULONG_PTR ptrValue = (ULONG_PTR)resultPtr;
         
 #ifdef _WIN64
-        // On 64-bit, return as VT_I8 if the address is large
-        if (resultAddr > 0xFFFFFFFF)
+        // On 64-bit, return large pointers as VT_I8
+        if (ptrValue > 0xFFFFFFFF)
         {
             V_VT(pVarResult) = VT_I8;
-            V_I8(pVarResult) = (LONGLONG)resultAddr;
+            V_I8(pVarResult) = (LONGLONG)ptrValue;
         }
         else
         {
             V_VT(pVarResult) = VT_UI4;
-            V_UI4(pVarResult) = (ULONG)resultAddr;
+            V_UI4(pVarResult) = (ULONG)ptrValue;
         }
 #else
         // On 32-bit, always use VT_UI4
         V_VT(pVarResult) = VT_UI4;
-        V_UI4(pVarResult) = (ULONG)resultAddr;
+        V_UI4(pVarResult) = (ULONG)ptrValue;
 #endif
     }
     
-    DebugLog("DEBUG", "DynWrap_NumPut", "NumPut completed successfully, hr=0x%08x", hr);
-    return hr;
+    return S_OK;
 }
 
-// StrPtr method implementation  
-HRESULT DynWrap_StrPtr(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+// StrGet method implementation
+HRESULT DynWrap_StrGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
 {
     HRESULT hr = S_OK;
-    BSTR inputStr = NULL;
+    void* address = NULL;
     ParameterType type = TYPE_WSTRING;
     
-    // Validate parameters (minimum 1: string)
+    // Validate parameters (minimum 1: address)
     if (pDispParams->cArgs < 1)
         return DISP_E_BADPARAMCOUNT;
     
-    // Get string (parameter 0)
-    VARIANT* pStrArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
-    if (V_VT(pStrArg) != VT_BSTR)
+    // Get address (parameter 0)
+    VARIANT* pAddrArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    if (V_VT(pAddrArg) == VT_BSTR)
+    {
+        address = V_BSTR(pAddrArg);
+    }
+    else
     {
         VARIANT vTemp;
         VariantInit(&vTemp);
-        hr = VariantChangeType(&vTemp, pStrArg, 0, VT_BSTR);
+        
+        // Handle both 32-bit and 64-bit addresses properly
+#ifdef _WIN64
+        // On 64-bit, try VT_I8 first, fallback to VT_UI4
+        hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_I8);
+        if (SUCCEEDED(hr))
+            address = (void*)(ULONG_PTR)V_I8(&vTemp);
+        else
+        {
+            hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_UI4);
+            if (SUCCEEDED(hr))
+                address = (void*)(ULONG_PTR)V_UI4(&vTemp);
+        }
+#else
+        // On 32-bit, use VT_UI4
+        hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_UI4);
+        if (SUCCEEDED(hr))
+            address = (void*)(ULONG_PTR)V_UI4(&vTemp);
+#endif
+        
         if (FAILED(hr))
             return hr;
-        inputStr = V_BSTR(&vTemp);
-        V_BSTR(&vTemp) = NULL;
     }
-    else
-    {
-        inputStr = SysAllocString(V_BSTR(pStrArg));
-    }
-    
-    if (!inputStr)
-        return E_OUTOFMEMORY;
     
     // Get type (parameter 1, optional)
     if (pDispParams->cArgs >= 2)
@@ -978,263 +1861,633 @@ HRESULT DynWrap_StrPtr(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT*
                 type = TYPE_ASTRING;
             else if (typeChar == L'z')
                 type = TYPE_OSTRING;
+            else if (typeChar == L'a')
+                type = TYPE_USTRING;
         }
     }
     
-    void* resultPtr = NULL;
+    BSTR resultStr = NULL;
     
     if (type == TYPE_WSTRING)
     {
-        // Return pointer to Unicode string
-        resultPtr = inputStr;
+        // Read Unicode string
+        WCHAR* pwszStr = (WCHAR*)address;
+        if (pwszStr)
+        {
+            resultStr = SysAllocString(pwszStr);
+        }
     }
     else
     {
-        // Convert to ANSI or OEM
-        int len = SysStringLen(inputStr);
-        char* pszConverted = (char*)GlobalAlloc(GMEM_FIXED, len + 1);
-        if (pszConverted)
+        // Read ANSI/OEM/UTF-8 string and convert to Unicode
+        char* pszStr = (char*)address;
+        if (pszStr)
+            resultStr = NarrowToBstr(GetStringCodePage(type), pszStr, (int)strlen(pszStr));
+    }
+    
+    // Return string
+    if (pVarResult)
+    {
+        VariantInit(pVarResult);
+        V_VT(pVarResult) = VT_BSTR;
+        V_BSTR(pVarResult) = resultStr ? resultStr : SysAllocString(L"");
+    }
+    else if (resultStr)
+    {
+        SysFreeString(resultStr);
+    }
+    
+    return S_OK;
+}
+
+// Space method implementation
+HRESULT DynWrap_Space(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    HRESULT hr = S_OK;
+    UINT count = 0;
+    WCHAR fillChar = L' ';
+    
+    // Validate parameters (minimum 1: count)
+    if (pDispParams->cArgs < 1)
+        return DISP_E_BADPARAMCOUNT;
+    
+    // Get count (parameter 0)
+    VARIANT* pCountArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    VARIANT vTemp;
+    VariantInit(&vTemp);
+    hr = VariantChangeType(&vTemp, pCountArg, 0, VT_UI4);
+    if (FAILED(hr))
+        return hr;
+    count = V_UI4(&vTemp);
+    
+    // Get fill character (parameter 1, optional)
+    if (pDispParams->cArgs >= 2)
+    {
+        VARIANT* pCharArg = &pDispParams->rgvarg[pDispParams->cArgs - 2];
+        if (V_VT(pCharArg) == VT_BSTR)
         {
-            UINT codePage = (type == TYPE_OSTRING) ? CP_OEMCP : CP_ACP;
-            WideCharToMultiByte(codePage, 0, inputStr, len, pszConverted, len + 1, NULL, NULL);
-            pszConverted[len] = '\0';
-            resultPtr = pszConverted;
-            
-            // Track memory allocation
-            MemoryBlock* pBlock = (MemoryBlock*)GlobalAlloc(GMEM_FIXED, sizeof(MemoryBlock));
-            if (pBlock)
+            BSTR charStr = V_BSTR(pCharArg);
+            if (SysStringLen(charStr) > 0)
+            {
+                fillChar = charStr[0];
+            }
+            else
             {
-                pBlock->ptr = pszConverted;
-                pBlock->isGlobal = TRUE;
-                pBlock->next = pObj->memoryBlocks;
-                pObj->memoryBlocks = pBlock;
+                fillChar = L'\0'; // Empty string means null character
             }
         }
-        else
+        else if (V_VT(pCharArg) != VT_EMPTY && V_VT(pCharArg) != VT_NULL)
         {
-            SAFE_SYSFREE(inputStr);
-            return E_OUTOFMEMORY;
+            VARIANT vCharTemp;
+            VariantInit(&vCharTemp);
+            hr = VariantChangeType(&vCharTemp, pCharArg, 0, VT_BSTR);
+            if (SUCCEEDED(hr) && SysStringLen(V_BSTR(&vCharTemp)) > 0)
+            {
+                fillChar = V_BSTR(&vCharTemp)[0];
+            }
+            VariantClear(&vCharTemp);
         }
     }
     
-    // Return pointer
+    // Create string
+    BSTR resultStr = SysAllocStringLen(NULL, count);
+    if (!resultStr)
+        return E_OUTOFMEMORY;
+    
+    // Fill with character
+    for (UINT i = 0; i < count; i++)
+    {
+        resultStr[i] = fillChar;
+    }
+    
+    // Return string
     if (pVarResult)
     {
         VariantInit(pVarResult);
-        ULONG_PTR ptrValue = (ULONG_PTR)resultPtr;
-        
+        V_VT(pVarResult) = VT_BSTR;
+        V_BSTR(pVarResult) = resultStr;
+    }
+    else
+    {
+        SysFreeString(resultStr);
+    }
+    
+    return S_OK;
+}
+
+// Alloc(size[, align = 16]) - zero-filled native memory owned by a buffer
+// object: buf.ptr, buf.size and typed accessors (buf.u32(i) reads,
+// buf.u32(i, value) writes). The buffer can be passed directly wherever an
+// address or a p parameter is expected; it is freed with its last reference.
+HRESULT DynWrap_Alloc(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    HRESULT hr;
+    VARIANT vTemp;
+    SIZE_T size;
+    SIZE_T align = 16;
+    
+    if (pDispParams->cArgs < 1)
+        return DISP_E_BADPARAMCOUNT;
+    
+    VariantInit(&vTemp);
 #ifdef _WIN64
-        // On 64-bit, return large pointers as VT_I8
-        if (ptrValue > 0xFFFFFFFF)
+    hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 1], 0, VT_I8);
+    if (FAILED(hr))
+        return hr;
+    if (V_I8(&vTemp) < 0)
+        return E_INVALIDARG;
+    size = (SIZE_T)V_I8(&vTemp);
+#else
+    hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 1], 0, VT_UI4);
+    if (FAILED(hr))
+        return hr;
+    size = V_UI4(&vTemp);
+#endif
+    
+    if (!IsMissingArg(pDispParams, 1))
+    {
+        hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 2], 0, VT_UI4);
+        if (FAILED(hr))
+            return hr;
+        align = V_UI4(&vTemp);
+    }
+    
+    if (!pVarResult)
+        return S_OK;
+    
+    hr = CreateNativeBuffer(size, align, pVarResult);
+    if (FAILED(hr))
+        DebugLog("ERROR", "DynWrap_Alloc", "Cannot allocate %Iu bytes (align %Iu), hr=0x%08x", size, align, hr);
+    return hr;
+}
+
+// Counter method implementation - reads an internal counter by name
+HRESULT DynWrap_Counter(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    LONG value;
+    
+    // Validate parameters (exactly 1: counter name)
+    if (pDispParams->cArgs < 1)
+        return DISP_E_BADPARAMCOUNT;
+    
+    VARIANT* pNameArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    if (V_VT(pNameArg) != VT_BSTR || !V_BSTR(pNameArg))
+        return E_INVALIDARG;
+    
+    if (_wcsicmp(V_BSTR(pNameArg), L"CallAllocs") == 0)
+        value = pObj->callAllocations;
+    else if (_wcsicmp(V_BSTR(pNameArg), L"ModuleHits") == 0)
+        value = pObj->moduleCacheHits;
+    else if (_wcsicmp(V_BSTR(pNameArg), L"ModuleMisses") == 0)
+        value = pObj->moduleCacheMisses;
+    else if (_wcsicmp(V_BSTR(pNameArg), L"LazyResolves") == 0)
+        value = pObj->lazyResolves;
+    else if (_wcsicmp(V_BSTR(pNameArg), L"LiveBytes") == 0)
+        value = pObj->liveBytes;
+    else if (_wcsicmp(V_BSTR(pNameArg), L"AsyncDropped") == 0)
+        value = pObj->asyncDropped;
+    else
+        return E_INVALIDARG;
+    
+    if (pVarResult)
+    {
+        VariantInit(pVarResult);
+        V_VT(pVarResult) = VT_I4;
+        V_I4(pVarResult) = value;
+    }
+    
+    return S_OK;
+}
+
+// Map an option name to its DYNWRAPX_OPTION_* flag (0 if unknown)
+static DWORD GetOptionFlag(LPCWSTR name)
+{
+    if (_wcsicmp(name, L"Lazy") == 0)
+        return DYNWRAPX_OPTION_LAZY;
+    if (_wcsicmp(name, L"Trace") == 0)
+        return DYNWRAPX_OPTION_TRACE;
+    if (_wcsicmp(name, L"Stats") == 0)
+        return DYNWRAPX_OPTION_STATS;
+    if (_wcsicmp(name, L"OutArray") == 0)
+        return DYNWRAPX_OPTION_OUTARRAY;
+    if (_wcsicmp(name, L"GrowRetry") == 0)
+        return DYNWRAPX_OPTION_GROWRETRY;
+    return 0;
+}
+
+// SetOption method implementation - SetOption(name[, value]) sets an
+// object-wide option and returns its previous state
+HRESULT DynWrap_SetOption(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    // Validate parameters (minimum 1: option name)
+    if (pDispParams->cArgs < 1)
+        return DISP_E_BADPARAMCOUNT;
+    
+    VARIANT* pNameArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    if (V_VT(pNameArg) != VT_BSTR || !V_BSTR(pNameArg))
+        return E_INVALIDARG;
+    
+    DWORD flag = GetOptionFlag(V_BSTR(pNameArg));
+    if (!flag)
+        return E_INVALIDARG;
+    
+    EnterCriticalSection(&pObj->cs);
+    
+    BOOL previous = (pObj->options & flag) != 0;
+    
+    // Without a value the option is only queried
+    if (pDispParams->cArgs >= 2)
+    {
+        VARIANT vValue;
+        VariantInit(&vValue);
+        HRESULT hr = VariantChangeType(&vValue, &pDispParams->rgvarg[pDispParams->cArgs - 2], 0, VT_BOOL);
+        if (FAILED(hr))
         {
-            V_VT(pVarResult) = VT_I8;
-            V_I8(pVarResult) = (LONGLONG)ptrValue;
+            LeaveCriticalSection(&pObj->cs);
+            return hr;
         }
+        
+        if (V_BOOL(&vValue))
+            pObj->options |= flag;
         else
-        {
-            V_VT(pVarResult) = VT_UI4;
-            V_UI4(pVarResult) = (ULONG)ptrValue;
-        }
-#else
-        // On 32-bit, always use VT_UI4
-        V_VT(pVarResult) = VT_UI4;
-        V_UI4(pVarResult) = (ULONG)ptrValue;
-#endif
+            pObj->options &= ~flag;
+        DebugLog("DEBUG", "DynWrap_SetOption", "Option '%S' = %d", V_BSTR(pNameArg), V_BOOL(&vValue) ? 1 : 0);
+    }
+    
+    LeaveCriticalSection(&pObj->cs);
+    
+    if (pVarResult)
+    {
+        VariantInit(pVarResult);
+        V_VT(pVarResult) = VT_BOOL;
+        V_BOOL(pVarResult) = previous ? VARIANT_TRUE : VARIANT_FALSE;
+    }
+    
+    return S_OK;
+}
+
+// BeginScope method implementation - opens a scope that owns StrPtr results
+// until the matching EndScope; returns the new nesting depth
+HRESULT DynWrap_BeginScope(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    CallScope* pScope = (CallScope*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, sizeof(CallScope));
+    if (!pScope)
+        return E_OUTOFMEMORY;
+    
+    EnterCriticalSection(&pObj->cs);
+    pScope->parent = pObj->openScope;
+    pObj->openScope = pScope;
+    int depth = ++pObj->scopeDepth;
+    LeaveCriticalSection(&pObj->cs);
+    
+    if (pVarResult)
+    {
+        VariantInit(pVarResult);
+        V_VT(pVarResult) = VT_I4;
+        V_I4(pVarResult) = depth;
+    }
+    
+    return S_OK;
+}
+
+// EndScope method implementation - frees everything allocated in the
+// innermost scope; returns the remaining nesting depth
+HRESULT DynWrap_EndScope(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    EnterCriticalSection(&pObj->cs);
+    CallScope* pScope = pObj->openScope;
+    if (pScope)
+    {
+        pObj->openScope = pScope->parent;
+        pObj->scopeDepth--;
     }
+    int depth = pObj->scopeDepth;
+    LeaveCriticalSection(&pObj->cs);
+    
+    if (!pScope)
+        return E_UNEXPECTED;
     
-    if (type != TYPE_WSTRING)
+    FreeMemoryBlocks(pObj, pScope->blocks);
+    GlobalFree(pScope);
+    
+    if (pVarResult)
     {
-        SAFE_SYSFREE(inputStr);
+        VariantInit(pVarResult);
+        V_VT(pVarResult) = VT_I4;
+        V_I4(pVarResult) = depth;
     }
     
     return S_OK;
 }
 
-// StrGet method implementation
-HRESULT DynWrap_StrGet(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+// FlushTrace method implementation - FlushTrace([path]) appends the buffered
+// call events to a file and returns how many were written
+HRESULT DynWrap_FlushTrace(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
 {
-    HRESULT hr = S_OK;
-    void* address = NULL;
-    ParameterType type = TYPE_WSTRING;
-    
-    // Validate parameters (minimum 1: address)
-    if (pDispParams->cArgs < 1)
-        return DISP_E_BADPARAMCOUNT;
+    LPCWSTR path = NULL;
     
-    // Get address (parameter 0)
-    VARIANT* pAddrArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
-    if (V_VT(pAddrArg) == VT_BSTR)
+    if (pDispParams->cArgs >= 1)
     {
-        address = V_BSTR(pAddrArg);
+        VARIANT* pPathArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+        if (V_VT(pPathArg) == VT_BSTR)
+            path = V_BSTR(pPathArg);
+        else if (V_VT(pPathArg) != VT_EMPTY && V_VT(pPathArg) != VT_NULL && V_VT(pPathArg) != VT_ERROR)
+            return E_INVALIDARG;
     }
-    else
+    
+    LONG written = FlushTrace(pObj, path);
+    
+    if (written < 0)
+        return HRESULT_FROM_WIN32(ERROR_OPEN_FAILED);
+    
+    if (pVarResult)
     {
-        VARIANT vTemp;
-        VariantInit(&vTemp);
-        
-        // Handle both 32-bit and 64-bit addresses properly
-#ifdef _WIN64
-        // On 64-bit, try VT_I8 first, fallback to VT_UI4
-        hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_I8);
-        if (SUCCEEDED(hr))
-            address = (void*)(ULONG_PTR)V_I8(&vTemp);
-        else
-        {
-            hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_UI4);
-            if (SUCCEEDED(hr))
-                address = (void*)(ULONG_PTR)V_UI4(&vTemp);
-        }
-#else
-        // On 32-bit, use VT_UI4
-        hr = VariantChangeType(&vTemp, pAddrArg, 0, VT_UI4);
-        if (SUCCEEDED(hr))
-            address = (void*)(ULONG_PTR)V_UI4(&vTemp);
-#endif
-        
-        if (FAILED(hr))
-            return hr;
+        VariantInit(pVarResult);
+        V_VT(pVarResult) = VT_I4;
+        V_I4(pVarResult) = written;
     }
     
-    // Get type (parameter 1, optional)
-    if (pDispParams->cArgs >= 2)
+    return S_OK;
+}
+
+// Optional function name argument of Stats/ResetStats (NULL: all functions)
+static HRESULT GetStatsNameArg(DISPPARAMS* pDispParams, LPCWSTR* pName)
+{
+    *pName = NULL;
+    if (pDispParams->cArgs < 1)
+        return S_OK;
+    
+    VARIANT* pNameArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    if (V_VT(pNameArg) == VT_BSTR)
+        *pName = V_BSTR(pNameArg);
+    else if (V_VT(pNameArg) != VT_EMPTY && V_VT(pNameArg) != VT_NULL && V_VT(pNameArg) != VT_ERROR)
+        return E_INVALIDARG;
+    
+    return S_OK;
+}
+
+// Stats method implementation - Stats() returns one row per registered
+// function, Stats(name) the row of that function (see GetCallStatsRow)
+HRESULT DynWrap_Stats(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    LPCWSTR name;
+    HRESULT hr = GetStatsNameArg(pDispParams, &name);
+    if (FAILED(hr) || !pVarResult)
+        return hr;
+    
+    if (name)
     {
-        VARIANT* pTypeArg = &pDispParams->rgvarg[pDispParams->cArgs - 2];
-        if (V_VT(pTypeArg) == VT_BSTR && SysStringLen(V_BSTR(pTypeArg)) > 0)
-        {
-            WCHAR typeChar = V_BSTR(pTypeArg)[0];
-            if (typeChar == L'w')
-                type = TYPE_WSTRING;
-            else if (typeChar == L's')
-                type = TYPE_ASTRING;
-            else if (typeChar == L'z')
-                type = TYPE_OSTRING;
-        }
+        FunctionInfo* pFunc = FindFunctionByName(pObj, name);
+        if (!pFunc)
+            return DISP_E_UNKNOWNNAME;
+        return GetCallStatsRow(pFunc, pVarResult);
     }
     
-    BSTR resultStr = NULL;
+    int count = pObj->functionCount;
+    VARIANT* rows = (VARIANT*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, (count ? count : 1) * sizeof(VARIANT));
+    if (!rows)
+        return E_OUTOFMEMORY;
     
-    if (type == TYPE_WSTRING)
+    for (int i = 0; i < count && SUCCEEDED(hr); i++)
+        hr = GetCallStatsRow(FindFunctionById(pObj, DISPID_FUNCTION_BASE + i), &rows[i]);
+    
+    if (SUCCEEDED(hr))
     {
-        // Read Unicode string
-        WCHAR* pwszStr = (WCHAR*)address;
-        if (pwszStr)
-        {
-            resultStr = SysAllocString(pwszStr);
-        }
+        hr = CreateVariantArray(rows, count, pVarResult);
     }
-    else
+    if (FAILED(hr))
     {
-        // Read ANSI/OEM string and convert to Unicode
-        char* pszStr = (char*)address;
-        if (pszStr)
-        {
-            int len = strlen(pszStr);
-            resultStr = SysAllocStringLen(NULL, len);
-            if (resultStr)
-            {
-                UINT codePage = (type == TYPE_OSTRING) ? CP_OEMCP : CP_ACP;
-                MultiByteToWideChar(codePage, 0, pszStr, len, resultStr, len);
-            }
-        }
+        for (int i = 0; i < count; i++)
+            VariantClear(&rows[i]);
     }
     
-    // Return string
-    if (pVarResult)
+    GlobalFree(rows);
+    return hr;
+}
+
+// ResetStats method implementation - ResetStats([name]) zeroes the counters
+// of one function, or of every registered function
+HRESULT DynWrap_ResetStats(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    LPCWSTR name;
+    HRESULT hr = GetStatsNameArg(pDispParams, &name);
+    if (FAILED(hr))
+        return hr;
+    
+    if (name)
     {
-        VariantInit(pVarResult);
-        V_VT(pVarResult) = VT_BSTR;
-        V_BSTR(pVarResult) = resultStr ? resultStr : SysAllocString(L"");
+        FunctionInfo* pFunc = FindFunctionByName(pObj, name);
+        if (!pFunc)
+            return DISP_E_UNKNOWNNAME;
+        ResetCallStats(pFunc);
     }
-    else if (resultStr)
+    else
     {
-        SysFreeString(resultStr);
+        LONG count = pObj->functionCount;
+        for (int i = 0; i < count; i++)
+            ResetCallStats(FindFunctionById(pObj, DISPID_FUNCTION_BASE + i));
     }
     
     return S_OK;
 }
 
-// Space method implementation
-HRESULT DynWrap_Space(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+// RegisterCollector(signature, maxItems[, returnValue]) - native callback
+// that stores its arguments instead of calling script. signature is
+// "r=params" as in Register; returnValue (default 1) is returned to the
+// caller for each stored row, 0 once maxItems rows are held.
+HRESULT DynWrap_RegisterCollector(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
 {
-    HRESULT hr = S_OK;
-    UINT count = 0;
-    WCHAR fillChar = L' ';
+    HRESULT hr;
+    VARIANT vTemp;
+    LONGLONG returnValue = 1;
+    LONG maxItems;
     
-    // Validate parameters (minimum 1: count)
-    if (pDispParams->cArgs < 1)
+    if (pDispParams->cArgs < 2)
         return DISP_E_BADPARAMCOUNT;
     
-    // Get count (parameter 0)
-    VARIANT* pCountArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
-    VARIANT vTemp;
+    VARIANT* pSignatureArg = &pDispParams->rgvarg[pDispParams->cArgs - 1];
+    if (V_VT(pSignatureArg) != VT_BSTR || !V_BSTR(pSignatureArg))
+        return E_INVALIDARG;
+    LPCWSTR signature = V_BSTR(pSignatureArg);
+    
     VariantInit(&vTemp);
-    hr = VariantChangeType(&vTemp, pCountArg, 0, VT_UI4);
+    hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 2], 0, VT_I4);
+    if (FAILED(hr))
+        return hr;
+    maxItems = V_I4(&vTemp);
+    if (maxItems <= 0)
+        return E_INVALIDARG;
+    
+    CallbackInfo* pInfo = (CallbackInfo*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, sizeof(CallbackInfo));
+    if (!pInfo)
+        return E_OUTOFMEMORY;
+    pInfo->owner = pObj;
+    pInfo->returnType = TYPE_LONG;
+    
+    hr = ParseParameterString(signature, &pInfo->paramTypes, &pInfo->paramCount);
+    if (SUCCEEDED(hr) && signature[0] != L'=')
+        pInfo->returnType = ParseParameterType(signature[0]);
+    
+    // Return value (parameter 2, optional), stored in the native return type
+    if (SUCCEEDED(hr) && pDispParams->cArgs >= 3)
+        hr = ConvertVariantToType(&pDispParams->rgvarg[pDispParams->cArgs - 3], pInfo->returnType, &returnValue, pObj, NULL);
+    
+    if (SUCCEEDED(hr))
+        hr = CreateCollector(pInfo, maxItems, returnValue);
+    if (SUCCEEDED(hr))
+        hr = PublishCallback(pObj, pInfo, pVarResult);
+    
+    if (FAILED(hr))
+        FreeCallbackInfo(pInfo);
+    return hr;
+}
+
+// Collected(pointer[, reset = true]) - rows stored by a collector
+HRESULT DynWrap_Collected(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    void* thunk = NULL;
+    BOOL reset = TRUE;
+    HRESULT hr;
+    
+    if (pDispParams->cArgs < 1)
+        return DISP_E_BADPARAMCOUNT;
+    
+    hr = ConvertVariantToType(&pDispParams->rgvarg[pDispParams->cArgs - 1], TYPE_POINTER, &thunk, pObj, NULL);
     if (FAILED(hr))
         return hr;
-    count = V_UI4(&vTemp);
     
-    // Get fill character (parameter 1, optional)
     if (pDispParams->cArgs >= 2)
     {
-        VARIANT* pCharArg = &pDispParams->rgvarg[pDispParams->cArgs - 2];
-        if (V_VT(pCharArg) == VT_BSTR)
-        {
-            BSTR charStr = V_BSTR(pCharArg);
-            if (SysStringLen(charStr) > 0)
-            {
-                fillChar = charStr[0];
-            }
-            else
-            {
-                fillChar = L'\0'; // Empty string means null character
-            }
-        }
-        else if (V_VT(pCharArg) != VT_EMPTY && V_VT(pCharArg) != VT_NULL)
-        {
-            VARIANT vCharTemp;
-            VariantInit(&vCharTemp);
-            hr = VariantChangeType(&vCharTemp, pCharArg, 0, VT_BSTR);
-            if (SUCCEEDED(hr) && SysStringLen(V_BSTR(&vCharTemp)) > 0)
-            {
-                fillChar = V_BSTR(&vCharTemp)[0];
-            }
-            VariantClear(&vCharTemp);
-        }
+        VARIANT vTemp;
+        VariantInit(&vTemp);
+        hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 2], 0, VT_BOOL);
+        if (FAILED(hr))
+            return hr;
+        reset = V_BOOL(&vTemp) != VARIANT_FALSE;
     }
     
-    // Create string
-    BSTR resultStr = SysAllocStringLen(NULL, count);
-    if (!resultStr)
-        return E_OUTOFMEMORY;
+    CallbackInfo* pInfo = FindCallback(pObj, thunk);
+    if (!pInfo || !pInfo->collector)
+        return E_INVALIDARG;
     
-    // Fill with character
-    for (UINT i = 0; i < count; i++)
+    if (!pVarResult)
+        return S_OK;
+    return GetCollectedRows(pInfo, reset, pVarResult);
+}
+
+// RegisterAsyncCallback(function[, "r=params"[, returnType[, defaultReturn[, maxQueued]]]])
+// - like RegisterCallback, but calls made on other threads are queued for
+// PumpCallbacks and return defaultReturn (0 if omitted) immediately. At most
+// maxQueued calls (DYNWRAPX_ASYNC_MAX_QUEUED if omitted, no limit if 0 or
+// less) wait in the queue; further calls are dropped. Calls on the
+// registering thread still run synchronously.
+HRESULT DynWrap_RegisterAsyncCallback(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    CallbackInfo* pInfo = NULL;
+    HRESULT hr = CreateScriptCallback(pObj, pDispParams, &pInfo);
+    if (FAILED(hr))
+        return hr;
+    
+    pInfo->async = TRUE;
+    pInfo->threadId = GetCurrentThreadId();
+    pInfo->maxQueued = DYNWRAPX_ASYNC_MAX_QUEUED;
+    if (pDispParams->cArgs >= 4)
+        hr = ConvertVariantToType(&pDispParams->rgvarg[pDispParams->cArgs - 4], pInfo->returnType, &pInfo->asyncReturn, pObj, NULL);
+    if (SUCCEEDED(hr) && pDispParams->cArgs >= 5)
     {
-        resultStr[i] = fillChar;
+        VARIANT vTemp;
+        VariantInit(&vTemp);
+        hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 5], 0, VT_I4);
+        if (SUCCEEDED(hr))
+            pInfo->maxQueued = V_I4(&vTemp) > 0 ? V_I4(&vTemp) : 0;
     }
     
-    // Return string
-    if (pVarResult)
+    if (SUCCEEDED(hr))
     {
-        VariantInit(pVarResult);
-        V_VT(pVarResult) = VT_BSTR;
-        V_BSTR(pVarResult) = resultStr;
+        EnterCriticalSection(&pObj->cs);
+        if (!pObj->asyncEvent)
+            pObj->asyncEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+        if (!pObj->asyncEvent)
+            hr = HRESULT_FROM_WIN32(GetLastError());
+        LeaveCriticalSection(&pObj->cs);
     }
-    else
+    
+    if (SUCCEEDED(hr))
+        hr = PublishCallback(pObj, pInfo, pVarResult);
+    if (FAILED(hr))
+        FreeCallbackInfo(pInfo);
+    return hr;
+}
+
+// PumpCallbacks([timeoutMs = 0]) - run queued asynchronous callbacks on the
+// calling thread; returns the number delivered
+HRESULT DynWrap_PumpCallbacks(DynamicWrapperX* pObj, DISPPARAMS* pDispParams, VARIANT* pVarResult)
+{
+    DWORD timeout = 0;
+    
+    if (pDispParams->cArgs >= 1)
     {
-        SysFreeString(resultStr);
+        VARIANT vTemp;
+        VariantInit(&vTemp);
+        HRESULT hr = VariantChangeType(&vTemp, &pDispParams->rgvarg[pDispParams->cArgs - 1], 0, VT_I4);
+        if (FAILED(hr))
+            return hr;
+        timeout = V_I4(&vTemp) < 0 ? INFINITE : (DWORD)V_I4(&vTemp);
     }
     
+    LONG delivered = PumpAsyncCalls(pObj, timeout);
+    
+    if (pVarResult)
+    {
+        VariantInit(pVarResult);
+        V_VT(pVarResult) = VT_I4;
+        V_I4(pVarResult) = delivered;
+    }
     return S_OK;
 }
 
 // Callback implementation helper
-HRESULT CallScriptFunction(DynamicWrapperX* pObj, int callbackIndex, void** args, void* returnValue)
+// Fill one callback argument. The common integer types are stored in place;
+// everything else goes through ConvertTypeToVariant.
+HRESULT SetCallbackArgument(const LONG_PTR* pSlot, ParameterType type, VARIANT* pVar)
 {
-    if (callbackIndex < 0 || callbackIndex >= 16)
-        return E_INVALIDARG;
+    switch (type)
+    {
+    case TYPE_LONG:
+        V_VT(pVar) = VT_I4;
+        V_I4(pVar) = *(const LONG*)pSlot;
+        return S_OK;
+    
+    case TYPE_ULONG:
+        V_VT(pVar) = VT_UI4;
+        V_UI4(pVar) = *(const ULONG*)pSlot;
+        return S_OK;
+    
+    case TYPE_HANDLE:
+    case TYPE_POINTER:
+#ifdef _WIN64
+        if ((ULONG_PTR)*pSlot > 0xFFFFFFFF)
+        {
+            V_VT(pVar) = VT_I8;
+            V_I8(pVar) = (LONGLONG)*pSlot;
+            return S_OK;
+        }
+#endif
+        V_VT(pVar) = VT_UI4;
+        V_UI4(pVar) = (ULONG)*pSlot;
+        return S_OK;
     
-    CallbackInfo* pInfo = &pObj->callbacks[callbackIndex];
+    default:
+        return ConvertTypeToVariant((void*)pSlot, type, pVar);
+    }
+}
+
+// Call the script function of a callback. argSlots holds the native
+// arguments as laid out by the caller (see InvokeCallback). The arguments
+// go into the callback's preallocated frame; a reentrant or concurrent
+// invocation that finds the frame busy builds its own in the thread arena.
+HRESULT CallScriptFunction(CallbackInfo* pInfo, const LONG_PTR* argSlots, void* returnValue)
+{
     if (!pInfo->scriptFunction)
         return E_FAIL;
     
@@ -1242,20 +2495,39 @@ HRESULT CallScriptFunction(DynamicWrapperX* pObj, int callbackIndex, void** args
     DISPPARAMS dispParams = {0};
     VARIANT varResult;
     VARIANT* pArgs = NULL;
+    BOOL ownsFrame = FALSE;
+    BOOL argsOnHeap = FALSE;
+    SIZE_T arenaMark = 0;
     
     VariantInit(&varResult);
     
-    // Prepare arguments
-    if (pInfo->paramCount > 0 && args)
+    if (pInfo->paramCount > 0 && argSlots)
     {
-        pArgs = (VARIANT*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, pInfo->paramCount * sizeof(VARIANT));
-        if (!pArgs)
-            return E_OUTOFMEMORY;
+        if (InterlockedExchange(&pInfo->frameBusy, 1) == 0)
+        {
+            pArgs = pInfo->frame;
+            ownsFrame = TRUE;
+        }
+        else
+        {
+            arenaMark = ArenaMark();
+            pArgs = (VARIANT*)ArenaAlloc(pInfo->paramCount * sizeof(VARIANT));
+            if (!pArgs)
+            {
+                pArgs = (VARIANT*)GlobalAlloc(GMEM_FIXED, pInfo->paramCount * sizeof(VARIANT));
+                if (!pArgs)
+                    return E_OUTOFMEMORY;
+                argsOnHeap = TRUE;
+            }
+            for (int i = 0; i < pInfo->paramCount; i++)
+                VariantInit(&pArgs[i]);
+        }
         
+        // IDispatch::Invoke takes the arguments in reverse order
         for (int i = 0; i < pInfo->paramCount; i++)
         {
-            VariantInit(&pArgs[i]);
-            hr = ConvertTypeToVariant(args[i], pInfo->paramTypes[i], &pArgs[i]);
+            hr = SetCallbackArgument(&argSlots[pInfo->slotIndex[i]], pInfo->paramTypes[i],
+                                     &pArgs[pInfo->paramCount - 1 - i]);
             if (FAILED(hr))
                 goto cleanup;
         }
@@ -1280,59 +2552,56 @@ HRESULT CallScriptFunction(DynamicWrapperX* pObj, int callbackIndex, void** args
     // Convert return value
     if (SUCCEEDED(hr) && returnValue)
     {
-        hr = ConvertVariantToType(&varResult, pInfo->returnType, returnValue, pObj);
+        hr = ConvertVariantToType(&varResult, pInfo->returnType, returnValue, pInfo->owner, NULL);
     }
     
 cleanup:
     if (pArgs)
     {
-        for (int i = 0; i < pInfo->paramCount; i++)
+        // Integer entries hold no resources and are simply overwritten next time
+        if (pInfo->frameHasStrings || !ownsFrame)
         {
-            VariantClear(&pArgs[i]);
+            for (int i = 0; i < pInfo->paramCount; i++)
+                VariantClear(&pArgs[i]);
         }
-        GlobalFree(pArgs);
+        if (ownsFrame)
+            InterlockedExchange(&pInfo->frameBusy, 0);
+        else if (argsOnHeap)
+            GlobalFree(pArgs);
+        else
+            ArenaReset(arenaMark);
     }
     
     VariantClear(&varResult);
     return hr;
 }
 
-// Generic callback stub implementation
-static LRESULT CALLBACK GenericCallbackStub(int callbackIndex, LPARAM lParam1, LPARAM lParam2, LPARAM lParam3, LPARAM lParam4)
+// Entry point of every generated callback thunk. On x64 argSlots points at
+// the register arguments spilled to the shadow area, followed by the stack
+// arguments; on x86 it points at the stack arguments. The thunk returns
+// *result in the native return register for the callback's return type.
+void __cdecl InvokeCallback(CallbackInfo* pInfo, const LONG_PTR* argSlots, LONGLONG* result)
 {
-    DynamicWrapperX* pObj = g_callbackObjects[callbackIndex];
-    if (!pObj)
-        return 0;
-    
-    // Prepare arguments - this is simplified, real implementation would need
-    // to properly handle the actual parameters based on the calling convention
-    void* args[4];
-    args[0] = &lParam1;
-    args[1] = &lParam2;
-    args[2] = &lParam3;
-    args[3] = &lParam4;
-    
-    LRESULT result = 0;
-    CallScriptFunction(pObj, callbackIndex, args, &result);
-    
-    return result;
+    // Counted so that FreeCallback refuses to free a callback in use
+    InterlockedIncrement(&pInfo->activeCalls);
+    
+    if (pInfo->collector)
+    {
+        CollectArguments(pInfo, argSlots, result);
+    }
+    else if (pInfo->async && GetCurrentThreadId() != pInfo->threadId)
+    {
+        QueueAsyncCall(pInfo, argSlots);
+        *result = pInfo->asyncReturn;
+    }
+    else
+    {
+        *result = 0;
+        
+        HRESULT hr = CallScriptFunction(pInfo, argSlots, result);
+        if (FAILED(hr))
+            DebugLog("ERROR", "InvokeCallback", "Callback 0x%p failed, hr=0x%08x", pInfo->thunk, hr);
+    }
+    
+    InterlockedDecrement(&pInfo->activeCalls);
 }
-
-// Callback stubs - these would normally be implemented in assembly
-// for proper parameter handling, but simplified here
-LRESULT CALLBACK CallbackStub0(void) { return GenericCallbackStub(0, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub1(void) { return GenericCallbackStub(1, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub2(void) { return GenericCallbackStub(2, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub3(void) { return GenericCallbackStub(3, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub4(void) { return GenericCallbackStub(4, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub5(void) { return GenericCallbackStub(5, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub6(void) { return GenericCallbackStub(6, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub7(void) { return GenericCallbackStub(7, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub8(void) { return GenericCallbackStub(8, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub9(void) { return GenericCallbackStub(9, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub10(void) { return GenericCallbackStub(10, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub11(void) { return GenericCallbackStub(11, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub12(void) { return GenericCallbackStub(12, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub13(void) { return GenericCallbackStub(13, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub14(void) { return GenericCallbackStub(14, 0, 0, 0, 0); }
-LRESULT CALLBACK CallbackStub15(void) { return GenericCallbackStub(15, 0, 0, 0, 0); }
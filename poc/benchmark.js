@@ -0,0 +1,594 @@
+// DynamicWrapperX micro-benchmarks (JScript)
+// Run with: cscript //nologo benchmark.js
+
+var DX = new ActiveXObject("DynamicWrapperX");
+
+// Run fn() for the given number of iterations and report the cost per call
+function bench(name, iterations, fn) {
+    var start = new Date().getTime();
+    for (var i = 0; i < iterations; i++) {
+        fn(i);
+    }
+    var elapsed = new Date().getTime() - start;
+    var perCall = elapsed > 0 ? (elapsed * 1000000 / iterations) : 0;
+    var perSecond = elapsed > 0 ? Math.round(iterations * 1000 / elapsed) : iterations * 1000;
+    WScript.Echo(name + ": " + iterations + " calls in " + elapsed + " ms (" +
+                 Math.round(perCall) + " ns/call, " + perSecond + " calls/s)");
+    return elapsed;
+}
+
+// Read a NUL-terminated ANSI name byte by byte (no pointer arithmetic needed in JScript)
+function readAnsiName(base, offset) {
+    var name = "";
+    for (var c = DX.NumGet(base, offset, "b"); c !== 0; c = DX.NumGet(base, ++offset, "b")) {
+        name += String.fromCharCode(c);
+    }
+    return name;
+}
+
+// Collect up to maxCount export names from a loaded module by walking its PE export directory
+function getExportNames(moduleName, maxCount) {
+    DX.Register("kernel32.dll", "GetModuleHandleW", "p=w");
+    var base = DX.GetModuleHandleW(moduleName);
+    var peOffset = DX.NumGet(base, 0x3C, "l");
+    var magic = DX.NumGet(base, peOffset + 24, "t");
+    var exportDirRva = DX.NumGet(base, peOffset + 24 + (magic == 0x20B ? 112 : 96), "u");
+    var nameCount = DX.NumGet(base, exportDirRva + 24, "u");
+    var namesRva = DX.NumGet(base, exportDirRva + 32, "u");
+    var names = [];
+    for (var i = 0; i < nameCount && names.length < maxCount; i++) {
+        names.push(readAnsiName(base, DX.NumGet(base, namesRva + i * 4, "u")));
+    }
+    return names;
+}
+
+WScript.Echo("=== DynamicWrapperX Benchmarks ===\n");
+
+// --- Dispatch table: register 1,000 functions and measure per-call cost ---
+WScript.Echo("--- Dispatch with 1,000 registered functions ---");
+DX.Register("kernel32.dll", "GetTickCount", "u=");
+var names = getExportNames("kernel32.dll", 1000);
+var registered = 0;
+bench("Register", names.length, function(i) {
+    try {
+        DX.Register("kernel32.dll", names[i], "u=");
+        registered++;
+    } catch (e) {
+        // Data exports and forwarders that fail to resolve are skipped
+    }
+});
+WScript.Echo("Registered " + registered + " functions");
+
+DX.Register("kernel32.dll", "GetCurrentProcessId", "u=");
+bench("GetCurrentProcessId (last registered)", 200000, function() {
+    DX.GetCurrentProcessId();
+});
+bench("GetTickCount (registered early)", 200000, function() {
+    DX.GetTickCount();
+});
+
+// --- Argument marshaling: integer calls must not touch the heap ---
+WScript.Echo("\n--- Allocation-free argument marshaling ---");
+DX.Register("kernel32.dll", "MulDiv", "l=lll");
+var allocsBefore = DX.Counter("CallAllocs");
+bench("MulDiv (3 integer args)", 200000, function(i) {
+    DX.MulDiv(i, 3, 2);
+});
+var hotAllocs = DX.Counter("CallAllocs") - allocsBefore;
+WScript.Echo("Heap allocations during hot calls: " + hotAllocs + (hotAllocs === 0 ? " [PASS]" : " [FAIL]"));
+
+// --- Floating-point arguments and returns (msvcrt numeric kernels) ---
+WScript.Echo("\n--- Floating-point round trips ---");
+DX.Register("msvcrt.dll", "pow", "d=dd");
+DX.Register("msvcrt.dll", "sqrt", "d=d");
+DX.Register("msvcrt.dll", "atan2", "d=dd");
+var powResult = DX.pow(2.5, 3);
+var sqrtResult = DX.sqrt(2);
+var atanResult = DX.atan2(1, 1);
+WScript.Echo("pow(2.5, 3) = " + powResult + (powResult === 15.625 ? " [PASS]" : " [FAIL]"));
+WScript.Echo("sqrt(2) = " + sqrtResult + (Math.abs(sqrtResult - Math.SQRT2) < 1e-15 ? " [PASS]" : " [FAIL]"));
+WScript.Echo("atan2(1, 1) = " + atanResult + (Math.abs(atanResult - Math.PI / 4) < 1e-15 ? " [PASS]" : " [FAIL]"));
+bench("pow (d=dd)", 200000, function(i) {
+    DX.pow(i, 0.5);
+});
+bench("sqrt (d=d)", 200000, function(i) {
+    DX.sqrt(i);
+});
+
+// --- Module cache: every Register against a loaded module is a cache hit ---
+WScript.Echo("\n--- Module handle cache ---");
+var missesBefore = DX.Counter("ModuleMisses");
+var hitsBefore = DX.Counter("ModuleHits");
+bench("Register (kernel32, cached module)", 200, function() {
+    DX.Register("KERNEL32", "GetTickCount", "u=");
+});
+var newMisses = DX.Counter("ModuleMisses") - missesBefore;
+var newHits = DX.Counter("ModuleHits") - hitsBefore;
+WScript.Echo("Module cache hits: " + newHits + ", misses: " + newMisses +
+             (newMisses === 0 && newHits === 200 ? " [PASS]" : " [FAIL]"));
+
+// --- Batch registration: one RegisterMany call versus one Register per function ---
+WScript.Echo("\n--- Batch registration (RegisterMany) ---");
+var manifestLines = [];
+for (var m = 0; m < names.length; m++) {
+    manifestLines.push("kernel32.dll|" + names[m] + "|r=u");
+}
+var manifest = manifestLines.join("\n");
+var statuses = null;
+bench("RegisterMany (" + names.length + " entries)", 1, function() {
+    statuses = new VBArray(DX.RegisterMany(manifest)).toArray();
+});
+var batchOk = 0;
+for (var k = 0; k < statuses.length; k++) {
+    if (statuses[k] === 0) batchOk++;
+}
+WScript.Echo("Registered " + batchOk + " of " + statuses.length + " entries" +
+             (batchOk === registered ? " [PASS]" : " [FAIL]"));
+var batchStatus = new VBArray(DX.RegisterMany("user32|GetDesktopWindow|r=h\nuser32|NoSuchExport|r=l")).toArray();
+WScript.Echo("Per-entry status: " + batchStatus.join(", ") +
+             (batchStatus[0] === 0 && batchStatus[1] !== 0 ? " [PASS]" : " [FAIL]"));
+
+// --- Lazy resolution: Register defers GetProcAddress to the first call ---
+WScript.Echo("\n--- Lazy symbol resolution ---");
+var LX = new ActiveXObject("DynamicWrapperX");
+LX.SetOption("Lazy", true);
+bench("RegisterMany lazy (" + names.length + " entries)", 1, function() {
+    LX.RegisterMany(manifest);
+});
+WScript.Echo("Resolved after registration: " + LX.Counter("LazyResolves") +
+             (LX.Counter("LazyResolves") === 0 ? " [PASS]" : " [FAIL]"));
+LX.Register("kernel32.dll", "GetTickCount", "u=");
+LX.GetTickCount();
+LX.GetTickCount();
+WScript.Echo("Resolved after two calls: " + LX.Counter("LazyResolves") +
+             (LX.Counter("LazyResolves") === 1 ? " [PASS]" : " [FAIL]"));
+LX.Register("kernel32.dll", "NoSuchExport", "l=");
+var lazyError = "";
+try {
+    LX.NoSuchExport();
+} catch (e) {
+    lazyError = (e.number >>> 0).toString(16);
+}
+WScript.Echo("Unresolved symbol reported at call time: 0x" + lazyError +
+             (lazyError === "8007007f" ? " [PASS]" : " [FAIL]"));
+
+// --- Scoped string lifetimes: converted strings must not accumulate ---
+WScript.Echo("\n--- Scoped string lifetimes ---");
+DX.Register("kernel32.dll", "lstrlenA", "l=s");
+var liveBefore = DX.Counter("LiveBytes");
+bench("lstrlenA (s param)", 100000, function() {
+    DX.lstrlenA("temporary ANSI string");
+});
+var callGrowth = DX.Counter("LiveBytes") - liveBefore;
+WScript.Echo("Live bytes after calls: +" + callGrowth + (callGrowth === 0 ? " [PASS]" : " [FAIL]"));
+DX.BeginScope();
+for (var sp = 0; sp < 1000; sp++) {
+    DX.StrPtr("scoped string", "s");
+}
+var scopedBytes = DX.Counter("LiveBytes") - liveBefore;
+DX.EndScope();
+var afterScope = DX.Counter("LiveBytes") - liveBefore;
+WScript.Echo("StrPtr inside scope: " + scopedBytes + " bytes, after EndScope: " + afterScope +
+             (scopedBytes > 0 && afterScope === 0 ? " [PASS]" : " [FAIL]"));
+
+// --- Per-thread arena: string-heavy signatures without heap traffic ---
+// Compare calls/s against a build before the arena change to see the gain.
+WScript.Echo("\n--- Arena-backed string temporaries ---");
+DX.Register("kernel32.dll", "lstrlenW", "l=w");
+DX.Register("kernel32.dll", "lstrcmpA", "l=ss");
+DX.Register("kernel32.dll", "lstrcmpiW", "l=ww");
+var shortText = "The quick brown fox jumps over the lazy dog";
+allocsBefore = DX.Counter("CallAllocs");
+bench("lstrlenW (w)", 200000, function() {
+    DX.lstrlenW(shortText);
+});
+bench("lstrcmpA (ss)", 200000, function() {
+    DX.lstrcmpA(shortText, "The quick brown fox");
+});
+bench("lstrcmpiW (ww)", 200000, function() {
+    DX.lstrcmpiW(shortText, "THE QUICK BROWN FOX");
+});
+var stringAllocs = DX.Counter("CallAllocs") - allocsBefore;
+WScript.Echo("Heap allocations for string temporaries: " + stringAllocs + (stringAllocs === 0 ? " [PASS]" : " [FAIL]"));
+var longText = new Array(65537).join("x");
+var longLength = DX.lstrlenW(longText);
+WScript.Echo("Oversized string falls back to the heap: length " + longLength +
+             (longLength === 65536 ? " [PASS]" : " [FAIL]"));
+
+// --- Call tracing: runtime toggle, per-thread rings, on-demand flush ---
+WScript.Echo("\n--- Call tracing ---");
+var fso = new ActiveXObject("Scripting.FileSystemObject");
+var tracePath = fso.BuildPath(fso.GetSpecialFolder(2), "dynwrapx-bench-trace.log");
+if (fso.FileExists(tracePath)) fso.DeleteFile(tracePath);
+DX.FlushTrace(tracePath); // Drop anything recorded earlier
+bench("MulDiv, tracing off", 200000, function(i) {
+    DX.MulDiv(i, 3, 2);
+});
+DX.SetOption("Trace", true);
+bench("MulDiv, tracing on", 200000, function(i) {
+    DX.MulDiv(i, 3, 2);
+});
+DX.SetOption("Trace", false);
+var traced = DX.FlushTrace(tracePath);
+WScript.Echo("Flushed " + traced + " events to " + tracePath +
+             (traced === 4096 ? " [PASS]" : " [FAIL]") + " (ring keeps the last 4096 per thread)");
+
+// --- Per-function statistics ---
+WScript.Echo("\n--- Per-function call statistics ---");
+DX.ResetStats();
+bench("MulDiv, stats on", 200000, function(i) {
+    DX.MulDiv(i, 3, 2);
+});
+DX.SetOption("Stats", false);
+bench("MulDiv, stats off", 200000, function(i) {
+    DX.MulDiv(i, 3, 2);
+});
+DX.SetOption("Stats", true);
+var row = new VBArray(DX.Stats("MulDiv")).toArray();
+WScript.Echo(row[0] + ": " + row[1] + " calls, " + row[2] + " failures, total " + Math.round(row[3]) +
+             " us (convert " + Math.round(row[6]) + ", native " + Math.round(row[7]) + ", result " + Math.round(row[8]) +
+             "), min " + row[4].toFixed(3) + " us, max " + row[5].toFixed(3) + " us" +
+             (row[1] === 200000 ? " [PASS]" : " [FAIL]"));
+var histogram = new VBArray(row[9]).toArray();
+var histogramText = [];
+for (var b = 0; b < histogram.length; b++) {
+    if (histogram[b] > 0) histogramText.push("2^" + b + "ns:" + histogram[b]);
+}
+WScript.Echo("Latency histogram: " + histogramText.join(" "));
+var allRows = new VBArray(DX.Stats()).toArray();
+WScript.Echo("Stats() rows: " + allRows.length);
+DX.ResetStats("MulDiv");
+WScript.Echo("After ResetStats: " + new VBArray(DX.Stats("MulDiv")).toArray()[1] + " calls");
+
+// --- Generated callback thunks ---
+WScript.Echo("\n--- Callbacks (EnumWindows) ---");
+DX.Register("user32.dll", "EnumWindows", "l=pl");
+var windowCount = 0, badArgs = 0;
+var enumProc = DX.RegisterCallback(function(hwnd, lParam) {
+    windowCount++;
+    if (!hwnd || lParam !== 12345) badArgs++;
+    return 1;
+}, "l=hl", "l");
+var rounds = 50;
+var enumStart = new Date().getTime();
+for (var r = 0; r < rounds; r++) {
+    DX.EnumWindows(enumProc, 12345);
+}
+var enumElapsed = new Date().getTime() - enumStart;
+WScript.Echo("EnumWindows x" + rounds + ": " + windowCount + " callbacks in " + enumElapsed + " ms (" +
+             (windowCount > 0 ? Math.round(enumElapsed * 1000000 / windowCount) : 0) + " ns/callback)" +
+             (windowCount > 0 && badArgs === 0 ? " [PASS]" : " [FAIL]"));
+// More callbacks than the old 16 static stubs, each bound to its own function
+var callbacks = [];
+for (var c = 0; c < 64; c++) {
+    callbacks.push(DX.RegisterCallback((function(n) {
+        return function(hwnd, lParam) { return n === 63 ? 0 : 1; };
+    })(c), "l=hl", "l"));
+}
+WScript.Echo("Registered " + callbacks.length + " callbacks; last one stops enumeration: " +
+             (DX.EnumWindows(callbacks[63], 0) === 0 ? "[PASS]" : "[FAIL]"));
+// Callbacks created per operation: a freed entry point is handed out again
+var reused = 0, lastFreed = 0;
+bench("RegisterCallback + EnumWindows + FreeCallback", 200, function(i) {
+    var once = DX.RegisterCallback(function(hwnd, lParam) { return 0; }, "l=hl", "l");
+    DX.EnumWindows(once, 0);
+    DX.FreeCallback(once);
+    if (once === lastFreed) reused++;
+    lastFreed = once;
+});
+var freeBusy = false;
+var selfFree = DX.RegisterCallback(function(hwnd, lParam) {
+    try { DX.FreeCallback(selfFree); } catch (e) { freeBusy = true; }
+    return 0;
+}, "l=hl", "l");
+DX.EnumWindows(selfFree, 0);
+DX.FreeCallback(selfFree);
+WScript.Echo("Freed entry points reused, running callback not freed: " +
+             (reused > 0 && freeBusy ? "[PASS]" : "[FAIL]"));
+
+// --- Callback invocation frames ---
+WScript.Echo("\n--- Callback throughput ---");
+var hits = 0;
+var countProc = DX.RegisterCallback(function(hwnd, lParam) { hits++; return 1; }, "l=hl", "l");
+var throughputStart = new Date().getTime();
+for (var r = 0; r < 200; r++) {
+    DX.EnumWindows(countProc, 0);
+}
+var throughputElapsed = new Date().getTime() - throughputStart;
+WScript.Echo("Reused frame: " + hits + " callbacks in " + throughputElapsed + " ms (" +
+             (throughputElapsed > 0 ? Math.round(hits * 1000 / throughputElapsed) : hits * 1000) + " callbacks/s)");
+// A callback that re-enters itself finds its frame busy and uses the arena
+var depth = 0, nestedHits = 0, nestedBad = 0;
+var nestedProc = DX.RegisterCallback(function(hwnd, lParam) {
+    nestedHits++;
+    if (lParam !== depth) nestedBad++;
+    if (depth === 0) {
+        depth = 1;
+        DX.EnumWindows(nestedProc, 1);
+        depth = 0;
+    }
+    return depth === 0 ? 0 : 1;
+}, "l=hl", "l");
+DX.EnumWindows(nestedProc, 0);
+WScript.Echo("Nested invocation: " + nestedHits + " callbacks" + (nestedHits > 1 && nestedBad === 0 ? " [PASS]" : " [FAIL]"));
+
+// --- Collector callbacks ---
+WScript.Echo("\n--- Collector callbacks (no script re-entry) ---");
+var collector = DX.RegisterCollector("l=hl", 100000);
+var collectStart = new Date().getTime();
+var collectedTotal = 0, handles;
+for (var r = 0; r < 200; r++) {
+    DX.EnumWindows(collector, 0);
+    handles = new VBArray(DX.Collected(collector)).toArray();
+    collectedTotal += handles.length;
+}
+var collectElapsed = new Date().getTime() - collectStart;
+WScript.Echo("Collector: " + collectedTotal + " rows in " + collectElapsed + " ms (" +
+             (collectElapsed > 0 ? Math.round(collectedTotal * 1000 / collectElapsed) : collectedTotal * 1000) + " rows/s)" +
+             (handles.length > 0 && new VBArray(handles[0]).toArray()[0] ? " [PASS]" : " [FAIL]"));
+var firstThree = DX.RegisterCollector("l=h", 3);
+DX.EnumWindows(firstThree, 0);
+WScript.Echo("maxItems 3 stops the enumeration: " +
+             (new VBArray(DX.Collected(firstThree)).toArray().length === 3 ? "[PASS]" : "[FAIL]"));
+
+// --- Asynchronous callbacks ---
+WScript.Echo("\n--- Asynchronous callbacks (thread pool) ---");
+DX.Register("kernel32.dll", "QueueUserWorkItem", "l=ppu");
+var asyncSum = 0, asyncCount = 0;
+var workItem = DX.RegisterAsyncCallback(function(context) {
+    asyncCount++;
+    asyncSum += context;
+}, "u=p", "u", 0);
+var posted = 1000, expectedSum = 0;
+var asyncStart = new Date().getTime();
+for (var w = 1; w <= posted; w++) {
+    DX.QueueUserWorkItem(workItem, w, 0);
+    expectedSum += w;
+}
+var batches = 0;
+while (asyncCount < posted && new Date().getTime() - asyncStart < 10000) {
+    if (DX.PumpCallbacks(1000) > 0) batches++;
+}
+var asyncElapsed = new Date().getTime() - asyncStart;
+WScript.Echo("Delivered " + asyncCount + "/" + posted + " worker-thread callbacks in " + batches +
+             " batches, " + asyncElapsed + " ms" + (asyncCount === posted && asyncSum === expectedSum ? " [PASS]" : " [FAIL]"));
+// A bounded queue: calls beyond maxQueued are dropped until the script pumps
+var boundedCount = 0, droppedBefore = DX.Counter("AsyncDropped");
+var boundedItem = DX.RegisterAsyncCallback(function(context) { boundedCount++; }, "u=p", "u", 0, 10);
+for (var w = 0; w < 100; w++) {
+    DX.QueueUserWorkItem(boundedItem, w, 0);
+}
+var boundedStart = new Date().getTime();
+while (boundedCount + DX.Counter("AsyncDropped") - droppedBefore < 100 && new Date().getTime() - boundedStart < 10000) {
+    DX.PumpCallbacks(100);
+}
+var boundedDropped = DX.Counter("AsyncDropped") - droppedBefore;
+WScript.Echo("maxQueued 10: " + boundedCount + " delivered, " + boundedDropped + " dropped" +
+             (boundedCount + boundedDropped === 100 && boundedCount >= 10 ? " [PASS]" : " [FAIL]"));
+
+// --- Bulk memory reads ---
+WScript.Echo("\n--- NumGetArray vs NumGet ---");
+var blockPtr = DX.Space(512); // Strings are passed to NumGet/NumPut by buffer
+for (var k = 0; k < 256; k++) {
+    DX.NumPut(k * 3, blockPtr, k * 2, "t");
+}
+bench("256 x NumGet", 200, function(i) {
+    for (var k = 0; k < 256; k++) DX.NumGet(blockPtr, k * 2, "t");
+});
+bench("NumGetArray(256)", 200, function(i) {
+    new VBArray(DX.NumGetArray(blockPtr, 0, "t", 256)).toArray();
+});
+var words = new VBArray(DX.NumGetArray(blockPtr, 0, "t", 256)).toArray();
+var evens = new VBArray(DX.NumGetArray(blockPtr, 0, "t", 128, 4)).toArray();
+WScript.Echo("Contents match: " + (words[255] === 765 && evens[127] === 762 ? "[PASS]" : "[FAIL]"));
+
+// --- Bulk memory writes ---
+WScript.Echo("\n--- NumPutArray vs NumPut ---");
+var values = [];
+for (var k = 0; k < 256; k++) values.push(k * 5);
+bench("256 x NumPut", 200, function(i) {
+    for (var k = 0; k < 256; k++) DX.NumPut(values[k], blockPtr, k * 2, "t");
+});
+var endAddr;
+bench("NumPutArray(256)", 200, function(i) {
+    endAddr = DX.NumPutArray(values, blockPtr, 0, "t");
+});
+var readBack = new VBArray(DX.NumGetArray(blockPtr, 0, "t", 256)).toArray();
+var startAddr = DX.NumPutArray([], blockPtr); // Empty array: returns the start address
+WScript.Echo("Round trip: " + (readBack[200] === 1000 && endAddr - startAddr === 512 ? "[PASS]" : "[FAIL]"));
+DX.NumPut(0x12345678, blockPtr, 12, "l");     // Guard element after the written range
+DX.NumPutArray([1, 2, -1], blockPtr);          // Default type l: 4 bytes per element
+var longs = new VBArray(DX.NumGetArray(blockPtr, 0, "l", 3)).toArray();
+WScript.Echo("l round trip, next element unchanged: " +
+             (longs[0] === 1 && longs[1] === 2 && longs[2] === -1 &&
+              DX.NumGet(blockPtr, 12, "l") === 0x12345678 ? "[PASS]" : "[FAIL]"));
+
+// --- Struct layouts ---
+WScript.Echo("\n--- ReadStruct/WriteStruct vs NumGet/NumPut ---");
+var is64 = DX.DefineStruct("PTRSIZE", "p value") === 8;
+var entryAddr = DX.StrPtr(blockPtr, "w", true); // Borrowed: NumGet below reads blockPtr itself
+var entrySize = DX.DefineStruct("ENTRY", "u dwSize; u cntUsage; u th32ProcessID; p th32DefaultHeapID; " +
+                                         "n priority; d weight; w szName[32]");
+// Natural alignment: p at 16 on x64 (12 on x86), d at 8-byte boundary
+WScript.Echo("sizeof(ENTRY) = " + entrySize + (entrySize === (is64 ? 104 : 96) ? " [PASS]" : " [FAIL]"));
+DX.WriteStruct("ENTRY", entryAddr, {dwSize: entrySize, cntUsage: 1, th32ProcessID: 4242,
+                                   priority: -3, weight: 0.5, szName: "notepad.exe"});
+var nameOffset = entrySize - 64;
+bench("NumGet x 6 fields", 200, function(i) {
+    var e = {dwSize: DX.NumGet(blockPtr, 0, "u"), cntUsage: DX.NumGet(blockPtr, 4, "u"),
+             th32ProcessID: DX.NumGet(blockPtr, 8, "u"), priority: DX.NumGet(blockPtr, is64 ? 24 : 16, "n"),
+             weight: DX.NumGet(blockPtr, is64 ? 32 : 24, "d"), szName: DX.StrGet(entryAddr + nameOffset)};
+});
+bench("ReadStruct", 200, function(i) {
+    DX.ReadStruct("ENTRY", entryAddr);
+});
+var entry = DX.ReadStruct("ENTRY", entryAddr);
+entry.th32ProcessID = 7;
+var structEnd = DX.WriteStruct("ENTRY", entryAddr, entry);
+var copy = DX.ReadStruct("ENTRY", entryAddr);
+WScript.Echo("Round trip: " + (copy.szName === "notepad.exe" && copy.priority === -3 && copy.weight === 0.5 &&
+             copy.th32ProcessID === 7 && structEnd - entryAddr === entrySize ? "[PASS]" : "[FAIL]"));
+var pairSize = DX.DefineStruct("LPAIR", "l a; u b; l c[2]");
+var pairBuf = DX.Alloc(pairSize + 4);
+pairBuf.u32(4, 0xCAFEBABE);                     // Guard just past the struct
+DX.WriteStruct("LPAIR", pairBuf.ptr, {a: -1, b: 0x11223344, c: [5, -6]});
+DX.WriteStruct("LPAIR", pairBuf.ptr, {a: 1});   // b and c are absent: left untouched
+var pair = DX.ReadStruct("LPAIR", pairBuf.ptr);
+var pairC = new VBArray(pair.c).toArray();
+var badLayout = false;
+try { DX.DefineStruct("BAD", "DWORD x"); } catch (e) { badLayout = true; }
+WScript.Echo("l fields stay 4 bytes, unknown type names rejected: " +
+             (pairSize === 16 && pair.a === 1 && pair.b === 0x11223344 && pairC[0] === 5 && pairC[1] === -6 &&
+              pairBuf.u32(4) === 0xCAFEBABE && badLayout ? "[PASS]" : "[FAIL]"));
+
+// --- Buffer objects ---
+WScript.Echo("\n--- Alloc vs VirtualAlloc scratch memory ---");
+DX.Register("kernel32.dll", "VirtualAlloc", "p=pupu");
+DX.Register("kernel32.dll", "VirtualFree", "l=ppu");
+bench("VirtualAlloc + VirtualFree (64 bytes)", 2000, function(i) {
+    var mem = DX.VirtualAlloc(0, 64, 0x3000, 4); // MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE
+    DX.VirtualFree(mem, 0, 0x8000);              // MEM_RELEASE
+});
+bench("Alloc(64) (freed on release)", 2000, function(i) {
+    DX.Alloc(64);
+});
+var buf = DX.Alloc(1024, 64);
+bench("256 x buf.u32(i, v)", 200, function(i) {
+    for (var k = 0; k < 256; k++) buf.u32(k, k * 7);
+});
+bench("256 x NumPut(v, buf.ptr, ...)", 200, function(i) {
+    var base = buf.ptr;
+    for (var k = 0; k < 256; k++) DX.NumPut(k * 7, base, k * 4, "u");
+});
+var sum = 0;
+bench("256 x buf.u32(i)", 200, function(i) {
+    sum = 0;
+    for (var k = 0; k < 256; k++) sum += buf.u32(k);
+});
+DX.Register("kernel32.dll", "GetSystemTimeAsFileTime", "v=p");
+DX.GetSystemTimeAsFileTime(buf);                  // The buffer is a valid p argument
+var badIndex = false;
+try { buf.f64(128); } catch (e) { badIndex = true; }
+WScript.Echo("Aligned, bounds-checked, usable as p: " +
+             (buf.ptr % 64 === 0 && buf.size === 1024 && sum === 7 * 255 * 128 && buf.u32(1) !== 0 &&
+              DX.NumGet(buf, 4, "u") === buf.u32(1) && badIndex ? "[PASS]" : "[FAIL]"));
+buf.u32(255, 7);
+buf.i32(254, 1.5);                                // A double: converted, still stored as 4 bytes
+var overflow = false;
+try { buf.i32(0, 3000000000); } catch (e) { overflow = true; }
+WScript.Echo("Converted stores keep the element width, out-of-range rejected: " +
+             (buf.i32(254) === 2 && buf.u32(255) === 7 && overflow ? "[PASS]" : "[FAIL]"));
+
+// --- SAFEARRAY pointer arguments ---
+WScript.Echo("\n--- Byte array as p: pinned SAFEARRAY vs copy into native memory ---");
+DX.Register("ntdll.dll", "RtlComputeCrc32", "u=upl");
+var blob = DX.Alloc(4096);
+for (var k = 0; k < 1024; k++) blob.u32(k, (k * 2654435761) % 4294967296);
+var bytes = DX.NumGetArray(blob, 0, "b", 4096, 1, true);   // VT_ARRAY | VT_UI1
+var byteList = new VBArray(bytes).toArray();
+var scratch = DX.Alloc(4096);
+var crcCopy, crcPinned;
+bench("NumPutArray copy + call (4 KB)", 200, function(i) {
+    DX.NumPutArray(byteList, scratch, 0, "b");
+    crcCopy = DX.RtlComputeCrc32(0, scratch, 4096);
+});
+bench("Pinned SAFEARRAY call (4 KB)", 200, function(i) {
+    crcPinned = DX.RtlComputeCrc32(0, bytes, 4096);
+});
+WScript.Echo("Same CRC: " + (crcCopy === crcPinned && crcPinned === DX.RtlComputeCrc32(0, blob, 4096) ? "[PASS]" : "[FAIL]"));
+
+// --- Output parameters ---
+WScript.Echo("\n--- Output parameters: OutArray vs scratch memory + NumGet ---");
+DX.Register("kernel32.dll", "ProcessIdToSessionId", "l=uU");
+DX.Register("kernel32.dll", "GetComputerNameW", "l=WU");
+var pid = DX.GetCurrentProcessId();
+var sessionCell = DX.Alloc(4);
+var sessionOld, sessionNew;
+bench("Address of scratch memory + NumGet", 5000, function(i) {
+    DX.ProcessIdToSessionId(pid, sessionCell);   // Without OutArray: the address is passed as is
+    sessionOld = DX.NumGet(sessionCell, 0, "u");
+});
+DX.SetOption("OutArray", true);
+bench("OutArray result", 5000, function(i) {
+    sessionNew = new VBArray(DX.ProcessIdToSessionId(pid)).toArray()[1]; // Trailing outputs may be omitted
+});
+var nameResult = new VBArray(DX.GetComputerNameW(DX.Space(63), 64)).toArray(); // [ok, name, length]
+DX.SetOption("OutArray", false);
+WScript.Echo("Computer name: " + nameResult[1] + " (" + nameResult[2] + " chars)");
+WScript.Echo("Same session, name length written back: " +
+             (sessionOld === sessionNew && nameResult[0] !== 0 && nameResult[1].length === nameResult[2] ? "[PASS]" : "[FAIL]"));
+
+// --- Sized string outputs ---
+WScript.Echo("\n--- String outputs: capacity argument vs Space + StrPtr + StrGet ---");
+DX.Register("kernel32.dll", "GetWindowsDirectoryW", "l=pl");
+DX.Register("kernel32.dll", "GetSystemDirectoryW", "l=Wl");
+var winDirOld, sysDirNew;
+bench("Space + StrPtr + call + StrGet", 5000, function(i) {
+    var dirBuffer = DX.Space(260);
+    var dirPtr = DX.StrPtr(dirBuffer);
+    var dirLength = DX.GetWindowsDirectoryW(dirPtr, 260);
+    winDirOld = DX.StrGet(dirPtr, dirLength, "w");
+});
+bench("Capacity argument (returns the string)", 5000, function(i) {
+    sysDirNew = DX.GetSystemDirectoryW(260, 260);
+});
+DX.Register("kernel32.dll", "GetSystemDirectoryW", "l=Wl#");       // '#': uSize is the buffer size
+DX.Register("kernel32.dll", "GetComputerNameW", "l=WU#");          // Required size written to nSize
+DX.SetOption("GrowRetry", true);
+var grown = DX.GetSystemDirectoryW(4, 4); // Returns the required size, so the call is repeated
+DX.SetOption("OutArray", true);                                    // nSize is an output: [ok, name, nSize]
+var grownName = new VBArray(DX.GetComputerNameW(2, 2)).toArray()[1];
+DX.SetOption("OutArray", false);
+DX.SetOption("GrowRetry", false);
+WScript.Echo(winDirOld + " / " + sysDirNew);
+WScript.Echo("Strings returned, GrowRetry: " +
+             (sysDirNew.toLowerCase().indexOf(winDirOld.toLowerCase()) === 0 && grown === sysDirNew &&
+              grownName === nameResult[1] ? "[PASS]" : "[FAIL]"));
+
+// --- Borrowed BSTRs ---
+WScript.Echo("\n--- Large w arguments and StrPtr: borrowed script string vs copy ---");
+var bigText = DX.Space(4 * 1024 * 1024);          // 8 MB of UTF-16
+var bigLength, bigPtr, liveBefore = DX.Counter("LiveBytes");
+bench("lstrlenW on a 4M-char w argument", 200, function(i) {
+    bigLength = DX.lstrlenW(bigText);
+});
+bench("StrPtr on a 4M-char string, borrowed", 200, function(i) {
+    bigPtr = DX.StrPtr(bigText, "w", true);        // bigText is held below, so the buffer stays valid
+});
+bench("StrPtr on a 4M-char string, copied (scoped)", 20, function(i) {
+    DX.BeginScope();
+    DX.StrPtr(bigText);
+    DX.EndScope();
+});
+bench("lstrlenA on a 4M-char s argument (converted)", 20, function(i) {
+    DX.lstrlenA(bigText);
+});
+WScript.Echo("No copies held, same buffer: " +
+             (bigLength === bigText.length && DX.Counter("LiveBytes") === liveBefore &&
+              bigPtr === DX.StrPtr(bigText, "w", true) ? "[PASS]" : "[FAIL]"));
+
+// --- UTF-8 and narrow string transcoding ---
+WScript.Echo("\n--- Narrow string transcoding: 1M-char texts through StrPtr/StrGet ---");
+var textChars = 1024 * 1024;
+var asciiText = DX.Space(textChars, "x");
+var mixedText = DX.Space(textChars / 2, "x") + DX.Space(textChars / 2, "\u0436");   // Half Cyrillic
+function transcodeRate(name, text, type, iterations) {
+    var roundTrip;
+    var elapsed = bench(name, iterations, function(i) {
+        DX.BeginScope();
+        roundTrip = DX.StrGet(DX.StrPtr(text, type), type);
+        DX.EndScope();
+    });
+    if (elapsed > 0)
+        WScript.Echo("  " + Math.round(text.length * iterations / 1000 / elapsed) + " M chars/s each way");
+    return roundTrip === text;
+}
+var asciiOk = transcodeRate("ASCII text as a (UTF-8)", asciiText, "a", 50);
+transcodeRate("ASCII text as s (ANSI)", asciiText, "s", 50);
+var mixedOk = transcodeRate("Half-Cyrillic text as a (UTF-8)", mixedText, "a", 20);
+DX.Register("kernel32.dll", "lstrlenA", "l=a");
+var utf8Bytes = DX.lstrlenA(mixedText);                // 1 byte per ASCII char, 2 per Cyrillic char
+WScript.Echo("Round trips intact, UTF-8 sized to " + utf8Bytes + " bytes: " +
+             (asciiOk && mixedOk && utf8Bytes === textChars / 2 * 3 ? "[PASS]" : "[FAIL]"));
+
+WScript.Echo("\n=== Benchmarks Completed ===");
@@ -225,14 +225,14 @@ safeExecute("Enumerate Running Processes", function() {
                 try {
                     debugLog("Reading process name from offset 44 (x64)...", "DEBUG");
                     // PROCESSENTRY32W has szExeFile at offset 44 on x64 (260 WCHARs = 520 bytes)
-                    // Read Unicode characters manually
-                    for (var i = 0; i < 260; i++) {
-                        var char = DX.NumGet(processEntry, 44 + (i * 2), "t");
-                        if (char === 0) {
+                    // Read all 260 WCHARs in one call
+                    var nameChars = new VBArray(DX.NumGetArray(processEntry, 44, "t", 260)).toArray();
+                    for (var i = 0; i < nameChars.length; i++) {
+                        if (nameChars[i] === 0) {
                             debugLog("Found null terminator at position " + i, "DEBUG");
                             break;
                         }
-                        exeName += String.fromCharCode(char);
+                        exeName += String.fromCharCode(nameChars[i]);
                     }
                     
                     debugLog("Raw process name: '" + exeName + "' (length: " + exeName.length + ")", "DEBUG");
@@ -351,31 +351,13 @@ safeExecute("Process Creation with CreateProcess", function() {
         throw new Error("Failed to allocate structures for CreateProcess");
     }
     
-    // Initialize STARTUPINFOW structure properly (104 bytes for x64)
+    // Initialize STARTUPINFOW structure (104 bytes for x64): zero all
+    // thirteen 8-byte words in one call, then set cb
+    DX.NumPutArray([0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0], startupInfo, 0, "p");
     DX.NumPut(104, startupInfo, 0, "u");        // cb (size of STARTUPINFOW)
-    DX.NumPut(0, startupInfo, 8, "p");          // lpReserved (8-byte aligned)
-    DX.NumPut(0, startupInfo, 16, "p");         // lpDesktop  
-    DX.NumPut(0, startupInfo, 24, "p");         // lpTitle
-    DX.NumPut(0, startupInfo, 32, "u");         // dwX
-    DX.NumPut(0, startupInfo, 36, "u");         // dwY
-    DX.NumPut(0, startupInfo, 40, "u");         // dwXSize
-    DX.NumPut(0, startupInfo, 44, "u");         // dwYSize
-    DX.NumPut(0, startupInfo, 48, "u");         // dwXCountChars
-    DX.NumPut(0, startupInfo, 52, "u");         // dwYCountChars
-    DX.NumPut(0, startupInfo, 56, "u");         // dwFillAttribute
-    DX.NumPut(0, startupInfo, 60, "u");         // dwFlags
-    DX.NumPut(0, startupInfo, 64, "t");         // wShowWindow
-    DX.NumPut(0, startupInfo, 66, "t");         // cbReserved2
-    DX.NumPut(0, startupInfo, 72, "p");         // lpReserved2
-    DX.NumPut(0, startupInfo, 80, "p");         // hStdInput
-    DX.NumPut(0, startupInfo, 88, "p");         // hStdOutput  
-    DX.NumPut(0, startupInfo, 96, "p");         // hStdError
     
     // Initialize PROCESS_INFORMATION structure (24 bytes for x64)
-    DX.NumPut(0, processInfo, 0, "p");          // hProcess (8 bytes)
-    DX.NumPut(0, processInfo, 8, "p");          // hThread (8 bytes)
-    DX.NumPut(0, processInfo, 16, "u");         // dwProcessId (4 bytes)
-    DX.NumPut(0, processInfo, 20, "u");         // dwThreadId (4 bytes)
+    DX.NumPutArray([0, 0, 0], processInfo, 0, "p");
     
     // Command line: simple echo command
     var cmdLine = 'cmd.exe /c "echo CreateProcessW x64 test successful & timeout /t 2 > nul"';
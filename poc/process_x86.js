@@ -205,15 +205,14 @@ safeExecute("Enumerate Running Processes", function() {
                 try {
                     debugLog("Reading process name from offset 36...", "DEBUG");
                     // PROCESSENTRY32W has szExeFile at offset 36 on x86 (260 WCHARs = 520 bytes)
-                    // Read Unicode characters manually
-                    for (var i = 0; i < 260; i++) {
-                        var char = DX.NumGet(processEntry, 36 + (i * 2), "t");
-                        if (char === 0) {
+                    // Read all 260 WCHARs in one call
+                    var nameChars = new VBArray(DX.NumGetArray(processEntry, 36, "t", 260)).toArray();
+                    for (var i = 0; i < nameChars.length; i++) {
+                        if (nameChars[i] === 0) {
                             debugLog("Found null terminator at position " + i, "DEBUG");
                             break;
                         }
-                        exeName += String.fromCharCode(char);
-
+                        exeName += String.fromCharCode(nameChars[i]);
                     }
                     
                     debugLog("Raw process name: '" + exeName + "' (length: " + exeName.length + ")", "DEBUG");
@@ -332,10 +331,9 @@ safeExecute("Find Specific Process by Name", function() {
                 // Read process name to verify
                 var exeName = "";
                 try {
-                    for (var i = 0; i < 260; i++) {
-                        var char = DX.NumGet(processEntry, 44 + (i * 2), "t");
-                        if (char === 0) break;
-                        exeName += String.fromCharCode(char);
+                    var nameChars = new VBArray(DX.NumGetArray(processEntry, 44, "t", 260)).toArray();
+                    for (var i = 0; i < nameChars.length && nameChars[i] !== 0; i++) {
+                        exeName += String.fromCharCode(nameChars[i]);
                     }
                     WScript.Echo("Process name: " + exeName);
                     found = true;
@@ -41,7 +41,9 @@ try {
     
     // Create buffer and write data
     var writeBuffer = DX.Space(20);
-    var addr = DX.StrPtr(writeBuffer);
+    // Borrow writeBuffer's own memory so the writes show up in the string;
+    // only valid while writeBuffer is held (never borrow a temporary)
+    var addr = DX.StrPtr(writeBuffer, "w", true);
     DX.NumPut(0x41, addr, 0, "t");  // Write 'A'
     DX.NumPut(0x42, addr, 2, "t");  // Write 'B'
     DX.NumPut(0x43, addr, 4, "t");  // Write 'C'
@@ -92,12 +94,11 @@ try {
     
     // Test 7: File operations
     WScript.Echo("\n=== Test 7: File Operations ===");
-    DX.Register("kernel32.dll", "GetTempPathW", "i=lp", "r=l");
-    var tempPathBuffer = DX.Space(520); // 260 chars * 2 bytes for Unicode
-    var tempPathPtr = DX.StrPtr(tempPathBuffer);
-    var tempPathLength = DX.GetTempPathW(260, tempPathPtr);
-    if (tempPathLength > 0) {
-        var tempPath = DX.StrGet(tempPathPtr, tempPathLength, "w");
+    DX.Register("kernel32.dll", "GetTempPathW", "i=lW", "r=l");
+    // A number passed for a W parameter is the buffer capacity: the wrapper
+    // provides the buffer and the call returns the string
+    var tempPath = DX.GetTempPathW(260, 260);
+    if (tempPath.length > 0) {
         WScript.Echo("Temp path: " + tempPath);
     } else {
         WScript.Echo("Failed to get temp path");
@@ -0,0 +1,143 @@
+#include "dynwrapx.h"
+
+// Atomic 64-bit read (plain loads can tear on x86)
+static LONGLONG ReadStat(LONGLONG volatile* pValue)
+{
+    return InterlockedCompareExchange64(pValue, 0, 0);
+}
+
+// Lower *pValue to value (0 means no sample yet)
+static void UpdateMin(LONGLONG volatile* pValue, LONGLONG value)
+{
+    LONGLONG current = ReadStat(pValue);
+    while ((current == 0 || value < current) &&
+           InterlockedCompareExchange64(pValue, value, current) != current)
+        current = ReadStat(pValue);
+}
+
+// Raise *pValue to value
+static void UpdateMax(LONGLONG volatile* pValue, LONGLONG value)
+{
+    LONGLONG current = ReadStat(pValue);
+    while (value > current &&
+           InterlockedCompareExchange64(pValue, value, current) != current)
+        current = ReadStat(pValue);
+}
+
+// Histogram bucket for a duration: floor(log2(nanoseconds)), clamped
+static int GetLatencyBucket(LONGLONG ticks)
+{
+    if (ticks <= 0 || g_qpcFrequency <= 0)
+        return 0;
+    
+    // Durations too long to scale without overflow go to the last bucket
+    if (ticks > MAXLONGLONG / 1000000000LL)
+        return DYNWRAPX_STATS_BUCKETS - 1;
+    
+    ULONGLONG nanoseconds = (ULONGLONG)(ticks * 1000000000LL / g_qpcFrequency);
+    int bucket = 0;
+    while (nanoseconds > 1 && bucket < DYNWRAPX_STATS_BUCKETS - 1)
+    {
+        nanoseconds >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Record one call. Timestamps are QPC values; converted and called are 0
+// when the call failed before reaching that phase. Lock-free: every field
+// is updated with an interlocked operation.
+void RecordCallStats(FunctionInfo* pFunc, LONGLONG start, LONGLONG converted, LONGLONG called, LONGLONG end, HRESULT hr)
+{
+    FunctionStats* pStats = &pFunc->stats;
+    LONGLONG total = end - start;
+    
+    InterlockedIncrement64(&pStats->calls);
+    if (FAILED(hr))
+        InterlockedIncrement64(&pStats->failures);
+    
+    InterlockedExchangeAdd64(&pStats->totalTicks, total);
+    UpdateMin(&pStats->minTicks, total > 0 ? total : 1);
+    UpdateMax(&pStats->maxTicks, total);
+    InterlockedIncrement64(&pStats->histogram[GetLatencyBucket(total)]);
+    
+    if (converted)
+    {
+        InterlockedExchangeAdd64(&pStats->convertTicks, converted - start);
+        if (called)
+        {
+            InterlockedExchangeAdd64(&pStats->nativeTicks, called - converted);
+            InterlockedExchangeAdd64(&pStats->resultTicks, end - called);
+        }
+    }
+}
+
+// Zero every counter of a function
+void ResetCallStats(FunctionInfo* pFunc)
+{
+    FunctionStats* pStats = &pFunc->stats;
+    
+    InterlockedExchange64(&pStats->calls, 0);
+    InterlockedExchange64(&pStats->failures, 0);
+    InterlockedExchange64(&pStats->totalTicks, 0);
+    InterlockedExchange64(&pStats->minTicks, 0);
+    InterlockedExchange64(&pStats->maxTicks, 0);
+    InterlockedExchange64(&pStats->convertTicks, 0);
+    InterlockedExchange64(&pStats->nativeTicks, 0);
+    InterlockedExchange64(&pStats->resultTicks, 0);
+    for (int i = 0; i < DYNWRAPX_STATS_BUCKETS; i++)
+        InterlockedExchange64(&pStats->histogram[i], 0);
+}
+
+static void SetDouble(VARIANT* pVar, double value)
+{
+    VariantInit(pVar);
+    V_VT(pVar) = VT_R8;
+    V_R8(pVar) = value;
+}
+
+static double TicksToMicroseconds(LONGLONG ticks)
+{
+    return g_qpcFrequency > 0 ? (double)ticks * 1000000.0 / (double)g_qpcFrequency : 0.0;
+}
+
+// Build the Stats() row for one function:
+//   [name, calls, failures, totalUs, minUs, maxUs,
+//    convertUs, nativeUs, resultUs, histogram]
+// where histogram[i] counts calls that took [2^i, 2^(i+1)) nanoseconds
+HRESULT GetCallStatsRow(FunctionInfo* pFunc, VARIANT* pRow)
+{
+    FunctionStats* pStats = &pFunc->stats;
+    VARIANT fields[DYNWRAPX_STATS_FIELDS];
+    VARIANT buckets[DYNWRAPX_STATS_BUCKETS];
+    HRESULT hr;
+    
+    for (int i = 0; i < DYNWRAPX_STATS_BUCKETS; i++)
+        SetDouble(&buckets[i], (double)ReadStat(&pStats->histogram[i]));
+    
+    VariantInit(&fields[9]);
+    VariantInit(&fields[0]);
+    V_VT(&fields[0]) = VT_BSTR;
+    V_BSTR(&fields[0]) = SysAllocString(pFunc->functionName);
+    if (!V_BSTR(&fields[0]))
+        return E_OUTOFMEMORY;
+    
+    SetDouble(&fields[1], (double)ReadStat(&pStats->calls));
+    SetDouble(&fields[2], (double)ReadStat(&pStats->failures));
+    SetDouble(&fields[3], TicksToMicroseconds(ReadStat(&pStats->totalTicks)));
+    SetDouble(&fields[4], TicksToMicroseconds(ReadStat(&pStats->minTicks)));
+    SetDouble(&fields[5], TicksToMicroseconds(ReadStat(&pStats->maxTicks)));
+    SetDouble(&fields[6], TicksToMicroseconds(ReadStat(&pStats->convertTicks)));
+    SetDouble(&fields[7], TicksToMicroseconds(ReadStat(&pStats->nativeTicks)));
+    SetDouble(&fields[8], TicksToMicroseconds(ReadStat(&pStats->resultTicks)));
+    
+    hr = CreateVariantArray(buckets, DYNWRAPX_STATS_BUCKETS, &fields[9]);
+    if (SUCCEEDED(hr))
+        hr = CreateVariantArray(fields, DYNWRAPX_STATS_FIELDS, pRow);
+    if (FAILED(hr))
+    {
+        VariantClear(&fields[0]);
+        VariantClear(&fields[9]);
+    }
+    return hr;
+}
@@ -0,0 +1,629 @@
+#include "dynwrapx.h"
+
+// Record returned by ReadStruct: one VARIANT per field, exposed to script as
+// properties named after the fields (DISPID = field index + 1)
+typedef struct _StructRecord {
+    IDispatchVtbl* lpVtbl;
+    LONG refCount;
+    DynamicWrapperX* owner;     // AddRef'd: keeps the definition alive
+    StructDef* def;
+    VARIANT values[1];          // def->fieldCount entries
+} StructRecord;
+
+static IDispatchVtbl g_structRecordVtbl;
+
+static BOOL IsLayoutSeparator(WCHAR c)
+{
+    return c == L';' || c == L',' || c == L'\n' || c == L'\r';
+}
+
+static BOOL IsLayoutSpace(WCHAR c)
+{
+    return c == L' ' || c == L'\t';
+}
+
+// Decode a field type: a lowercase type letter or a NumGet type name.
+// Anything else fails rather than guessing from its first letter, which
+// would silently shift every later offset.
+static BOOL ParseFieldType(LPCWSTR start, int length, ParameterType* pType)
+{
+    WCHAR name[16];
+    
+    if (length == 1)
+    {
+        if (!wcschr(L"luhpntcbfdqwsza", start[0]))
+            return FALSE;
+        *pType = ParseParameterType(start[0]);
+        return TRUE;
+    }
+    if (length >= (int)(sizeof(name) / sizeof(name[0])))
+        return FALSE;
+    
+    memcpy(name, start, length * sizeof(WCHAR));
+    name[length] = L'\0';
+    return LookupNumTypeName(name, pType);
+}
+
+// Element size of a field type; characters for the inline string types
+static LONG GetFieldElementSize(ParameterType type)
+{
+    switch (type)
+    {
+    case TYPE_WSTRING:
+        return sizeof(WCHAR);
+    case TYPE_ASTRING:
+    case TYPE_OSTRING:
+    case TYPE_USTRING:
+        return sizeof(CHAR);
+    default:
+        return (LONG)GetTypeSize(type);
+    }
+}
+
+static void FreeStructDef(StructDef* pDef)
+{
+    if (pDef->fields)
+    {
+        for (int i = 0; i < pDef->fieldCount; i++)
+            SAFE_SYSFREE(pDef->fields[i].name);
+        GlobalFree(pDef->fields);
+    }
+    SAFE_SYSFREE(pDef->name);
+    GlobalFree(pDef);
+}
+
+// Parse one "type name" or "type name[count]" entry and lay it out after
+// the fields already placed
+static HRESULT ParseStructField(LPCWSTR start, LPCWSTR end, StructDef* pDef)
+{
+    StructField* pField = &pDef->fields[pDef->fieldCount];
+    LPCWSTR p = start;
+    
+    // Type token
+    LPCWSTR typeStart = p;
+    while (p < end && !IsLayoutSpace(*p))
+        p++;
+    if (!ParseFieldType(typeStart, (int)(p - typeStart), &pField->type))
+        return E_INVALIDARG;
+    
+    // Field name
+    while (p < end && IsLayoutSpace(*p))
+        p++;
+    LPCWSTR nameStart = p;
+    while (p < end && !IsLayoutSpace(*p) && *p != L'[')
+        p++;
+    LPCWSTR nameEnd = p;
+    if (nameEnd == nameStart)
+        return E_INVALIDARG;
+    
+    // Optional [count]
+    pField->count = 1;
+    while (p < end && IsLayoutSpace(*p))
+        p++;
+    BOOL isArray = (p < end && *p == L'[');
+    if (isArray)
+    {
+        LONG count = 0;
+        for (p++; p < end && *p >= L'0' && *p <= L'9'; p++)
+        {
+            count = count * 10 + (*p - L'0');
+            if (count > 0x100000)
+                return E_INVALIDARG;
+        }
+        if (p >= end || *p != L']' || count <= 0)
+            return E_INVALIDARG;
+        pField->count = count;
+        p++;
+    }
+    while (p < end && IsLayoutSpace(*p))
+        p++;
+    if (p != end)
+        return E_INVALIDARG;
+    
+    // Strings are only supported as inline character buffers
+    pField->isText = (pField->type == TYPE_WSTRING || pField->type == TYPE_ASTRING || pField->type == TYPE_OSTRING ||
+                      pField->type == TYPE_USTRING);
+    if (pField->isText && !isArray)
+        return E_INVALIDARG;
+    
+    LONG size = GetFieldElementSize(pField->type);
+    if (size == 0)
+        return E_INVALIDARG;
+    
+    // Natural alignment: every field type is aligned to its own size
+    pDef->size = (pDef->size + size - 1) & ~(size - 1);
+    pField->offset = pDef->size;
+    pDef->size += size * pField->count;
+    if (size > pDef->align)
+        pDef->align = size;
+    
+    pField->name = SysAllocStringLen(nameStart, (UINT)(nameEnd - nameStart));
+    if (!pField->name)
+        return E_OUTOFMEMORY;
+    
+    pDef->fieldCount++;
+    return S_OK;
+}
+
+// Compile a layout string ("u dwSize; w szExeFile[260]; ...") into a field
+// table and add it to the object. A later definition with the same name
+// replaces the earlier one for new calls.
+HRESULT DefineStruct(DynamicWrapperX* pObj, LPCWSTR name, LPCWSTR layout, StructDef** ppDef)
+{
+    HRESULT hr = S_OK;
+    int maxFields = 1;
+    
+    if (!name || !*name || !layout)
+        return E_INVALIDARG;
+    
+    for (LPCWSTR p = layout; *p; p++)
+    {
+        if (IsLayoutSeparator(*p))
+            maxFields++;
+    }
+    
+    StructDef* pDef = (StructDef*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, sizeof(StructDef));
+    if (!pDef)
+        return E_OUTOFMEMORY;
+    pDef->align = 1;
+    pDef->name = SysAllocString(name);
+    pDef->fields = (StructField*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, maxFields * sizeof(StructField));
+    if (!pDef->name || !pDef->fields)
+    {
+        FreeStructDef(pDef);
+        return E_OUTOFMEMORY;
+    }
+    
+    LPCWSTR p = layout;
+    while (*p && SUCCEEDED(hr))
+    {
+        // Trim the entry; empty entries (trailing separators) are skipped
+        while (IsLayoutSpace(*p) || IsLayoutSeparator(*p))
+            p++;
+        LPCWSTR start = p;
+        while (*p && !IsLayoutSeparator(*p))
+            p++;
+        LPCWSTR end = p;
+        while (end > start && IsLayoutSpace(end[-1]))
+            end--;
+        if (end > start)
+            hr = ParseStructField(start, end, pDef);
+    }
+    
+    if (SUCCEEDED(hr) && pDef->fieldCount == 0)
+        hr = E_INVALIDARG;
+    if (FAILED(hr))
+    {
+        DebugLog("ERROR", "DefineStruct", "Invalid layout for struct '%S': '%S'", name, layout);
+        FreeStructDef(pDef);
+        return hr;
+    }
+    
+    // Trailing padding so arrays of the struct stay aligned
+    pDef->size = (pDef->size + pDef->align - 1) & ~(pDef->align - 1);
+    
+    EnterCriticalSection(&pObj->cs);
+    pDef->next = pObj->structs;
+    pObj->structs = pDef;
+    LeaveCriticalSection(&pObj->cs);
+    
+    DebugLog("INFO", "DefineStruct", "Defined struct '%S': %d fields, %ld bytes", name, pDef->fieldCount, pDef->size);
+    *ppDef = pDef;
+    return S_OK;
+}
+
+// Newest definition with the given name (case-insensitive)
+StructDef* FindStruct(DynamicWrapperX* pObj, LPCWSTR name)
+{
+    StructDef* pDef;
+    
+    EnterCriticalSection(&pObj->cs);
+    for (pDef = pObj->structs; pDef; pDef = pDef->next)
+    {
+        if (_wcsicmp(pDef->name, name) == 0)
+            break;
+    }
+    LeaveCriticalSection(&pObj->cs);
+    return pDef;
+}
+
+void FreeStructDefs(DynamicWrapperX* pObj)
+{
+    while (pObj->structs)
+    {
+        StructDef* pNext = pObj->structs->next;
+        FreeStructDef(pObj->structs);
+        pObj->structs = pNext;
+    }
+}
+
+// Read an inline character buffer up to its first NUL
+static HRESULT ReadTextField(const BYTE* src, const StructField* pField, VARIANT* pValue)
+{
+    BSTR text;
+    
+    if (pField->type == TYPE_WSTRING)
+    {
+        const WCHAR* chars = (const WCHAR*)src;
+        LONG length = 0;
+        while (length < pField->count && chars[length])
+            length++;
+        text = SysAllocStringLen(chars, (UINT)length);
+    }
+    else
+    {
+        const CHAR* chars = (const CHAR*)src;
+        LONG length = 0;
+        while (length < pField->count && chars[length])
+            length++;
+        text = NarrowToBstr(GetStringCodePage(pField->type), chars, (int)length);
+    }
+    
+    if (!text)
+        return E_OUTOFMEMORY;
+    V_VT(pValue) = VT_BSTR;
+    V_BSTR(pValue) = text;
+    return S_OK;
+}
+
+// Store a string into an inline character buffer, truncated to leave room
+// for the NUL; the rest of the buffer is zeroed
+static HRESULT WriteTextField(BYTE* dst, const StructField* pField, VARIANT* pValue)
+{
+    VARIANT vTemp;
+    VariantInit(&vTemp);
+    HRESULT hr = VariantChangeType(&vTemp, pValue, 0, VT_BSTR);
+    if (FAILED(hr))
+        return hr;
+    
+    LPCWSTR src = V_BSTR(&vTemp) ? V_BSTR(&vTemp) : L"";
+    int length = (int)SysStringLen(V_BSTR(&vTemp));
+    
+    if (pField->type == TYPE_WSTRING)
+    {
+        if (length > pField->count - 1)
+            length = pField->count - 1;
+        memcpy(dst, src, length * sizeof(WCHAR));
+        memset(dst + length * sizeof(WCHAR), 0, (pField->count - length) * sizeof(WCHAR));
+    }
+    else
+    {
+        // Converted in place when it fits; otherwise in full, then cut to
+        // the buffer without splitting a UTF-8 sequence
+        UINT codePage = GetStringCodePage(pField->type);
+        int room = pField->count - 1;
+        int written = WideToNarrow(codePage, src, length, (LPSTR)dst, room);
+        if (written > room)
+        {
+            LPSTR full = (LPSTR)GlobalAlloc(GMEM_FIXED, written);
+            if (!full)
+            {
+                VariantClear(&vTemp);
+                return E_OUTOFMEMORY;
+            }
+            WideToNarrow(codePage, src, length, full, written);
+            written = room;
+            if (codePage == CP_UTF8)
+            {
+                while (written > 0 && ((BYTE)full[written] & 0xC0) == 0x80)
+                    written--;
+            }
+            memcpy(dst, full, written);
+            GlobalFree(full);
+        }
+        memset(dst + written, 0, pField->count - written);
+    }
+    
+    VariantClear(&vTemp);
+    return S_OK;
+}
+
+// Read every field of a struct at base into values (fieldCount entries,
+// initialized by the caller)
+static HRESULT ReadStructFields(const StructDef* pDef, const BYTE* base, VARIANT* values)
+{
+    HRESULT hr = S_OK;
+    
+    for (int i = 0; i < pDef->fieldCount && SUCCEEDED(hr); i++)
+    {
+        const StructField* pField = &pDef->fields[i];
+        const BYTE* src = base + pField->offset;
+        
+        if (pField->isText)
+        {
+            hr = ReadTextField(src, pField, &values[i]);
+        }
+        else if (pField->count == 1)
+        {
+            ReadTypedValue(src, pField->type, &values[i]);
+        }
+        else
+        {
+            // Numeric array: a VARIANT array, like NumGetArray
+            SAFEARRAY* psa = SafeArrayCreateVector(VT_VARIANT, 0, (ULONG)pField->count);
+            VARIANT* items;
+            if (!psa)
+                return E_OUTOFMEMORY;
+            hr = SafeArrayAccessData(psa, (void**)&items);
+            if (FAILED(hr))
+            {
+                SafeArrayDestroy(psa);
+                return hr;
+            }
+            LONG size = GetFieldElementSize(pField->type);
+            for (LONG j = 0; j < pField->count; j++)
+                ReadTypedValue(src + j * size, pField->type, &items[j]);
+            SafeArrayUnaccessData(psa);
+            V_VT(&values[i]) = VT_ARRAY | VT_VARIANT;
+            V_ARRAY(&values[i]) = psa;
+        }
+    }
+    return hr;
+}
+
+// Store a script value into a numeric array field. Accepts a VARIANT
+// array or a JScript array; missing trailing elements are left unchanged.
+static HRESULT WriteArrayField(BYTE* dst, const StructField* pField, VARIANT* pValue)
+{
+    LONG size = GetFieldElementSize(pField->type);
+    HRESULT hr = S_OK;
+    
+    if (V_VT(pValue) == (VT_VARIANT | VT_BYREF))
+        pValue = V_VARIANTREF(pValue);
+    
+    if (V_VT(pValue) == (VT_ARRAY | VT_VARIANT))
+    {
+        SAFEARRAY* psa = V_ARRAY(pValue);
+        VARIANT* items;
+        LONG count = (LONG)psa->rgsabound[0].cElements;
+        if (count > pField->count)
+            count = pField->count;
+        hr = SafeArrayAccessData(psa, (void**)&items);
+        if (FAILED(hr))
+            return hr;
+        for (LONG j = 0; j < count && SUCCEEDED(hr); j++)
+            hr = WriteTypedValue(dst + j * size, pField->type, &items[j]);
+        SafeArrayUnaccessData(psa);
+        return hr;
+    }
+    
+    if (V_VT(pValue) == VT_DISPATCH && V_DISPATCH(pValue))
+    {
+        IDispatch* pArray = V_DISPATCH(pValue);
+        LONG count;
+        hr = GetScriptArrayLength(pArray, &count);
+        if (FAILED(hr))
+            return hr;
+        if (count > pField->count)
+            count = pField->count;
+        for (LONG j = 0; j < count && SUCCEEDED(hr); j++)
+        {
+            VARIANT item;
+            hr = GetScriptArrayItem(pArray, j, &item);
+            if (SUCCEEDED(hr))
+            {
+                if (V_VT(&item) != VT_EMPTY)
+                    hr = WriteTypedValue(dst + j * size, pField->type, &item);
+                VariantClear(&item);
+            }
+        }
+        return hr;
+    }
+    
+    return DISP_E_TYPEMISMATCH;
+}
+
+static HRESULT WriteStructField(BYTE* base, const StructField* pField, VARIANT* pValue)
+{
+    BYTE* dst = base + pField->offset;
+    
+    if (pField->isText)
+        return WriteTextField(dst, pField, pValue);
+    if (pField->count > 1)
+        return WriteArrayField(dst, pField, pValue);
+    return WriteTypedValue(dst, pField->type, pValue);
+}
+
+// Read a struct into a new record object
+HRESULT ReadStruct(DynamicWrapperX* pObj, StructDef* pDef, const void* address, VARIANT* pResult)
+{
+    SIZE_T size = sizeof(StructRecord) + (pDef->fieldCount - 1) * sizeof(VARIANT);
+    StructRecord* pRecord = (StructRecord*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, size);
+    if (!pRecord)
+        return E_OUTOFMEMORY;
+    
+    // Zeroed memory is VT_EMPTY for every value
+    pRecord->lpVtbl = &g_structRecordVtbl;
+    pRecord->refCount = 1;
+    pRecord->def = pDef;
+    pRecord->owner = pObj;
+    pObj->vtbl.lpVtbl->AddRef((IDynamicWrapperX*)pObj);
+    
+    HRESULT hr = ReadStructFields(pDef, (const BYTE*)address, pRecord->values);
+    if (FAILED(hr))
+    {
+        ((IDispatch*)pRecord)->lpVtbl->Release((IDispatch*)pRecord);
+        return hr;
+    }
+    
+    VariantInit(pResult);
+    V_VT(pResult) = VT_DISPATCH;
+    V_DISPATCH(pResult) = (IDispatch*)pRecord;
+    return S_OK;
+}
+
+// Write a record or script object to a struct. A record of the same layout
+// is copied field by field without any name lookups; for other objects each
+// field is fetched by name, and fields the object lacks are left unchanged.
+HRESULT WriteStruct(StructDef* pDef, void* address, VARIANT* pSource)
+{
+    BYTE* base = (BYTE*)address;
+    HRESULT hr = S_OK;
+    
+    if (V_VT(pSource) == (VT_VARIANT | VT_BYREF))
+        pSource = V_VARIANTREF(pSource);
+    if (V_VT(pSource) != VT_DISPATCH || !V_DISPATCH(pSource))
+        return DISP_E_TYPEMISMATCH;
+    
+    IDispatch* pDisp = V_DISPATCH(pSource);
+    if (pDisp->lpVtbl == &g_structRecordVtbl && ((StructRecord*)pDisp)->def == pDef)
+    {
+        StructRecord* pRecord = (StructRecord*)pDisp;
+        for (int i = 0; i < pDef->fieldCount && SUCCEEDED(hr); i++)
+        {
+            if (V_VT(&pRecord->values[i]) != VT_EMPTY)
+                hr = WriteStructField(base, &pDef->fields[i], &pRecord->values[i]);
+        }
+        return hr;
+    }
+    
+    DISPPARAMS noArgs = { NULL, NULL, 0, 0 };
+    for (int i = 0; i < pDef->fieldCount && SUCCEEDED(hr); i++)
+    {
+        LPOLESTR name = pDef->fields[i].name;
+        DISPID dispId;
+        VARIANT value;
+        
+        if (FAILED(pDisp->lpVtbl->GetIDsOfNames(pDisp, &IID_NULL, &name, 1, LOCALE_USER_DEFAULT, &dispId)))
+            continue;
+        
+        VariantInit(&value);
+        hr = pDisp->lpVtbl->Invoke(pDisp, dispId, &IID_NULL, LOCALE_USER_DEFAULT,
+                                   DISPATCH_PROPERTYGET, &noArgs, &value, NULL, NULL);
+        if (SUCCEEDED(hr) && V_VT(&value) != VT_EMPTY)
+            hr = WriteStructField(base, &pDef->fields[i], &value);
+        VariantClear(&value);
+    }
+    return hr;
+}
+
+// StructRecord IDispatch implementation
+
+static HRESULT STDMETHODCALLTYPE Record_QueryInterface(IDispatch* This, REFIID riid, void** ppv)
+{
+    if (!ppv)
+        return E_POINTER;
+    
+    if (IsEqualIID(riid, &IID_IUnknown) || IsEqualIID(riid, &IID_IDispatch))
+    {
+        *ppv = This;
+        This->lpVtbl->AddRef(This);
+        return S_OK;
+    }
+    
+    *ppv = NULL;
+    return E_NOINTERFACE;
+}
+
+static ULONG STDMETHODCALLTYPE Record_AddRef(IDispatch* This)
+{
+    StructRecord* pRecord = (StructRecord*)This;
+    return InterlockedIncrement(&pRecord->refCount);
+}
+
+static ULONG STDMETHODCALLTYPE Record_Release(IDispatch* This)
+{
+    StructRecord* pRecord = (StructRecord*)This;
+    LONG refCount = InterlockedDecrement(&pRecord->refCount);
+    
+    if (refCount == 0)
+    {
+        DynamicWrapperX* pOwner = pRecord->owner;
+        for (int i = 0; i < pRecord->def->fieldCount; i++)
+            VariantClear(&pRecord->values[i]);
+        GlobalFree(pRecord);
+        pOwner->vtbl.lpVtbl->Release((IDynamicWrapperX*)pOwner);
+    }
+    return refCount;
+}
+
+static HRESULT STDMETHODCALLTYPE Record_GetTypeInfoCount(IDispatch* This, UINT* pctinfo)
+{
+    if (!pctinfo)
+        return E_POINTER;
+    *pctinfo = 0;
+    return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE Record_GetTypeInfo(IDispatch* This, UINT iTInfo, LCID lcid, ITypeInfo** ppTInfo)
+{
+    if (ppTInfo)
+        *ppTInfo = NULL;
+    return E_NOTIMPL;
+}
+
+static HRESULT STDMETHODCALLTYPE Record_GetIDsOfNames(IDispatch* This, REFIID riid, LPOLESTR* rgszNames,
+                                                      UINT cNames, LCID lcid, DISPID* rgDispId)
+{
+    StructRecord* pRecord = (StructRecord*)This;
+    StructDef* pDef = pRecord->def;
+    HRESULT hr = S_OK;
+    
+    for (UINT n = 0; n < cNames; n++)
+    {
+        rgDispId[n] = DISPID_UNKNOWN;
+        
+        // Only the member name can be resolved; named arguments are not
+        if (n == 0)
+        {
+            for (int i = 0; i < pDef->fieldCount; i++)
+            {
+                if (_wcsicmp(rgszNames[0], pDef->fields[i].name) == 0)
+                {
+                    rgDispId[0] = i + 1;
+                    break;
+                }
+            }
+        }
+        if (rgDispId[n] == DISPID_UNKNOWN)
+            hr = DISP_E_UNKNOWNNAME;
+    }
+    return hr;
+}
+
+static HRESULT STDMETHODCALLTYPE Record_Invoke(IDispatch* This, DISPID dispIdMember, REFIID riid, LCID lcid,
+                                               WORD wFlags, DISPPARAMS* pDispParams, VARIANT* pVarResult,
+                                               EXCEPINFO* pExcepInfo, UINT* puArgErr)
+{
+    StructRecord* pRecord = (StructRecord*)This;
+    
+    if (dispIdMember < 1 || dispIdMember > pRecord->def->fieldCount)
+        return DISP_E_MEMBERNOTFOUND;
+    VARIANT* pValue = &pRecord->values[dispIdMember - 1];
+    
+    if (wFlags & (DISPATCH_PROPERTYPUT | DISPATCH_PROPERTYPUTREF))
+    {
+        if (!pDispParams || pDispParams->cArgs != 1)
+            return DISP_E_BADPARAMCOUNT;
+        VARIANT value;
+        VariantInit(&value);
+        HRESULT hr = VariantCopyInd(&value, &pDispParams->rgvarg[0]);
+        if (FAILED(hr))
+            return hr;
+        VariantClear(pValue);
+        *pValue = value;
+        return S_OK;
+    }
+    
+    if (wFlags & (DISPATCH_PROPERTYGET | DISPATCH_METHOD))
+    {
+        if (pDispParams && pDispParams->cArgs != 0)
+            return DISP_E_BADPARAMCOUNT;
+        if (!pVarResult)
+            return S_OK;
+        VariantInit(pVarResult);
+        return VariantCopy(pVarResult, pValue);
+    }
+    
+    return DISP_E_MEMBERNOTFOUND;
+}
+
+static IDispatchVtbl g_structRecordVtbl = {
+    Record_QueryInterface,
+    Record_AddRef,
+    Record_Release,
+    Record_GetTypeInfoCount,
+    Record_GetTypeInfo,
+    Record_GetIDsOfNames,
+    Record_Invoke
+};
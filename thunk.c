@@ -0,0 +1,594 @@
+#include "dynwrapx.h"
+
+// Executable memory is carved out of pages of this size
+#define THUNK_PAGE_SIZE 0x10000
+
+// Page of generated code, used as a bump allocator. The memory is mapped
+// twice: code is written through a read/write view and runs from a
+// read/execute view, so no page is both writable and executable and
+// thunks already handed out keep running while others are generated.
+typedef struct _ThunkPage {
+    BYTE* base;                 // Read/execute view
+    BYTE* writable;             // Read/write view of the same memory
+    SIZE_T used;
+    SIZE_T size;
+    struct _ThunkPage* next;
+} ThunkPage;
+
+// Address in the read/write view of code in pPage
+#define THUNK_WRITABLE(pPage, code) ((pPage)->writable + ((BYTE*)(code) - (pPage)->base))
+
+// Cache entry: one generated thunk per distinct argument layout
+typedef struct _ThunkEntry {
+    char* key;
+    int keyLength;
+    CallThunk thunk;
+    struct _ThunkEntry* next;
+} ThunkEntry;
+
+static CRITICAL_SECTION g_thunkCS;
+static ThunkPage* g_thunkPages = NULL;
+static ThunkEntry* g_thunkCache = NULL;
+static BYTE* g_freeCallbackThunks = NULL;  // Released callback thunks
+
+#if DYNWRAPX_TARGET_X64
+// Function table registered for a thunk, deleted before its page is unmapped
+typedef struct _UnwindTable {
+    PRUNTIME_FUNCTION function;
+    struct _UnwindTable* next;
+} UnwindTable;
+
+static UnwindTable* g_unwindTables = NULL;
+#endif
+
+void InitializeThunks(void)
+{
+    InitializeCriticalSection(&g_thunkCS);
+}
+
+void CleanupThunks(void)
+{
+    ThunkEntry* pEntry = g_thunkCache;
+    while (pEntry)
+    {
+        ThunkEntry* pNext = pEntry->next;
+        GlobalFree(pEntry->key);
+        GlobalFree(pEntry);
+        pEntry = pNext;
+    }
+    g_thunkCache = NULL;
+    g_freeCallbackThunks = NULL;
+    
+#if DYNWRAPX_TARGET_X64
+    UnwindTable* pTable = g_unwindTables;
+    while (pTable)
+    {
+        UnwindTable* pNext = pTable->next;
+        RtlDeleteFunctionTable(pTable->function);
+        GlobalFree(pTable);
+        pTable = pNext;
+    }
+    g_unwindTables = NULL;
+#endif
+    
+    ThunkPage* pPage = g_thunkPages;
+    while (pPage)
+    {
+        ThunkPage* pNext = pPage->next;
+        UnmapViewOfFile(pPage->base);
+        UnmapViewOfFile(pPage->writable);
+        GlobalFree(pPage);
+        pPage = pNext;
+    }
+    g_thunkPages = NULL;
+    
+    DeleteCriticalSection(&g_thunkCS);
+}
+
+// Map a new thunk page: one read/write and one read/execute view of the
+// same section (caller holds g_thunkCS)
+static ThunkPage* MapThunkPage(SIZE_T pageSize)
+{
+    ThunkPage* pPage = (ThunkPage*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, sizeof(ThunkPage));
+    if (!pPage)
+        return NULL;
+    
+    HANDLE hSection = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_EXECUTE_READWRITE | SEC_COMMIT,
+                                         0, (DWORD)pageSize, NULL);
+    if (hSection)
+    {
+        pPage->writable = (BYTE*)MapViewOfFile(hSection, FILE_MAP_WRITE, 0, 0, pageSize);
+        pPage->base = (BYTE*)MapViewOfFile(hSection, FILE_MAP_READ | FILE_MAP_EXECUTE, 0, 0, pageSize);
+        CloseHandle(hSection); // The views keep the section alive
+    }
+    
+    if (!pPage->writable || !pPage->base)
+    {
+        if (pPage->writable)
+            UnmapViewOfFile(pPage->writable);
+        if (pPage->base)
+            UnmapViewOfFile(pPage->base);
+        GlobalFree(pPage);
+        return NULL;
+    }
+    
+    pPage->size = pageSize;
+    pPage->next = g_thunkPages;
+    g_thunkPages = pPage;
+    return pPage;
+}
+
+// Page holding generated code (caller holds g_thunkCS)
+static ThunkPage* FindThunkPage(const BYTE* code)
+{
+    for (ThunkPage* pPage = g_thunkPages; pPage; pPage = pPage->next)
+    {
+        if (code >= pPage->base && code < pPage->base + pPage->size)
+            return pPage;
+    }
+    return NULL;
+}
+
+// Reserve memory for a thunk (caller holds g_thunkCS). Returns the address
+// the code runs at; it is written through THUNK_WRITABLE.
+static BYTE* AllocThunkCode(SIZE_T size, ThunkPage** ppPage)
+{
+    size = (size + 15) & ~(SIZE_T)15;
+    
+    ThunkPage* pPage = g_thunkPages;
+    if (!pPage || pPage->size - pPage->used < size)
+    {
+        pPage = MapThunkPage(size > THUNK_PAGE_SIZE ? size : THUNK_PAGE_SIZE);
+        if (!pPage)
+            return NULL;
+    }
+    
+    BYTE* code = pPage->base + pPage->used;
+    pPage->used += size;
+    *ppPage = pPage;
+    return code;
+}
+
+static BYTE* EmitBytes(BYTE* p, const void* bytes, int count)
+{
+    memcpy(p, bytes, count);
+    return p + count;
+}
+
+static BYTE* Emit32(BYTE* p, DWORD value)
+{
+    memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+#if DYNWRAPX_TARGET_X64
+// Unwind codes (UNWIND_CODE.UnwindOp) used by the generated prologues
+#define UWOP_PUSH_NONVOL 0
+#define UWOP_ALLOC_LARGE 1
+#define UWOP_ALLOC_SMALL 2
+#define UWOP_SET_FPREG   3
+#define UNWIND_REG_RBP   5
+
+// Room after a thunk's code for its UNWIND_INFO (up to four codes) and
+// RUNTIME_FUNCTION, including alignment
+#define THUNK_UNWIND_SIZE 32
+
+// Unwind code slot: prologue offset, operation and operation info
+#define UNWIND_CODE_SLOT(offset, op, info) ((USHORT)((offset) | ((op) << 8) | ((info) << 12)))
+
+// Write the UNWIND_INFO and RUNTIME_FUNCTION for the code at [code, end)
+// after it, at unwind (in the executable view, 4-byte aligned), and register
+// them so exceptions and stack walks (debuggers, ETW, RtlVirtualUnwind) can
+// unwind through the thunk's frame. Caller holds g_thunkCS.
+static BOOL RegisterThunkUnwind(ThunkPage* pPage, BYTE* code, BYTE* end, BYTE* unwind,
+                                BYTE prologSize, BYTE frameRegister, const USHORT* codes, int codeCount)
+{
+    UnwindTable* pTable = (UnwindTable*)GlobalAlloc(GMEM_FIXED, sizeof(UnwindTable));
+    if (!pTable)
+        return FALSE;
+    
+    BYTE* p = THUNK_WRITABLE(pPage, unwind);
+    *p++ = 1;                                       // Version 1, no handler
+    *p++ = prologSize;
+    *p++ = (BYTE)codeCount;
+    *p++ = frameRegister;                           // Frame offset 0
+    p = EmitBytes(p, codes, codeCount * (int)sizeof(USHORT));
+    if (codeCount & 1)
+        p = EmitBytes(p, "\0\0", 2);                // The code array has an even length
+    
+    RUNTIME_FUNCTION* pFunction = (RUNTIME_FUNCTION*)p;
+    pFunction->BeginAddress = (DWORD)(code - pPage->base);
+    pFunction->EndAddress = (DWORD)(end - pPage->base);
+    pFunction->UnwindData = (DWORD)(unwind - pPage->base);
+    
+    pTable->function = (PRUNTIME_FUNCTION)(pPage->base + ((BYTE*)pFunction - pPage->writable));
+    if (!RtlAddFunctionTable(pTable->function, 1, (DWORD64)pPage->base))
+    {
+        GlobalFree(pTable);
+        return FALSE;
+    }
+    pTable->next = g_unwindTables;
+    g_unwindTables = pTable;
+    return TRUE;
+}
+
+// Thunk key character for an argument: integer, float or double slot
+static char GetSlotClass(ParameterType type)
+{
+    if (type == TYPE_FLOAT)
+        return 'f';
+    if (type == TYPE_DOUBLE)
+        return 'd';
+    return 'i';
+}
+
+// Upper bound on the code size of a thunk with count arguments, including
+// its unwind data
+static SIZE_T GetThunkCodeSize(int count)
+{
+    return 36 + (SIZE_T)count * 16 + THUNK_UNWIND_SIZE;
+}
+
+// Stack frame below the saved RBP: shadow area plus stack arguments
+static DWORD GetThunkFrameSize(int count)
+{
+    int stackArgs = count > 4 ? count - 4 : 0;
+    return (DWORD)((32 + stackArgs * 8 + 15) & ~15);
+}
+
+// Generate a Microsoft x64 thunk:
+//   LONG_PTR thunk(FARPROC proc /* rcx */, const LONG_PTR* frame /* rdx */)
+// The first four slots go to RCX/RDX/R8/R9 (and XMM0-3 for floating point,
+// mirrored in the integer register as varargs callees expect), the rest go
+// to the stack above the 32-byte shadow area. RAX/XMM0 are left untouched
+// after the call so the caller sees the native return registers. The
+// prologue and epilogue use the forms the x64 unwinder recognizes; see
+// RegisterCallThunkUnwind.
+static BYTE* EmitCallThunk(BYTE* p, const char* key, int count)
+{
+    static const BYTE gprLoad[4][3] = {
+        { 0x49, 0x8B, 0x8B },   // mov rcx, [r11+disp32]
+        { 0x49, 0x8B, 0x93 },   // mov rdx, [r11+disp32]
+        { 0x4D, 0x8B, 0x83 },   // mov r8,  [r11+disp32]
+        { 0x4D, 0x8B, 0x8B }    // mov r9,  [r11+disp32]
+    };
+    static const BYTE xmmModRm[4] = { 0x83, 0x8B, 0x93, 0x9B };
+    
+    DWORD frameSize = GetThunkFrameSize(count);
+    
+    p = EmitBytes(p, "\x55", 1);                    // push rbp
+    p = EmitBytes(p, "\x48\x89\xE5", 3);            // mov rbp, rsp
+    p = EmitBytes(p, "\x48\x81\xEC", 3);            // sub rsp, frameSize
+    p = Emit32(p, frameSize);
+    p = EmitBytes(p, "\x49\x89\xCA", 3);            // mov r10, rcx (proc)
+    p = EmitBytes(p, "\x49\x89\xD3", 3);            // mov r11, rdx (frame)
+    
+    // Stack arguments first, while RAX is free to use as scratch
+    for (int i = 4; i < count; i++)
+    {
+        p = EmitBytes(p, "\x49\x8B\x83", 3);        // mov rax, [r11+i*8]
+        p = Emit32(p, (DWORD)(i * 8));
+        p = EmitBytes(p, "\x48\x89\x84\x24", 4);    // mov [rsp+i*8], rax
+        p = Emit32(p, (DWORD)(i * 8));
+    }
+    
+    for (int i = 0; i < count && i < 4; i++)
+    {
+        p = EmitBytes(p, gprLoad[i], 3);
+        p = Emit32(p, (DWORD)(i * 8));
+        
+        if (key[i] != 'i')
+        {
+            // movss/movsd xmmN, [r11+i*8]
+            *p++ = (BYTE)(key[i] == 'f' ? 0xF3 : 0xF2);
+            p = EmitBytes(p, "\x41\x0F\x10", 3);
+            *p++ = xmmModRm[i];
+            p = Emit32(p, (DWORD)(i * 8));
+        }
+    }
+    
+    p = EmitBytes(p, "\x41\xFF\xD2", 3);            // call r10
+    p = EmitBytes(p, "\x48\x8D\x65\x00", 4);        // lea rsp, [rbp+0]
+    p = EmitBytes(p, "\x5D\xC3", 2);                // pop rbp; ret
+    return p;
+}
+
+// Unwind data for EmitCallThunk's prologue: push rbp (ends at offset 1),
+// mov rbp, rsp (4), sub rsp, frameSize (11)
+static BOOL RegisterCallThunkUnwind(ThunkPage* pPage, BYTE* code, BYTE* end, int count)
+{
+    USHORT codes[4] = {
+        UNWIND_CODE_SLOT(11, UWOP_ALLOC_LARGE, 0),
+        (USHORT)(GetThunkFrameSize(count) / 8),
+        UNWIND_CODE_SLOT(4, UWOP_SET_FPREG, 0),
+        UNWIND_CODE_SLOT(1, UWOP_PUSH_NONVOL, UNWIND_REG_RBP)
+    };
+    BYTE* unwind = (BYTE*)(((ULONG_PTR)end + 3) & ~(ULONG_PTR)3);
+    return RegisterThunkUnwind(pPage, code, end, unwind, 11, UNWIND_REG_RBP, codes, 4);
+}
+#else
+// Every x86 argument slot is pushed as one DWORD; 8-byte arguments
+// (double, q) simply occupy two consecutive slots
+static char GetSlotClass(ParameterType type)
+{
+    return 'i';
+}
+
+static SIZE_T GetThunkCodeSize(int count)
+{
+    return 24 + (SIZE_T)count * 6;
+}
+
+// x86 uses frame-based exception handling: nothing to register
+static BOOL RegisterCallThunkUnwind(ThunkPage* pPage, BYTE* code, BYTE* end, int count)
+{
+    return TRUE;
+}
+
+// Generate an x86 thunk:
+//   LONG_PTR __cdecl thunk(FARPROC proc, const LONG_PTR* frame)
+// Slots are pushed right to left and ESP is restored from EBP afterwards,
+// so the same thunk serves both stdcall and cdecl callees. EAX/EDX/ST0 are
+// left untouched after the call.
+static BYTE* EmitCallThunk(BYTE* p, const char* key, int count)
+{
+    p = EmitBytes(p, "\x55", 1);                    // push ebp
+    p = EmitBytes(p, "\x89\xE5", 2);                // mov ebp, esp
+    p = EmitBytes(p, "\x8B\x4D\x0C", 3);            // mov ecx, [ebp+12] (frame)
+    
+    for (int i = count - 1; i >= 0; i--)
+    {
+        p = EmitBytes(p, "\xFF\xB1", 2);            // push dword [ecx+i*4]
+        p = Emit32(p, (DWORD)(i * 4));
+    }
+    
+    p = EmitBytes(p, "\xFF\x55\x08", 3);            // call [ebp+8] (proc)
+    p = EmitBytes(p, "\x89\xEC", 2);                // mov esp, ebp
+    p = EmitBytes(p, "\x5D\xC3", 2);                // pop ebp; ret
+    return p;
+}
+#endif
+
+// Get (or generate) the call thunk for a parameter list. Thunks are shared
+// by every function whose arguments use the same register/stack layout.
+CallThunk GetCallThunk(const ParameterType* paramTypes, int paramCount)
+{
+    CallThunk thunk = NULL;
+    int slotCount = 0;
+    char* key;
+    
+    for (int i = 0; i < paramCount; i++)
+        slotCount += GetArgSlotCount(paramTypes[i]);
+    
+    // One key character per frame slot
+    key = (char*)GlobalAlloc(GMEM_FIXED, slotCount + 1);
+    if (!key)
+        return NULL;
+    for (int i = 0, slot = 0; i < paramCount; i++)
+    {
+        for (int j = 0; j < GetArgSlotCount(paramTypes[i]); j++)
+            key[slot++] = GetSlotClass(paramTypes[i]);
+    }
+    key[slotCount] = '\0';
+    
+    EnterCriticalSection(&g_thunkCS);
+    
+    for (ThunkEntry* pEntry = g_thunkCache; pEntry; pEntry = pEntry->next)
+    {
+        if (pEntry->keyLength == slotCount && memcmp(pEntry->key, key, slotCount) == 0)
+        {
+            thunk = pEntry->thunk;
+            break;
+        }
+    }
+    
+    if (!thunk)
+    {
+        ThunkEntry* pEntry = (ThunkEntry*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, sizeof(ThunkEntry));
+        ThunkPage* pPage = NULL;
+        BYTE* code = pEntry ? AllocThunkCode(GetThunkCodeSize(slotCount), &pPage) : NULL;
+        BYTE* end = NULL;
+        
+        // Write the code and its unwind data, then register both before the
+        // thunk is published
+        if (code)
+        {
+            end = code + (EmitCallThunk(THUNK_WRITABLE(pPage, code), key, slotCount) - THUNK_WRITABLE(pPage, code));
+            FlushInstructionCache(GetCurrentProcess(), code, end - code);
+            if (!RegisterCallThunkUnwind(pPage, code, end, slotCount))
+                code = NULL;
+        }
+        
+        if (code)
+        {
+            pEntry->key = key;
+            pEntry->keyLength = slotCount;
+            pEntry->thunk = (CallThunk)code;
+            pEntry->next = g_thunkCache;
+            g_thunkCache = pEntry;
+            key = NULL; // Owned by the cache now
+            
+            thunk = pEntry->thunk;
+            DebugLog("DEBUG", "GetCallThunk", "Generated thunk for %d slot(s) at 0x%p, %d bytes", slotCount, code, (int)(end - code));
+        }
+        else
+        {
+            if (pEntry)
+                GlobalFree(pEntry);
+            DebugLog("ERROR", "GetCallThunk", "Failed to allocate executable memory for thunk");
+        }
+    }
+    
+    LeaveCriticalSection(&g_thunkCS);
+    
+    if (key)
+        GlobalFree(key);
+    
+    return thunk;
+}
+
+// Callback thunks are fixed-size blocks so a released one can be reused by
+// any other callback, whatever its signature. The code takes the first
+// CALLBACK_CODE_SIZE bytes, followed on x64 by the block's unwind data.
+// Free blocks are linked through their last bytes.
+#define CALLBACK_THUNK_SIZE 128
+#define CALLBACK_CODE_SIZE 96
+#define CALLBACK_THUNK_LINK(code) (*(BYTE**)((code) + CALLBACK_THUNK_SIZE - sizeof(BYTE*)))
+
+static BYTE* EmitPointer(BYTE* p, const void* value)
+{
+    memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+#if DYNWRAPX_TARGET_X64
+// Generate a Microsoft x64 callback entry point. The register arguments are
+// spilled to the caller's shadow area, which makes them contiguous with the
+// stack arguments, and that array is passed to
+//   InvokeCallback(pInfo /* rcx */, slots /* rdx */, &result /* r8 */)
+// The 8-byte result is returned in RAX, or XMM0 for float/double. The frame
+// is allocated first, so every callback thunk has the same prologue and a
+// block's unwind data stays valid when it is reused.
+static BYTE* EmitCallbackThunk(BYTE* p, CallbackInfo* pInfo)
+{
+    static const BYTE gprSpill[4][5] = {
+        { 0x48, 0x89, 0x4C, 0x24, 0x30 },   // mov [rsp+48], rcx
+        { 0x48, 0x89, 0x54, 0x24, 0x38 },   // mov [rsp+56], rdx
+        { 0x4C, 0x89, 0x44, 0x24, 0x40 },   // mov [rsp+64], r8
+        { 0x4C, 0x89, 0x4C, 0x24, 0x48 }    // mov [rsp+72], r9
+    };
+    static const BYTE xmmSpill[4][6] = {
+        { 0xF2, 0x0F, 0x11, 0x44, 0x24, 0x30 },     // movsd [rsp+48], xmm0
+        { 0xF2, 0x0F, 0x11, 0x4C, 0x24, 0x38 },     // movsd [rsp+56], xmm1
+        { 0xF2, 0x0F, 0x11, 0x54, 0x24, 0x40 },     // movsd [rsp+64], xmm2
+        { 0xF2, 0x0F, 0x11, 0x5C, 0x24, 0x48 }      // movsd [rsp+72], xmm3
+    };
+    
+    // 32 bytes of shadow space for InvokeCallback plus the result slot;
+    // RSP ends up 16-byte aligned
+    p = EmitBytes(p, "\x48\x83\xEC\x28", 4);        // sub rsp, 40
+    
+    for (int i = 0; i < pInfo->paramCount && i < 4; i++)
+    {
+        if (GetSlotClass(pInfo->paramTypes[i]) == 'i')
+            p = EmitBytes(p, gprSpill[i], 5);
+        else
+            p = EmitBytes(p, xmmSpill[i], 6);
+    }
+    
+    p = EmitBytes(p, "\x48\xB9", 2);                // mov rcx, pInfo
+    p = EmitPointer(p, pInfo);
+    p = EmitBytes(p, "\x48\x8D\x54\x24\x30", 5);    // lea rdx, [rsp+48] (slots)
+    p = EmitBytes(p, "\x4C\x8D\x44\x24\x20", 5);    // lea r8, [rsp+32] (result)
+    p = EmitBytes(p, "\x48\xB8", 2);                // mov rax, InvokeCallback
+    p = EmitPointer(p, (const void*)InvokeCallback);
+    p = EmitBytes(p, "\xFF\xD0", 2);                // call rax
+    p = EmitBytes(p, "\x48\x8B\x44\x24\x20", 5);    // mov rax, [rsp+32]
+    if (pInfo->returnType == TYPE_FLOAT || pInfo->returnType == TYPE_DOUBLE)
+        p = EmitBytes(p, "\x66\x48\x0F\x6E\xC0", 5);    // movq xmm0, rax
+    p = EmitBytes(p, "\x48\x83\xC4\x28", 4);        // add rsp, 40
+    p = EmitBytes(p, "\xC3", 1);                    // ret
+    return p;
+}
+
+// Unwind data for a callback thunk block: sub rsp, 40 (ends at offset 4).
+// Registered once, when the block is first allocated.
+static BOOL RegisterCallbackThunkUnwind(ThunkPage* pPage, BYTE* code)
+{
+    USHORT codes[1] = { UNWIND_CODE_SLOT(4, UWOP_ALLOC_SMALL, 40 / 8 - 1) };
+    return RegisterThunkUnwind(pPage, code, code + CALLBACK_CODE_SIZE, code + CALLBACK_CODE_SIZE, 4, 0, codes, 1);
+}
+#else
+// Generate an x86 stdcall callback entry point. The caller's stack
+// arguments already form the slot array, so the thunk calls
+//   InvokeCallback(pInfo, slots, &result)   (cdecl)
+// returns the result in EDX:EAX (ST0 for float/double) and pops the
+// arguments as a stdcall callee must.
+static BYTE* EmitCallbackThunk(BYTE* p, CallbackInfo* pInfo)
+{
+    int argBytes = 0;
+    for (int i = 0; i < pInfo->paramCount; i++)
+        argBytes += GetArgSlotCount(pInfo->paramTypes[i]) * 4;
+    
+    p = EmitBytes(p, "\x83\xEC\x08", 3);            // sub esp, 8 (result)
+    p = EmitBytes(p, "\x89\xE0", 2);                // mov eax, esp
+    p = EmitBytes(p, "\x50", 1);                    // push eax (&result)
+    p = EmitBytes(p, "\x8D\x44\x24\x10", 4);        // lea eax, [esp+16] (slots)
+    p = EmitBytes(p, "\x50", 1);                    // push eax
+    p = EmitBytes(p, "\x68", 1);                    // push pInfo
+    p = EmitPointer(p, pInfo);
+    p = EmitBytes(p, "\xB8", 1);                    // mov eax, InvokeCallback
+    p = EmitPointer(p, (const void*)InvokeCallback);
+    p = EmitBytes(p, "\xFF\xD0", 2);                // call eax
+    p = EmitBytes(p, "\x83\xC4\x0C", 3);            // add esp, 12
+    if (pInfo->returnType == TYPE_FLOAT)
+        p = EmitBytes(p, "\xD9\x04\x24", 3);        // fld dword [esp]
+    else if (pInfo->returnType == TYPE_DOUBLE)
+        p = EmitBytes(p, "\xDD\x04\x24", 3);        // fld qword [esp]
+    p = EmitBytes(p, "\x8B\x04\x24", 3);            // mov eax, [esp]
+    p = EmitBytes(p, "\x8B\x54\x24\x04", 4);        // mov edx, [esp+4]
+    p = EmitBytes(p, "\x83\xC4\x08", 3);            // add esp, 8
+    p = EmitBytes(p, "\xC2", 1);                    // ret argBytes
+    *p++ = (BYTE)(argBytes & 0xFF);
+    *p++ = (BYTE)(argBytes >> 8);
+    return p;
+}
+
+static BOOL RegisterCallbackThunkUnwind(ThunkPage* pPage, BYTE* code)
+{
+    return TRUE;
+}
+#endif
+
+// Generate the native entry point of a callback. The thunk is bound to
+// pInfo, which must stay alive until FreeCallbackThunk is called.
+void* CreateCallbackThunk(CallbackInfo* pInfo)
+{
+    BYTE* code;
+    ThunkPage* pPage = NULL;
+    
+    EnterCriticalSection(&g_thunkCS);
+    
+    if (g_freeCallbackThunks)
+    {
+        code = g_freeCallbackThunks;
+        g_freeCallbackThunks = CALLBACK_THUNK_LINK(code);
+        pPage = FindThunkPage(code);
+    }
+    else
+    {
+        code = AllocThunkCode(CALLBACK_THUNK_SIZE, &pPage);
+        if (code && !RegisterCallbackThunkUnwind(pPage, code))
+            code = NULL;
+    }
+    
+    if (code)
+    {
+        BYTE* end = code + (EmitCallbackThunk(THUNK_WRITABLE(pPage, code), pInfo) - THUNK_WRITABLE(pPage, code));
+        FlushInstructionCache(GetCurrentProcess(), code, end - code);
+        DebugLog("DEBUG", "CreateCallbackThunk", "Generated callback thunk for %d param(s) at 0x%p, %d bytes", pInfo->paramCount, code, (int)(end - code));
+    }
+    else
+    {
+        DebugLog("ERROR", "CreateCallbackThunk", "Failed to allocate executable memory for callback thunk");
+    }
+    
+    LeaveCriticalSection(&g_thunkCS);
+    return code;
+}
+
+// Return a callback thunk to the pool
+void FreeCallbackThunk(void* thunk)
+{
+    EnterCriticalSection(&g_thunkCS);
+    
+    // Overwrite the code with int3 so stale calls trap instead of running
+    // into another callback. The unwind data after the code stays registered.
+    BYTE* writable = THUNK_WRITABLE(FindThunkPage((BYTE*)thunk), thunk);
+    memset(writable, 0xCC, CALLBACK_CODE_SIZE);
+    FlushInstructionCache(GetCurrentProcess(), thunk, CALLBACK_CODE_SIZE);
+    CALLBACK_THUNK_LINK(writable) = g_freeCallbackThunks;
+    g_freeCallbackThunks = (BYTE*)thunk;
+    
+    LeaveCriticalSection(&g_thunkCS);
+}
@@ -0,0 +1,258 @@
+#include "dynwrapx.h"
+#include <stdio.h>
+
+// Events kept per thread between flushes (power of two)
+#define TRACE_RING_SIZE 4096
+
+// Rings of exited threads kept for the next flush; older ones are dropped
+#define TRACE_MAX_ORPHANED 16
+
+// One traced call, recorded by the calling thread
+typedef struct _TraceEvent {
+    LONGLONG start;             // QueryPerformanceCounter at call entry
+    LONGLONG duration;          // QPC ticks
+    const void* owner;          // DynamicWrapperX that made the call
+    DWORD functionId;
+    DWORD argCount;
+    HRESULT hr;
+} TraceEvent;
+
+// Single-producer ring owned by one thread. The owning thread is the only
+// writer of head; flushes read up to a snapshot of head and advance tail.
+typedef struct _TraceRing {
+    TraceEvent events[TRACE_RING_SIZE];
+    volatile LONG head;
+    LONG tail;
+    DWORD threadId;
+    BOOL orphaned;              // Thread exited; freed after the next flush or when evicted
+    struct _TraceRing* next;
+} TraceRing;
+
+static DWORD g_traceTls = TLS_OUT_OF_INDEXES;
+static CRITICAL_SECTION g_traceCS;     // Guards the ring list and serializes flushes
+static TraceRing* g_traceRings = NULL;
+static LONG g_traceOrphaned = 0;       // Orphaned rings in the list (guarded by g_traceCS)
+static volatile LONG g_traceDropped = 0;
+
+void InitializeTracing(void)
+{
+    InitializeCriticalSection(&g_traceCS);
+    g_traceTls = TlsAlloc();
+}
+
+void CleanupTracing(void)
+{
+    TraceRing* pRing = g_traceRings;
+    while (pRing)
+    {
+        TraceRing* pNext = pRing->next;
+        GlobalFree(pRing);
+        pRing = pNext;
+    }
+    g_traceRings = NULL;
+    g_traceOrphaned = 0;
+    
+    if (g_traceTls != TLS_OUT_OF_INDEXES)
+    {
+        TlsFree(g_traceTls);
+        g_traceTls = TLS_OUT_OF_INDEXES;
+    }
+    DeleteCriticalSection(&g_traceCS);
+}
+
+// Unlink a ring from the list and free it (caller holds g_traceCS)
+static void FreeTraceRing(TraceRing* pRing)
+{
+    TraceRing** ppRing = &g_traceRings;
+    while (*ppRing && *ppRing != pRing)
+        ppRing = &(*ppRing)->next;
+    if (*ppRing)
+        *ppRing = pRing->next;
+    GlobalFree(pRing);
+}
+
+// The calling thread is exiting. A drained ring is freed now; otherwise it
+// stays listed until it is flushed. Only TRACE_MAX_ORPHANED such rings are
+// kept, so a script that never flushes does not hold a ring for every
+// thread that ever made a call: past that, the oldest one is freed and its
+// events are counted as dropped.
+void ReleaseThreadTrace(void)
+{
+    if (g_traceTls == TLS_OUT_OF_INDEXES)
+        return;
+    
+    TraceRing* pRing = (TraceRing*)TlsGetValue(g_traceTls);
+    if (!pRing)
+        return;
+    TlsSetValue(g_traceTls, NULL);
+    
+    EnterCriticalSection(&g_traceCS);
+    if (pRing->head == pRing->tail)
+    {
+        FreeTraceRing(pRing);
+    }
+    else
+    {
+        pRing->orphaned = TRUE;
+        g_traceOrphaned++;
+        
+        if (g_traceOrphaned > TRACE_MAX_ORPHANED)
+        {
+            // New rings are added at the front, so the oldest orphan is the last
+            TraceRing* pOldest = NULL;
+            for (TraceRing* pScan = g_traceRings; pScan; pScan = pScan->next)
+            {
+                if (pScan->orphaned)
+                    pOldest = pScan;
+            }
+            
+            LONG pending = pOldest->head - pOldest->tail;
+            InterlockedExchangeAdd(&g_traceDropped, min(pending, TRACE_RING_SIZE));
+            FreeTraceRing(pOldest);
+            g_traceOrphaned--;
+        }
+    }
+    LeaveCriticalSection(&g_traceCS);
+}
+
+// Get the calling thread's ring, creating it on first use
+static TraceRing* GetThreadRing(void)
+{
+    if (g_traceTls == TLS_OUT_OF_INDEXES)
+        return NULL;
+    
+    TraceRing* pRing = (TraceRing*)TlsGetValue(g_traceTls);
+    if (pRing)
+        return pRing;
+    
+    pRing = (TraceRing*)GlobalAlloc(GMEM_FIXED | GMEM_ZEROINIT, sizeof(TraceRing));
+    if (!pRing)
+        return NULL;
+    pRing->threadId = GetCurrentThreadId();
+    
+    EnterCriticalSection(&g_traceCS);
+    pRing->next = g_traceRings;
+    g_traceRings = pRing;
+    LeaveCriticalSection(&g_traceCS);
+    
+    TlsSetValue(g_traceTls, pRing);
+    return pRing;
+}
+
+// Record a completed call. Only the calling thread writes to its ring, so
+// no lock is taken; a full ring overwrites its oldest events.
+void TraceCall(const void* owner, DWORD functionId, DWORD argCount, LONGLONG start, LONGLONG end, HRESULT hr)
+{
+    TraceRing* pRing = GetThreadRing();
+    if (!pRing)
+    {
+        InterlockedIncrement(&g_traceDropped);
+        return;
+    }
+    
+    LONG index = pRing->head;
+    TraceEvent* pEvent = &pRing->events[index & (TRACE_RING_SIZE - 1)];
+    pEvent->start = start;
+    pEvent->duration = end - start;
+    pEvent->owner = owner;
+    pEvent->functionId = functionId;
+    pEvent->argCount = argCount;
+    pEvent->hr = hr;
+    
+    // Publish the event (full barrier) before a flush can observe the new head
+    InterlockedExchange(&pRing->head, index + 1);
+}
+
+// Default trace file: %DYNWRAPX_TRACE%, else dynwrapx-trace.log in %TEMP%
+static void GetDefaultTracePath(WCHAR* path, DWORD size)
+{
+    DWORD length = GetEnvironmentVariableW(L"DYNWRAPX_TRACE", path, size);
+    if (length > 0 && length < size)
+        return;
+    
+    length = GetTempPathW(size, path);
+    if (length == 0 || length + 20 >= size)
+        path[0] = L'\0';
+    wcscat(path, L"dynwrapx-trace.log");
+}
+
+// Append every buffered event to a trace file and empty the rings. Names are
+// resolved for calls made through pObj; other objects' calls show their id.
+// Returns the number of events written, or -1 if the file cannot be opened.
+LONG FlushTrace(DynamicWrapperX* pObj, LPCWSTR path)
+{
+    WCHAR defaultPath[MAX_PATH];
+    LONG written = 0;
+    
+    if (!path || !*path)
+    {
+        GetDefaultTracePath(defaultPath, MAX_PATH);
+        path = defaultPath;
+    }
+    
+    FILE* file = _wfopen(path, L"a");
+    if (!file)
+    {
+        DebugLog("ERROR", "FlushTrace", "Cannot open trace file '%S'", path);
+        return -1;
+    }
+    
+    EnterCriticalSection(&g_traceCS);
+    
+    LONG dropped = InterlockedExchange(&g_traceDropped, 0);
+    fprintf(file, "# thread,function,name,args,start,ticks,us,hr (qpc frequency %lld, dropped %ld)\n",
+            g_qpcFrequency, dropped);
+    
+    TraceRing** ppRing = &g_traceRings;
+    while (*ppRing)
+    {
+        TraceRing* pRing = *ppRing;
+        LONG head = pRing->head;
+        LONG tail = pRing->tail;
+        
+        // Events the producer has already lapped are lost. The event at
+        // head - TRACE_RING_SIZE shares its slot with the one being written
+        // at head, so it is lost as well.
+        if (head - tail >= TRACE_RING_SIZE)
+        {
+            fprintf(file, "# thread %lu overwrote %ld events\n", pRing->threadId, head - tail - TRACE_RING_SIZE + 1);
+            tail = head - TRACE_RING_SIZE + 1;
+        }
+        
+        for (LONG i = tail; i != head; i++)
+        {
+            TraceEvent event = pRing->events[i & (TRACE_RING_SIZE - 1)];
+            
+            // The producer may have started on this slot while it was copied
+            if (pRing->head - i >= TRACE_RING_SIZE)
+                continue;
+            
+            FunctionInfo* pFunc = (event.owner == pObj) ? FindFunctionById(pObj, (DISPID)event.functionId) : NULL;
+            double micros = g_qpcFrequency ? (double)event.duration * 1000000.0 / (double)g_qpcFrequency : 0.0;
+            fprintf(file, "%lu,%lu,%S,%lu,%lld,%lld,%.3f,0x%08lX\n",
+                    pRing->threadId, event.functionId,
+                    (pFunc && pFunc->functionName) ? pFunc->functionName : L"",
+                    event.argCount, event.start, event.duration, micros, (ULONG)event.hr);
+            written++;
+        }
+        pRing->tail = head;
+        
+        // Rings of exited threads are freed once drained
+        if (pRing->orphaned)
+        {
+            *ppRing = pRing->next;
+            GlobalFree(pRing);
+            g_traceOrphaned--;
+        }
+        else
+        {
+            ppRing = &pRing->next;
+        }
+    }
+    
+    LeaveCriticalSection(&g_traceCS);
+    
+    fclose(file);
+    DebugLog("INFO", "FlushTrace", "Wrote %ld trace events to '%S'", written, path);
+    return written;
+}
@@ -0,0 +1,146 @@
+#include "dynwrapx.h"
+
+// SSE2 is part of every x64 target; x86 builds use it when the compiler
+// targets it (MSVC's default /arch:SSE2, gcc -msse2)
+#if DYNWRAPX_TARGET_X64 || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define DYNWRAPX_TRANSCODE_SSE2 1
+    #include <emmintrin.h>
+#else
+    #define DYNWRAPX_TRANSCODE_SSE2 0
+#endif
+
+// Windows ANSI and OEM code pages, like UTF-8, map 0x00-0x7F to the ASCII
+// characters. DBCS trail bytes (932/936/949/950) can fall in 0x40-0x7E, but
+// only after a lead byte >= 0x80, so a prefix that stops at the first byte
+// >= 0x80 is plain ASCII and converts one unit per byte without the system
+// converters.
+
+// Narrow the leading ASCII characters of text (at most limit) into dst, or
+// only count them when dst is NULL. Returns the number of characters.
+static int CopyAsciiPrefixW(LPCWSTR text, int limit, LPSTR dst)
+{
+    int i = 0;
+    
+#if DYNWRAPX_TRANSCODE_SSE2
+    // 16 characters per step: both halves must have no bits above 0x7F
+    const __m128i highBits = _mm_set1_epi16((short)0xFF80);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= limit; i += 16)
+    {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(text + i + 8));
+        __m128i high = _mm_and_si128(_mm_or_si128(lo, hi), highBits);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF)
+            break;
+        if (dst)
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    
+    for (; i < limit && text[i] < 0x80; i++)
+    {
+        if (dst)
+            dst[i] = (CHAR)text[i];
+    }
+    return i;
+}
+
+// Widen the leading ASCII bytes of text (at most limit) into dst, or only
+// count them when dst is NULL. Returns the number of bytes.
+static int CopyAsciiPrefixA(LPCSTR text, int limit, LPWSTR dst)
+{
+    int i = 0;
+    
+#if DYNWRAPX_TRANSCODE_SSE2
+    // 16 bytes per step: no byte may have its top bit set
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= limit; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(text + i));
+        if (_mm_movemask_epi8(bytes) != 0)
+            break;
+        if (dst)
+        {
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(bytes, zero));
+            _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(bytes, zero));
+        }
+    }
+#endif
+    
+    for (; i < limit && (BYTE)text[i] < 0x80; i++)
+    {
+        if (dst)
+            dst[i] = (WCHAR)(BYTE)text[i];
+    }
+    return i;
+}
+
+// Code page of a narrow string type: s/S ANSI, z/Z OEM, a/A UTF-8
+UINT GetStringCodePage(ParameterType type)
+{
+    switch (type)
+    {
+    case TYPE_OSTRING:
+    case TYPE_OUT_OSTRING:
+        return CP_OEMCP;
+    case TYPE_USTRING:
+    case TYPE_OUT_USTRING:
+        return CP_UTF8;
+    default:
+        return CP_ACP;
+    }
+}
+
+// Convert length UTF-16 units to the code page into dst, which has room for
+// capacity bytes (no terminator is written). Returns the number of bytes the
+// whole text needs: the output is complete only when that is <= capacity,
+// so callers size dst for one byte per character (exact for ASCII) and
+// convert again into a larger buffer when the result says so.
+int WideToNarrow(UINT codePage, LPCWSTR text, int length, LPSTR dst, int capacity)
+{
+    int ascii = CopyAsciiPrefixW(text, dst ? min(length, capacity) : 0, dst);
+    if (ascii == length)
+        return length;
+    
+    // The rest goes through the system converter, straight into dst when it
+    // fits and as a size query otherwise
+    int room = dst ? capacity - ascii : 0;
+    int rest = room > 0 ? WideCharToMultiByte(codePage, 0, text + ascii, length - ascii, dst + ascii, room, NULL, NULL) : 0;
+    if (rest == 0)
+        rest = WideCharToMultiByte(codePage, 0, text + ascii, length - ascii, NULL, 0, NULL, NULL);
+    return ascii + rest;
+}
+
+// Convert length bytes in the code page to UTF-16 into dst, which has room
+// for capacity units. Returns the number of units the whole text needs, as
+// WideToNarrow does. No code page produces more units than bytes.
+int NarrowToWide(UINT codePage, LPCSTR text, int length, LPWSTR dst, int capacity)
+{
+    int ascii = CopyAsciiPrefixA(text, dst ? min(length, capacity) : 0, dst);
+    if (ascii == length)
+        return length;
+    
+    int room = dst ? capacity - ascii : 0;
+    int rest = room > 0 ? MultiByteToWideChar(codePage, 0, text + ascii, length - ascii, dst + ascii, room) : 0;
+    if (rest == 0)
+        rest = MultiByteToWideChar(codePage, 0, text + ascii, length - ascii, NULL, 0);
+    return ascii + rest;
+}
+
+// Script string from length bytes of narrow text. The BSTR is allocated for
+// one unit per byte; text with multi-byte characters is copied to a string
+// of the exact length afterwards.
+BSTR NarrowToBstr(UINT codePage, LPCSTR text, int length)
+{
+    BSTR result = SysAllocStringLen(NULL, (UINT)length);
+    if (!result || length == 0)
+        return result;
+    
+    int wideLength = NarrowToWide(codePage, text, length, result, length);
+    if (wideLength == length)
+        return result;
+    
+    BSTR exact = SysAllocStringLen(result, (UINT)min(wideLength, length));
+    SysFreeString(result);
+    return exact;
+}